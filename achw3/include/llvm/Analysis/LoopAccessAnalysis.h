@@ -686,6 +686,10 @@ public:
   /// the analysis.
   const LoopAccessInfo &getInfo(Loop *L, const ValueToValueMap &Strides);
 
+  /// \brief Drop the cached result for \p L, e.g. after a transformation
+  /// changed the values the loop starts from.
+  void forgetLoop(Loop *L) { LoopAccessInfoMap.erase(L); }
+
   void releaseMemory() override {
     // Invalidate the cache when the pass is freed.
     LoopAccessInfoMap.clear();
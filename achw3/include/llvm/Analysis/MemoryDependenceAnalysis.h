@@ -332,6 +332,11 @@ namespace llvm {
     const TargetLibraryInfo *TLI;
     PredIteratorCache PredCache;
 
+    /// The number of blocks the current non-local pointer query has walked,
+    /// and the number after which it gives up.
+    unsigned NumBlocksWalked;
+    unsigned BlockWalkLimit;
+
   public:
     MemoryDependenceAnalysis();
     ~MemoryDependenceAnalysis() override;
@@ -377,8 +382,14 @@ namespace llvm {
     ///
     /// This method assumes the pointer has a "NonLocal" dependency within
     /// QueryInst's parent basic block.
+    ///
+    /// The walk gives up, with an unknown dependency, once it would visit
+    /// more than BlockLimit blocks.  If NumBlocks is not null, it is set to
+    /// the number of blocks visited, counting those answered from the cache.
     void getNonLocalPointerDependency(Instruction *QueryInst,
-                                    SmallVectorImpl<NonLocalDepResult> &Result);
+                                      SmallVectorImpl<NonLocalDepResult> &Result,
+                                      unsigned *NumBlocks = nullptr,
+                                      unsigned BlockLimit = ~0U);
 
     /// removeInstruction - Remove an instruction from the dependence analysis,
     /// updating the dependence of instructions that previously depended on it.
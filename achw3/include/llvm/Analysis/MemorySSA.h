@@ -0,0 +1,383 @@
+//===- MemorySSA.h - Build Memory SSA ---------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file exposes an interface to building and querying Memory SSA, a
+// factored use-def graph over the memory operations of a function.
+//
+// Every instruction that may write memory gets a MemoryDef, every instruction
+// that may only read memory gets a MemoryUse, and blocks where several
+// definitions merge get a MemoryPhi.  All of memory is treated as a single
+// variable, so the graph is built the same way as SSA for scalars:
+//
+//   define void @foo() {
+//   entry:
+//     %p = alloca i32
+//     ; 1 = MemoryDef(liveOnEntry)
+//     store i32 0, i32* %p
+//     br label %loop
+//   loop:
+//     ; 2 = MemoryPhi({entry,1},{loop,3})
+//     ; MemoryUse(2)
+//     %v = load i32, i32* %p
+//     ; 3 = MemoryDef(2)
+//     store i32 %v, i32* %p
+//     ...
+//
+// The defining access of a MemoryUse or MemoryDef is the nearest dominating
+// access that *may* clobber it.  Finding the access that actually clobbers a
+// given location is done by a MemorySSAWalker, which consults alias analysis
+// and caches its answers so that repeated clobber queries are cheap.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_MEMORYSSA_H
+#define LLVM_ANALYSIS_MEMORYSSA_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/iterator_range.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Pass.h"
+#include <memory>
+#include <vector>
+
+namespace llvm {
+
+class BasicBlock;
+class DominatorTree;
+class Function;
+class Instruction;
+class MemorySSA;
+class MemorySSAWalker;
+class raw_ostream;
+
+/// \brief The base class of all memory accesses: uses, defs and phis.
+class MemoryAccess {
+public:
+  enum AccessKind { MemoryUseKind, MemoryDefKind, MemoryPhiKind };
+
+  typedef SmallVectorImpl<MemoryAccess *>::const_iterator user_iterator;
+
+  virtual ~MemoryAccess();
+
+  AccessKind getKind() const { return Kind; }
+  BasicBlock *getBlock() const { return Block; }
+
+  user_iterator user_begin() const { return Users.begin(); }
+  user_iterator user_end() const { return Users.end(); }
+  iterator_range<user_iterator> users() const {
+    return make_range(user_begin(), user_end());
+  }
+  bool hasUsers() const { return !Users.empty(); }
+
+  void print(raw_ostream &OS) const;
+  void dump() const;
+
+protected:
+  friend class MemorySSA;
+  friend class MemoryUseOrDef;
+  friend class MemoryPhi;
+
+  MemoryAccess(AccessKind Kind, BasicBlock *BB) : Kind(Kind), Block(BB) {}
+
+  /// Print only the name of this access, as used by its users.
+  void printAsOperand(raw_ostream &OS) const;
+
+  void addUser(MemoryAccess *User) { Users.push_back(User); }
+  void removeUser(MemoryAccess *User);
+
+private:
+  MemoryAccess(const MemoryAccess &) = delete;
+  void operator=(const MemoryAccess &) = delete;
+
+  AccessKind Kind;
+  BasicBlock *Block;
+  SmallVector<MemoryAccess *, 4> Users;
+};
+
+inline raw_ostream &operator<<(raw_ostream &OS, const MemoryAccess &MA) {
+  MA.print(OS);
+  return OS;
+}
+
+/// \brief The common part of MemoryUse and MemoryDef: an access tied to an
+/// instruction, with a single defining access.
+class MemoryUseOrDef : public MemoryAccess {
+public:
+  Instruction *getMemoryInst() const { return MemoryInst; }
+  MemoryAccess *getDefiningAccess() const { return DefiningAccess; }
+
+  static bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == MemoryUseKind || MA->getKind() == MemoryDefKind;
+  }
+
+protected:
+  friend class MemorySSA;
+
+  MemoryUseOrDef(AccessKind Kind, Instruction *MI, BasicBlock *BB)
+      : MemoryAccess(Kind, BB), MemoryInst(MI), DefiningAccess(nullptr) {}
+
+  void setDefiningAccess(MemoryAccess *DMA);
+
+private:
+  Instruction *MemoryInst;
+  MemoryAccess *DefiningAccess;
+};
+
+/// \brief Represents a read of memory by an instruction.
+class MemoryUse : public MemoryUseOrDef {
+public:
+  static bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == MemoryUseKind;
+  }
+
+private:
+  friend class MemorySSA;
+  MemoryUse(Instruction *MI, BasicBlock *BB)
+      : MemoryUseOrDef(MemoryUseKind, MI, BB) {}
+};
+
+/// \brief Represents a (possible) write to memory.  The live-on-entry state
+/// of memory is a MemoryDef with no instruction and no defining access.
+class MemoryDef : public MemoryUseOrDef {
+public:
+  unsigned getID() const { return ID; }
+
+  static bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == MemoryDefKind;
+  }
+
+private:
+  friend class MemorySSA;
+  MemoryDef(Instruction *MI, BasicBlock *BB, unsigned ID)
+      : MemoryUseOrDef(MemoryDefKind, MI, BB), ID(ID) {}
+
+  unsigned ID;
+};
+
+/// \brief Merges the memory state flowing in from the predecessors of a
+/// block.  There is one incoming entry per CFG edge into the block.
+class MemoryPhi : public MemoryAccess {
+public:
+  typedef std::pair<BasicBlock *, MemoryAccess *> IncomingEntry;
+  typedef std::vector<IncomingEntry>::const_iterator incoming_iterator;
+
+  unsigned getID() const { return ID; }
+
+  unsigned getNumIncomingValues() const { return Incoming.size(); }
+  BasicBlock *getIncomingBlock(unsigned I) const { return Incoming[I].first; }
+  MemoryAccess *getIncomingValue(unsigned I) const {
+    return Incoming[I].second;
+  }
+  incoming_iterator incoming_begin() const { return Incoming.begin(); }
+  incoming_iterator incoming_end() const { return Incoming.end(); }
+  iterator_range<incoming_iterator> incoming() const {
+    return make_range(incoming_begin(), incoming_end());
+  }
+
+  static bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == MemoryPhiKind;
+  }
+
+private:
+  friend class MemorySSA;
+  MemoryPhi(BasicBlock *BB, unsigned ID)
+      : MemoryAccess(MemoryPhiKind, BB), ID(ID) {}
+
+  void addIncoming(BasicBlock *BB, MemoryAccess *MA);
+  void setIncomingValue(unsigned I, MemoryAccess *MA);
+
+  unsigned ID;
+  std::vector<IncomingEntry> Incoming;
+};
+
+/// \brief Memory SSA for a single function.
+class MemorySSA {
+public:
+  /// The accesses of a block, in program order.  A MemoryPhi, if present,
+  /// is always first.
+  typedef std::vector<MemoryAccess *> AccessList;
+
+  MemorySSA(Function &F, AliasAnalysis &AA, DominatorTree &DT);
+  ~MemorySSA();
+
+  /// Return the access for an instruction, or the MemoryPhi of a block;
+  /// null if there is none.
+  MemoryUseOrDef *getMemoryAccess(const Instruction *I) const;
+  MemoryPhi *getMemoryAccess(const BasicBlock *BB) const;
+
+  /// Return the accesses of \p BB in program order, or null if it has none.
+  const AccessList *getBlockAccesses(const BasicBlock *BB) const;
+
+  MemoryDef *getLiveOnEntryDef() const { return LiveOnEntryDef.get(); }
+  bool isLiveOnEntryDef(const MemoryAccess *MA) const {
+    return MA == LiveOnEntryDef.get();
+  }
+
+  /// Return true if \p Dominator dominates \p Dominatee.  Within a block
+  /// this uses program order.
+  bool dominates(const MemoryAccess *Dominator,
+                 const MemoryAccess *Dominatee) const;
+
+  /// Return the caching clobber walker owned by this MemorySSA.
+  MemorySSAWalker *getWalker();
+
+  /// \name Update API
+  /// Keep Memory SSA in sync with transformations of the IR.  These do not
+  /// touch the IR themselves.
+  /// @{
+
+  /// Create an access for \p I, which must already be in the IR right before
+  /// the instruction of \p InsertPt, with \p Definition as its defining
+  /// access.  Creates a MemoryDef if \p I may write memory.  The caller is
+  /// responsible for rewiring later accesses that should now use a new def.
+  MemoryUseOrDef *createMemoryAccessBefore(Instruction *I,
+                                           MemoryAccess *Definition,
+                                           MemoryUseOrDef *InsertPt);
+  /// Same as createMemoryAccessBefore, but inserts after \p InsertPt.
+  MemoryUseOrDef *createMemoryAccessAfter(Instruction *I,
+                                          MemoryAccess *Definition,
+                                          MemoryAccess *InsertPt);
+
+  /// Replace every use of \p From with \p To.
+  void replaceAllUsesWith(MemoryAccess *From, MemoryAccess *To);
+
+  /// Remove \p MA from Memory SSA and delete it.  Users of a MemoryDef are
+  /// redirected to its defining access.  A MemoryPhi may only be removed if
+  /// it has no users or all its incoming values are the same.  This should
+  /// be called before the corresponding instruction is erased.
+  void removeMemoryAccess(MemoryAccess *MA);
+  /// @}
+
+  /// Abort with a message if Memory SSA is inconsistent with the function.
+  void verifyMemorySSA() const;
+
+  /// Print the function annotated with its memory accesses.
+  void print(raw_ostream &OS) const;
+  void dump() const;
+
+private:
+  void buildMemorySSA();
+  MemoryUseOrDef *createNewAccess(Instruction *I, BasicBlock *BB);
+  void renamePass();
+  void markUnreachableAsLiveOnEntry(BasicBlock *BB);
+  AccessList &getOrCreateAccessList(BasicBlock *BB);
+  void removeFromLookups(MemoryAccess *MA);
+
+  Function &F;
+  AliasAnalysis &AA;
+  DominatorTree &DT;
+
+  DenseMap<const Value *, MemoryAccess *> ValueToMemoryAccess;
+  DenseMap<const BasicBlock *, std::unique_ptr<AccessList>> PerBlockAccesses;
+  std::unique_ptr<MemoryDef> LiveOnEntryDef;
+  std::unique_ptr<MemorySSAWalker> Walker;
+  unsigned NextID;
+};
+
+/// \brief Answers clobber queries on top of Memory SSA.
+class MemorySSAWalker {
+public:
+  MemorySSAWalker(MemorySSA *MSSA) : MSSA(MSSA) {}
+  virtual ~MemorySSAWalker();
+
+  /// Return the access that clobbers the memory read or written by \p I.
+  /// For a MemoryDef this is the def it overwrites, not the def itself.
+  virtual MemoryAccess *getClobberingMemoryAccess(const Instruction *I) = 0;
+
+  /// Return the nearest access at or above \p Start that clobbers \p Loc.
+  virtual MemoryAccess *getClobberingMemoryAccess(MemoryAccess *Start,
+                                                  const MemoryLocation &Loc) = 0;
+
+  /// Forget anything cached about \p MA.  Called by the MemorySSA update API.
+  virtual void invalidateInfo(MemoryAccess *MA) {}
+
+protected:
+  MemorySSA *MSSA;
+};
+
+/// \brief A walker that does no alias analysis: the clobber of an access is
+/// its defining access.
+class DoNothingMemorySSAWalker final : public MemorySSAWalker {
+public:
+  DoNothingMemorySSAWalker(MemorySSA *MSSA) : MemorySSAWalker(MSSA) {}
+
+  MemoryAccess *getClobberingMemoryAccess(const Instruction *I) override;
+  MemoryAccess *getClobberingMemoryAccess(MemoryAccess *Start,
+                                          const MemoryLocation &Loc) override;
+};
+
+/// \brief A walker that uses alias analysis to skip defs that cannot clobber
+/// the queried location, looks through MemoryPhis whose incoming paths all
+/// lead to the same clobber, and caches every answer.
+class CachingMemorySSAWalker final : public MemorySSAWalker {
+public:
+  CachingMemorySSAWalker(MemorySSA *MSSA, AliasAnalysis &AA)
+      : MemorySSAWalker(MSSA), AA(AA), NumQueries(0), NumCacheHits(0) {}
+
+  MemoryAccess *getClobberingMemoryAccess(const Instruction *I) override;
+  MemoryAccess *getClobberingMemoryAccess(MemoryAccess *Start,
+                                          const MemoryLocation &Loc) override;
+  void invalidateInfo(MemoryAccess *MA) override;
+
+  unsigned getNumQueries() const { return NumQueries; }
+  unsigned getNumCacheHits() const { return NumCacheHits; }
+
+private:
+  /// What a walk is looking for: either a location, or everything a call
+  /// may touch.
+  struct Query {
+    MemoryLocation Loc;
+    const Instruction *Call;
+  };
+
+  MemoryAccess *walk(MemoryAccess *Start, const Query &Q);
+  MemoryAccess *walkPhi(MemoryPhi *Phi, const Query &Q,
+                        DenseMap<MemoryPhi *, MemoryAccess *> &PhiResults,
+                        SmallPtrSetImpl<MemoryPhi *> &InProgress);
+  MemoryAccess *walkFrom(MemoryAccess *Start, const Query &Q,
+                         DenseMap<MemoryPhi *, MemoryAccess *> &PhiResults,
+                         SmallPtrSetImpl<MemoryPhi *> &InProgress);
+  bool clobbers(MemoryDef *Def, const Query &Q);
+
+  AliasAnalysis &AA;
+  DenseMap<const Instruction *, MemoryAccess *> CachedInstClobbers;
+  DenseMap<std::pair<MemoryAccess *, MemoryLocation>, MemoryAccess *>
+      CachedLocClobbers;
+  unsigned NumQueries;
+  unsigned NumCacheHits;
+};
+
+/// \brief Legacy analysis pass which computes MemorySSA.
+class MemorySSAWrapperPass : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  MemorySSAWrapperPass();
+
+  MemorySSA &getMSSA() { return *MSSA; }
+  const MemorySSA &getMSSA() const { return *MSSA; }
+
+  bool runOnFunction(Function &F) override;
+  void releaseMemory() override;
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+  void verifyAnalysis() const override;
+  void print(raw_ostream &OS, const Module *M) const override;
+
+private:
+  std::unique_ptr<MemorySSA> MSSA;
+};
+
+/// Create a pass that builds Memory SSA.
+FunctionPass *createMemorySSAWrapperPass();
+
+} // End llvm namespace
+
+#endif
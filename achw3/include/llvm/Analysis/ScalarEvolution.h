@@ -23,6 +23,7 @@
 
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/FoldingSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/ConstantRange.h"
 #include "llvm/IR/Function.h"
@@ -495,6 +496,11 @@ namespace llvm {
       /// subexpression.
       bool hasOperand(const SCEV *S, ScalarEvolution *SE) const;
 
+      /// Add every expression that occurs in the backedge taken count
+      /// expressions, including their subexpressions, to Ops.
+      void getOperands(SmallPtrSetImpl<const SCEV *> &Ops,
+                       ScalarEvolution *SE) const;
+
       /// Invalidate this result and free associated memory.
       void clear();
     };
@@ -503,6 +509,12 @@ namespace llvm {
     /// are computed.
     DenseMap<const Loop*, BackedgeTakenInfo> BackedgeTakenCounts;
 
+    /// For each expression occurring in a cached backedge-taken count, the
+    /// loops whose count it occurs in.  This lets forgetMemoizedResults find
+    /// the counts to drop without scanning all of them.  Entries may be stale;
+    /// the counts themselves are always checked.
+    DenseMap<const SCEV *, SmallVector<const Loop *, 2>> BECountUsers;
+
     /// This map contains entries for all of the PHI instructions that we
     /// attempt to compute constant evolutions for.  This allows us to avoid
     /// potentially expensive recomputation of these properties.  An instruction
@@ -541,9 +553,22 @@ namespace llvm {
     /// Used to parameterize getRange
     enum RangeSignHint { HINT_RANGE_UNSIGNED, HINT_RANGE_SIGNED };
 
+    /// Return the number of entries in the caches above that are cheap to
+    /// recompute: ValuesAtScopes, the dispositions and the ranges.
+    unsigned getNumRecomputableCacheEntries() const;
+
+    /// If -scalar-evolution-max-cache-entries is set and the recomputable
+    /// caches have grown past it, drop them.  Must only be called where no
+    /// reference into those caches is live.
+    void evictRecomputableCachesIfNeeded();
+
+    /// Update the cache size statistics with the current sizes.
+    void noteCacheSizes() const;
+
     /// Set the memoized range for the given SCEV.
     const ConstantRange &setRange(const SCEV *S, RangeSignHint Hint,
                                   const ConstantRange &CR) {
+      evictRecomputableCachesIfNeeded();
       DenseMap<const SCEV *, ConstantRange> &Cache =
           Hint == HINT_RANGE_UNSIGNED ? UnsignedRanges : SignedRanges;
 
@@ -590,6 +615,16 @@ namespace llvm {
     /// reference SymName. This is used during PHI resolution.
     void ForgetSymbolicName(Instruction *I, const SCEV *SymName);
 
+    /// Drop the cached SCEVs of the given instructions and of everything that
+    /// uses them, directly or indirectly.  The walk stops at instructions
+    /// whose SCEV does not depend on their operands; their SCEVs and those of
+    /// their users stay, and only the dispositions that use them are dropped.
+    void forgetDefUseChains(ArrayRef<Instruction *> Roots);
+
+    /// Drop the cached dispositions of the SCEVs in Cut and of the SCEVs
+    /// that use them.
+    void forgetDispositions(const SmallPtrSetImpl<const SCEV *> &Cut);
+
     /// Return the BackedgeTakenInfo for the given loop, lazily computing new
     /// values if the loop hasn't been analyzed yet.
     const BackedgeTakenInfo &getBackedgeTakenInfo(const Loop *L);
@@ -761,9 +796,6 @@ namespace llvm {
     /// Drop memoized information computed for S.
     void forgetMemoizedResults(const SCEV *S);
 
-    /// Return an existing SCEV for V if there is one, otherwise return nullptr.
-    const SCEV *getExistingSCEV(Value *V);
-
     /// Return false iff given SCEV contains a SCEVUnknown with NULL value-
     /// pointer.
     bool checkValidity(const SCEV *S) const;
@@ -825,6 +857,9 @@ namespace llvm {
     /// expression.
     const SCEV *getSCEV(Value *V);
 
+    /// Return an existing SCEV for V if there is one, otherwise return nullptr.
+    const SCEV *getExistingSCEV(Value *V);
+
     const SCEV *getConstant(ConstantInt *V);
     const SCEV *getConstant(const APInt& Val);
     const SCEV *getConstant(Type *Ty, uint64_t V, bool isSigned = false);
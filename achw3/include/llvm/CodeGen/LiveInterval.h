@@ -190,8 +190,12 @@ namespace llvm {
       void dump() const;
     };
 
-    typedef SmallVector<Segment,4> Segments;
-    typedef SmallVector<VNInfo*,4> VNInfoList;
+    // There is one LiveRange per virtual register, and most of them are local
+    // to a block with a single value, so keep the inline storage small; large
+    // functions have hundreds of thousands of these.
+    enum { InlineSegments = 2, InlineValNos = 2 };
+    typedef SmallVector<Segment, InlineSegments> Segments;
+    typedef SmallVector<VNInfo*, InlineValNos> VNInfoList;
 
     Segments segments;   // the liveness segments
     VNInfoList valnos;   // value#'s
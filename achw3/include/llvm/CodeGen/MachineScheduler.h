@@ -89,6 +89,7 @@ extern cl::opt<bool> ForceTopDown;
 extern cl::opt<bool> ForceBottomUp;
 
 class LiveIntervals;
+class MachineBlockFrequencyInfo;
 class MachineDominatorTree;
 class MachineLoopInfo;
 class RegisterClassInfo;
@@ -105,6 +106,8 @@ struct MachineSchedContext {
   const TargetPassConfig *PassConfig;
   AliasAnalysis *AA;
   LiveIntervals *LIS;
+  /// Only available to schedulers that ask for block frequencies.
+  const MachineBlockFrequencyInfo *MBFI;
 
   RegisterClassInfo *RegClassInfo;
 
@@ -160,8 +163,17 @@ struct MachineSchedPolicy {
   // first.
   bool DisableLatencyHeuristic;
 
+  // Apply the latency heuristic even when the remaining schedule does not
+  // look latency limited.
+  bool ForceLatencyHeuristic;
+
+  // Before falling back to source order, prefer the node that makes the most
+  // other nodes ready, looking one step ahead.
+  bool EnableLookahead;
+
   MachineSchedPolicy(): ShouldTrackPressure(false), OnlyTopDown(false),
-    OnlyBottomUp(false), DisableLatencyHeuristic(false) {}
+    OnlyBottomUp(false), DisableLatencyHeuristic(false),
+    ForceLatencyHeuristic(false), EnableLookahead(false) {}
 };
 
 /// MachineSchedStrategy - Interface to the scheduling algorithm used by
@@ -185,6 +197,11 @@ public:
   /// initializing this strategy. Called after initPolicy.
   virtual bool shouldTrackPressure() const { return true; }
 
+  /// Check if the region should be scheduled at all. Returning false leaves
+  /// it in its original order without building a DAG. Called after
+  /// initPolicy.
+  virtual bool shouldScheduleRegion() const { return true; }
+
   /// Initialize the strategy after building the DAG for a new region.
   virtual void initialize(ScheduleDAGMI *DAG) = 0;
 
@@ -756,7 +773,7 @@ public:
   enum CandReason {
     NoCand, PhysRegCopy, RegExcess, RegCritical, Stall, Cluster, Weak, RegMax,
     ResourceReduce, ResourceDemand, BotHeightReduce, BotPathReduce,
-    TopDepthReduce, TopPathReduce, NextDefUse, NodeOrder};
+    TopDepthReduce, TopPathReduce, Lookahead, NextDefUse, NodeOrder};
 
 #ifndef NDEBUG
   static const char *getReasonStr(GenericSchedulerBase::CandReason Reason);
@@ -852,6 +869,7 @@ protected:
 /// GenericScheduler shrinks the unscheduled zone using heuristics to balance
 /// the schedule.
 class GenericScheduler : public GenericSchedulerBase {
+protected:
   ScheduleDAGMILive *DAG;
 
   // State of the top and bottom scheduled instruction boundaries.
@@ -431,6 +431,11 @@ private:
   /// Source line information.
   DebugLoc debugLoc;
 
+  /// Position of this node on the DAGCombiner worklist. This is -1 if the node
+  /// is not on the worklist and -2 if it has already been combined and not
+  /// been re-queued since.
+  int CombinerWorklistIndex;
+
   /// Return a pointer to the specified value type.
   static const EVT *getValueTypeList(EVT VT);
 
@@ -512,6 +517,13 @@ public:
   /// Set unique node id.
   void setNodeId(int Id) { NodeId = Id; }
 
+  /// Return the position of this node on the DAGCombiner worklist, or a
+  /// negative value if it is not on it.
+  int getCombinerWorklistIndex() const { return CombinerWorklistIndex; }
+
+  /// Set the position of this node on the DAGCombiner worklist.
+  void setCombinerWorklistIndex(int Index) { CombinerWorklistIndex = Index; }
+
   /// Return the node ordering.
   unsigned getIROrder() const { return IROrder; }
 
@@ -794,7 +806,8 @@ protected:
         SubclassData(0), NodeId(-1),
         OperandList(Ops.size() ? new SDUse[Ops.size()] : nullptr),
         ValueList(VTs.VTs), UseList(nullptr), NumOperands(Ops.size()),
-        NumValues(VTs.NumVTs), IROrder(Order), debugLoc(std::move(dl)) {
+        NumValues(VTs.NumVTs), IROrder(Order), debugLoc(std::move(dl)),
+        CombinerWorklistIndex(-1) {
     assert(debugLoc.hasTrivialDestructor() && "Expected trivial destructor");
     assert(NumOperands == Ops.size() &&
            "NumOperands wasn't wide enough for its operands!");
@@ -814,7 +827,7 @@ protected:
       : NodeType(Opc), OperandsNeedDelete(false), HasDebugValue(false),
         SubclassData(0), NodeId(-1), OperandList(nullptr), ValueList(VTs.VTs),
         UseList(nullptr), NumOperands(0), NumValues(VTs.NumVTs),
-        IROrder(Order), debugLoc(std::move(dl)) {
+        IROrder(Order), debugLoc(std::move(dl)), CombinerWorklistIndex(-1) {
     assert(debugLoc.hasTrivialDestructor() && "Expected trivial destructor");
     assert(NumValues == VTs.NumVTs &&
            "NumValues wasn't wide enough for its operands!");
@@ -130,6 +130,14 @@ public:
   /// \brief Provide an overload for a Use.
   bool isReachableFromEntry(const Use &U) const;
 
+  /// \brief Update the tree incrementally after a batch of CFG edge changes.
+  ///
+  /// See DominatorTreeBase::applyUpdates.  When -verify-dom-info is given the
+  /// result is checked against a freshly computed tree.
+  void applyUpdates(ArrayRef<UpdateType> Updates);
+  void insertEdge(BasicBlock *From, BasicBlock *To);
+  void deleteEdge(BasicBlock *From, BasicBlock *To);
+
   /// \brief Verify the correctness of the domtree by re-computing it.
   ///
   /// This should only be used for debugging as it aborts the program if the
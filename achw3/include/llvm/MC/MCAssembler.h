@@ -102,6 +102,10 @@ private:
 
   SectionListType Sections;
 
+  /// The fragments of each section, indexed by section ordinal, that may still
+  /// change size during relaxation. Only valid while layout() runs.
+  std::vector<std::vector<MCFragment *>> RelaxCandidates;
+
   SymbolDataListType Symbols;
 
   std::vector<IndirectSymbolData> IndirectSymbols;
@@ -179,9 +183,13 @@ private:
   bool layoutOnce(MCAsmLayout &Layout);
 
   /// \brief Perform one layout iteration of the given section and return true
-  /// if any offsets were adjusted.
+  /// if any offsets were adjusted. Only the section's relaxation candidates
+  /// are visited, and those that can no longer grow are dropped.
   bool layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec);
 
+  /// Return true if \p F may change size during relaxation.
+  bool isRelaxationCandidate(const MCFragment &F) const;
+
   bool relaxInstruction(MCAsmLayout &Layout, MCRelaxableFragment &IF);
 
   bool relaxLEB(MCAsmLayout &Layout, MCLEBFragment &IF);
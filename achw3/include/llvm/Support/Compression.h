@@ -15,6 +15,7 @@
 #define LLVM_SUPPORT_COMPRESSION_H
 
 #include "llvm/Support/DataTypes.h"
+#include <memory>
 
 namespace llvm {
 template <typename T> class SmallVectorImpl;
@@ -49,6 +50,26 @@ Status uncompress(StringRef InputBuffer,
 
 uint32_t crc32(StringRef Buffer);
 
+/// Incremental counterpart of compress(). The input is passed in pieces with
+/// write(), and the compressed data is appended to \p CompressedBuffer as it
+/// is produced, so the whole input never has to be held in memory at once.
+/// The result is the same zlib stream compress() would produce.
+class Compressor {
+  struct Impl;
+  std::unique_ptr<Impl> I;
+
+public:
+  Compressor(SmallVectorImpl<char> &CompressedBuffer,
+             CompressionLevel Level = DefaultCompression);
+  ~Compressor();
+
+  /// Compress \p InputBuffer. Errors are reported by finish().
+  void write(StringRef InputBuffer);
+
+  /// Flush the remaining output and return the status of the whole stream.
+  Status finish();
+};
+
 }  // End of namespace zlib
 
 } // End of namespace llvm
@@ -18,6 +18,7 @@
 #ifndef LLVM_SUPPORT_GENERICDOMTREE_H
 #define LLVM_SUPPORT_GENERICDOMTREE_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/GraphTraits.h"
@@ -25,6 +26,7 @@
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Compiler.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 
@@ -610,6 +612,68 @@ public:
       this->Split<NodeT *, GraphTraits<NodeT *>>(*this, NewBB);
   }
 
+  /// UpdateKind - Whether a CFG edge was added or removed.
+  enum UpdateKind { Insert, Delete };
+
+  /// UpdateType - A single CFG edge change, as passed to applyUpdates.
+  struct UpdateType {
+    UpdateKind Kind;
+    NodeT *From;
+    NodeT *To;
+
+    UpdateType(UpdateKind Kind, NodeT *From, NodeT *To)
+        : Kind(Kind), From(From), To(To) {}
+  };
+
+  /// applyUpdates - Bring the tree up to date after a batch of CFG edge
+  /// insertions and deletions, which must already have been made to the CFG.
+  /// Only the subtree rooted at the nearest common dominator of the changed
+  /// edges is recomputed, growing it only when blocks outside of it are
+  /// affected.  The cost is therefore proportional to that subtree rather than
+  /// to the function: an edit below a branch that only a small part of the
+  /// CFG hangs off is cheap, while an edit in straight-line code dominates
+  /// everything after it.  Once the subtree covers a large part of the tree,
+  /// the whole tree is recalculated instead, which is faster at that size.
+  /// Blocks that become reachable are added to the tree and blocks that
+  /// become unreachable are removed.  Only forward dominator trees can be
+  /// updated this way.
+  void applyUpdates(ArrayRef<UpdateType> Updates) {
+    assert(!this->isPostDominator() &&
+           "Incremental updates of post dominators are not supported!");
+
+    // Find the nearest common dominator of the endpoints that were reachable.
+    // Blocks that weren't in the tree can only become reachable through it.
+    DomTreeNodeBase<NodeT> *Top = nullptr;
+    for (const UpdateType &U : Updates) {
+      NodeT *Ends[] = {U.From, U.To};
+      for (NodeT *BB : Ends)
+        if (DomTreeNodeBase<NodeT> *N = getNode(BB))
+          Top = Top ? findNearestCommonDominatorNode(Top, N) : N;
+    }
+
+    // Edges between unreachable blocks don't change anything.
+    if (!Top)
+      return;
+
+    SmallVector<DomTreeNodeBase<NodeT> *, 4> Escaped;
+    while (!updateSubtree(Top, Escaped)) {
+      for (DomTreeNodeBase<NodeT> *N : Escaped)
+        Top = findNearestCommonDominatorNode(Top, N);
+      Escaped.clear();
+    }
+    DFSInfoValid = false;
+  }
+
+  /// insertEdge - Inform the tree that the CFG edge From -> To was added.
+  void insertEdge(NodeT *From, NodeT *To) {
+    applyUpdates(UpdateType(Insert, From, To));
+  }
+
+  /// deleteEdge - Inform the tree that the CFG edge From -> To was removed.
+  void deleteEdge(NodeT *From, NodeT *To) {
+    applyUpdates(UpdateType(Delete, From, To));
+  }
+
   /// print - Convert to human readable form
   ///
   void print(raw_ostream &o) const {
@@ -663,6 +727,158 @@ protected:
 
   void addRoot(NodeT *BB) { this->Roots.push_back(BB); }
 
+  /// findNearestCommonDominatorNode - Find the nearest common dominator of two
+  /// tree nodes by walking up from both.
+  DomTreeNodeBase<NodeT> *
+  findNearestCommonDominatorNode(DomTreeNodeBase<NodeT> *A,
+                                 DomTreeNodeBase<NodeT> *B) const {
+    SmallPtrSet<DomTreeNodeBase<NodeT> *, 16> ADoms;
+    for (DomTreeNodeBase<NodeT> *N = A; N; N = N->getIDom())
+      ADoms.insert(N);
+    for (DomTreeNodeBase<NodeT> *N = B; N; N = N->getIDom())
+      if (ADoms.count(N))
+        return N;
+    llvm_unreachable("Nodes of a forward dominator tree share the root!");
+  }
+
+  /// applyUpdates recalculates the whole tree rather than update a subtree
+  /// with more than 1/MaxSubtreeFraction of its nodes.
+  static const unsigned MaxSubtreeFraction = 4;
+
+  /// updateSubtree - Recompute the immediate dominators of every block in the
+  /// subtree rooted at Top, and of every block that has become reachable
+  /// through it, using the iterative algorithm of Cooper, Harvey and Kennedy
+  /// on the part of the CFG below Top.  This is valid because Top still
+  /// dominates its subtree after the updates.  If some block outside the
+  /// subtree may have changed too (it has a predecessor that became reachable
+  /// or unreachable), leave the tree alone, add that block to Escaped and
+  /// return false so that the caller can retry from a higher node.  A subtree
+  /// that is too large is not updated; the whole tree is recalculated.
+  bool updateSubtree(DomTreeNodeBase<NodeT> *Top,
+                     SmallVectorImpl<DomTreeNodeBase<NodeT> *> &Escaped) {
+    typedef GraphTraits<NodeT *> GraphT;
+
+    // Collect the blocks of the old subtree.
+    SmallVector<DomTreeNodeBase<NodeT> *, 32> Subtree;
+    SmallPtrSet<NodeT *, 32> InSubtree;
+    Subtree.push_back(Top);
+    for (unsigned i = 0; i != Subtree.size(); ++i) {
+      InSubtree.insert(Subtree[i]->getBlock());
+      Subtree.append(Subtree[i]->begin(), Subtree[i]->end());
+    }
+
+    // Updating most of the tree costs more than building it from scratch.
+    if (Subtree.size() * MaxSubtreeFraction > this->DomTreeNodes.size()) {
+      recalculate(*Top->getBlock()->getParent());
+      return true;
+    }
+
+    // Number the blocks reachable from Top in post order, not leaving the old
+    // subtree except into blocks that were unreachable, and record their
+    // predecessors on the way.
+    DenseMap<NodeT *, unsigned> PostNum;
+    DenseMap<NodeT *, SmallVector<NodeT *, 4>> Preds;
+    std::vector<NodeT *> PostOrder;
+    SmallPtrSet<NodeT *, 32> Visited;
+    SmallVector<std::pair<NodeT *, typename GraphT::ChildIteratorType>, 32>
+        Stack;
+    Visited.insert(Top->getBlock());
+    Stack.push_back(
+        std::make_pair(Top->getBlock(), GraphT::child_begin(Top->getBlock())));
+    while (!Stack.empty()) {
+      NodeT *BB = Stack.back().first;
+      if (Stack.back().second == GraphT::child_end(BB)) {
+        PostNum[BB] = PostOrder.size();
+        PostOrder.push_back(BB);
+        Stack.pop_back();
+        continue;
+      }
+
+      NodeT *Succ = *Stack.back().second++;
+      if (DomTreeNodeBase<NodeT> *SuccNode = getNode(Succ)) {
+        if (!InSubtree.count(Succ)) {
+          // Edges from the old subtree to the rest of the tree are untouched,
+          // but a newly reachable block gives Succ another path.
+          if (!getNode(BB))
+            Escaped.push_back(SuccNode);
+          continue;
+        }
+      }
+
+      Preds[Succ].push_back(BB);
+      if (Visited.insert(Succ).second)
+        Stack.push_back(std::make_pair(Succ, GraphT::child_begin(Succ)));
+    }
+
+    // Blocks of the old subtree that weren't reached are now unreachable, and
+    // so no longer provide a path to their successors.
+    SmallVector<DomTreeNodeBase<NodeT> *, 8> Unreachable;
+    for (DomTreeNodeBase<NodeT> *N : Subtree) {
+      if (Visited.count(N->getBlock()))
+        continue;
+      Unreachable.push_back(N);
+      for (typename GraphT::ChildIteratorType SI =
+               GraphT::child_begin(N->getBlock()),
+               SE = GraphT::child_end(N->getBlock());
+           SI != SE; ++SI)
+        if (DomTreeNodeBase<NodeT> *SuccNode = getNode(*SI))
+          if (!InSubtree.count(*SI))
+            Escaped.push_back(SuccNode);
+    }
+
+    if (!Escaped.empty())
+      return false;
+
+    // Iterate to a fixed point in reverse post order.
+    DenseMap<NodeT *, NodeT *> NewIDoms;
+    NewIDoms[Top->getBlock()] = Top->getBlock();
+    auto Intersect = [&](NodeT *A, NodeT *B) {
+      while (A != B) {
+        while (PostNum[A] < PostNum[B])
+          A = NewIDoms[A];
+        while (PostNum[B] < PostNum[A])
+          B = NewIDoms[B];
+      }
+      return A;
+    };
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (auto I = PostOrder.rbegin() + 1, E = PostOrder.rend(); I != E;
+           ++I) {
+        NodeT *NewIDom = nullptr;
+        for (NodeT *Pred : Preds[*I]) {
+          if (!NewIDoms.count(Pred))
+            continue;
+          NewIDom = NewIDom ? Intersect(Pred, NewIDom) : Pred;
+        }
+        NodeT *&IDom = NewIDoms[*I];
+        if (IDom != NewIDom) {
+          IDom = NewIDom;
+          Changed = true;
+        }
+      }
+    }
+
+    // Relink the subtree.  Reverse post order visits every immediate
+    // dominator before the blocks it dominates.
+    for (DomTreeNodeBase<NodeT> *N : Subtree)
+      N->Children.clear();
+    for (auto I = PostOrder.rbegin() + 1, E = PostOrder.rend(); I != E; ++I) {
+      DomTreeNodeBase<NodeT> *IDomNode = getNode(NewIDoms[*I]);
+      if (DomTreeNodeBase<NodeT> *N = getNode(*I)) {
+        N->IDom = IDomNode;
+        IDomNode->Children.push_back(N);
+      } else {
+        DomTreeNodes[*I] = IDomNode->addChild(
+            llvm::make_unique<DomTreeNodeBase<NodeT>>(*I, IDomNode));
+      }
+    }
+    for (DomTreeNodeBase<NodeT> *N : Unreachable)
+      DomTreeNodes.erase(N->getBlock());
+    return true;
+  }
+
 public:
   /// updateDFSNumbers - Assign In and Out numbers to the nodes while walking
   /// dominator tree in dfs order.
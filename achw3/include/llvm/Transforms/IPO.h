@@ -109,6 +109,12 @@ Pass *createFunctionInliningPass(unsigned OptLevel, unsigned SizeOptLevel);
 Pass *createAlwaysInlinerPass();
 Pass *createAlwaysInlinerPass(bool InsertLifetime);
 
+//===----------------------------------------------------------------------===//
+/// createPriorityInlinerPass - Return a new pass object that ranks all call
+/// sites in the module by profile count and size, and inlines them in that
+/// order under a module-wide size budget.
+ModulePass *createPriorityInlinerPass();
+
 //===----------------------------------------------------------------------===//
 /// createPruneEHPass - Return a new pass object which transforms invoke
 /// instructions into calls, if the callee can _not_ unwind the stack.
@@ -209,6 +215,12 @@ ModulePass *createMergeFunctionsPass();
 ///
 ModulePass *createPartialInliningPass();
 
+//===----------------------------------------------------------------------===//
+/// createHotColdSplittingPass - This pass outlines the regions of profiled
+/// functions that are never executed into cold functions.
+///
+ModulePass *createHotColdSplittingPass();
+
 //===----------------------------------------------------------------------===//
 // createMetaRenamerPass - Rename everything with metasyntatic names.
 //
@@ -27,6 +27,12 @@ class InstCombineWorklist {
   SmallVector<Instruction*, 256> Worklist;
   DenseMap<Instruction*, unsigned> WorklistMap;
 
+  /// Number of instructions queued by Add after a change.
+  unsigned NumRequeued = 0;
+  /// Number of adds that were dropped because the instruction was already
+  /// queued.
+  unsigned NumDuplicateAdds = 0;
+
   void operator=(const InstCombineWorklist&RHS) = delete;
   InstCombineWorklist(const InstCombineWorklist&) = delete;
 public:
@@ -34,10 +40,13 @@ public:
 
   InstCombineWorklist(InstCombineWorklist &&Arg)
       : Worklist(std::move(Arg.Worklist)),
-        WorklistMap(std::move(Arg.WorklistMap)) {}
+        WorklistMap(std::move(Arg.WorklistMap)), NumRequeued(Arg.NumRequeued),
+        NumDuplicateAdds(Arg.NumDuplicateAdds) {}
   InstCombineWorklist &operator=(InstCombineWorklist &&RHS) {
     Worklist = std::move(RHS.Worklist);
     WorklistMap = std::move(RHS.WorklistMap);
+    NumRequeued = RHS.NumRequeued;
+    NumDuplicateAdds = RHS.NumDuplicateAdds;
     return *this;
   }
 
@@ -49,6 +58,9 @@ public:
     if (WorklistMap.insert(std::make_pair(I, Worklist.size())).second) {
       DEBUG(dbgs() << "IC: ADD: " << *I << '\n');
       Worklist.push_back(I);
+      ++NumRequeued;
+    } else {
+      ++NumDuplicateAdds;
     }
   }
 
@@ -99,6 +111,16 @@ public:
   }
 
 
+  /// getNumRequeued - Return the number of instructions that were re-queued
+  /// after a change since the last call to resetCounters.
+  unsigned getNumRequeued() const { return NumRequeued; }
+
+  /// getNumDuplicateAdds - Return the number of adds that were dropped as
+  /// duplicates since the last call to resetCounters.
+  unsigned getNumDuplicateAdds() const { return NumDuplicateAdds; }
+
+  void resetCounters() { NumRequeued = NumDuplicateAdds = 0; }
+
   /// Zap - check that the worklist is empty and nuke the backing store for
   /// the map if it is large.
   void Zap() {
@@ -16,7 +16,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Analysis/CallGraphSCCPass.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/IR/Function.h"
@@ -34,7 +36,14 @@ using namespace llvm;
 static cl::opt<unsigned> 
 MaxIterations("max-cg-scc-iterations", cl::ReallyHidden, cl::init(4));
 
+static cl::opt<bool>
+DAGSchedule("cgscc-dag-schedule", cl::Hidden, cl::init(false),
+            cl::desc("Run the SCCs as they become ready in the SCC DAG rather "
+                     "than in depth-first post-order"));
+
 STATISTIC(MaxSCCIterations, "Maximum CGSCCPassMgr iterations on one SCC");
+STATISTIC(MaxReadySCCs, "Maximum number of SCCs ready to run at once");
+STATISTIC(NumSCCWaves, "Number of SCCs on the longest chain of callers");
 
 //===----------------------------------------------------------------------===//
 // CGPassManager
@@ -93,6 +102,10 @@ public:
   }
   
 private:
+  bool RunToFixpointOnSCC(CallGraphSCC &CurSCC, CallGraph &CG);
+
+  bool RunInDAGOrder(CallGraph &CG);
+
   bool RunAllPassesOnSCC(CallGraphSCC &CurSCC, CallGraph &CG,
                          bool &DevirtualizedCall);
   
@@ -435,11 +448,116 @@ bool CGPassManager::RunAllPassesOnSCC(CallGraphSCC &CurSCC, CallGraph &CG,
   return Changed;
 }
 
+/// Run all passes on \p CurSCC, and run them again as long as they
+/// devirtualize calls, up to -max-cg-scc-iterations times.
+bool CGPassManager::RunToFixpointOnSCC(CallGraphSCC &CurSCC, CallGraph &CG) {
+  bool Changed = false;
+
+  // At the top level, we run all the passes in this pass manager on the
+  // functions in this SCC.  However, we support iterative compilation in the
+  // case where a function pass devirtualizes a call to a function.  For
+  // example, it is very common for a function pass (often GVN or instcombine)
+  // to eliminate the addressing that feeds into a call.  With that improved
+  // information, we would like the call to be an inline candidate, infer
+  // mod-ref information etc.
+  //
+  // Because of this, we allow iteration up to a specified iteration count.
+  // This only happens in the case of a devirtualized call, so we only burn
+  // compile time in the case that we're making progress.  We also have a hard
+  // iteration count limit in case there is crazy code.
+  unsigned Iteration = 0;
+  bool DevirtualizedCall = false;
+  do {
+    DEBUG(if (Iteration)
+            dbgs() << "  SCCPASSMGR: Re-visiting SCC, iteration #"
+                   << Iteration << '\n');
+    DevirtualizedCall = false;
+    Changed |= RunAllPassesOnSCC(CurSCC, CG, DevirtualizedCall);
+  } while (Iteration++ < MaxIterations && DevirtualizedCall);
+  
+  if (DevirtualizedCall)
+    DEBUG(dbgs() << "  CGSCCPASSMGR: Stopped iteration after " << Iteration
+                 << " times, due to -max-cg-scc-iterations\n");
+  
+  if (Iteration > MaxSCCIterations)
+    MaxSCCIterations = Iteration;
+
+  return Changed;
+}
+
+/// Run the SCCs of \p CG in an order in which every SCC runs once all SCCs it
+/// calls have run, taking them from a queue of SCCs whose callees are done.
+/// This is the order in which independent SCCs could be handed to separate
+/// workers; they are still run one at a time, as the functions of a module
+/// share one LLVMContext.
+bool CGPassManager::RunInDAGOrder(CallGraph &CG) {
+  // Find the SCCs up front. scc_iterator produces callees before callers, so
+  // the callee SCCs of an SCC always have smaller numbers.
+  std::vector<std::vector<CallGraphNode *>> SCCs;
+  DenseMap<CallGraphNode *, unsigned> SCCNumbers;
+  for (scc_iterator<CallGraph*> CGI = scc_begin(&CG); !CGI.isAtEnd(); ++CGI) {
+    for (CallGraphNode *Node : *CGI)
+      SCCNumbers[Node] = SCCs.size();
+    SCCs.push_back(*CGI);
+  }
+
+  // Link every SCC to its callers, and count the callee SCCs it waits for.
+  std::vector<SmallVector<unsigned, 4>> Callers(SCCs.size());
+  std::vector<unsigned> PendingCallees(SCCs.size(), 0);
+  std::vector<unsigned> Depth(SCCs.size(), 1);
+  for (unsigned SCCNo = 0, E = SCCs.size(); SCCNo != E; ++SCCNo) {
+    SmallSet<unsigned, 8> CalleeSCCs;
+    for (CallGraphNode *Node : SCCs[SCCNo])
+      for (const CallGraphNode::CallRecord &CR : *Node) {
+        auto I = SCCNumbers.find(CR.second);
+        if (I == SCCNumbers.end() || I->second == SCCNo ||
+            !CalleeSCCs.insert(I->second).second)
+          continue;
+        unsigned CalleeNo = I->second;
+        assert(CalleeNo < SCCNo && "Callee SCC after its caller");
+        Callers[CalleeNo].push_back(SCCNo);
+        ++PendingCallees[SCCNo];
+        Depth[SCCNo] = std::max(Depth[SCCNo], Depth[CalleeNo] + 1);
+      }
+    if (Depth[SCCNo] > NumSCCWaves)
+      NumSCCWaves = Depth[SCCNo];
+  }
+
+  SmallVector<unsigned, 32> Ready;
+  for (unsigned SCCNo = 0, E = SCCs.size(); SCCNo != E; ++SCCNo)
+    if (!PendingCallees[SCCNo])
+      Ready.push_back(SCCNo);
+
+  bool Changed = false;
+  CallGraphSCC CurSCC(nullptr);
+  for (unsigned Next = 0; Next != Ready.size(); ++Next) {
+    if (Ready.size() - Next > MaxReadySCCs)
+      MaxReadySCCs = Ready.size() - Next;
+
+    unsigned SCCNo = Ready[Next];
+    CurSCC.initialize(SCCs[SCCNo].data(),
+                      SCCs[SCCNo].data() + SCCs[SCCNo].size());
+    Changed |= RunToFixpointOnSCC(CurSCC, CG);
+
+    for (unsigned CallerNo : Callers[SCCNo])
+      if (--PendingCallees[CallerNo] == 0)
+        Ready.push_back(CallerNo);
+  }
+  assert(Ready.size() == SCCs.size() && "SCC left waiting for its callees");
+  return Changed;
+}
+
 /// Execute all of the passes scheduled for execution.  Keep track of
 /// whether any of the passes modifies the module, and if so, return true.
 bool CGPassManager::runOnModule(Module &M) {
   CallGraph &CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
   bool Changed = doInitialization(CG);
+
+  if (DAGSchedule) {
+    Changed |= RunInDAGOrder(CG);
+    Changed |= doFinalization(CG);
+    return Changed;
+  }
   
   // Walk the callgraph in bottom-up SCC order.
   scc_iterator<CallGraph*> CGI = scc_begin(&CG);
@@ -452,35 +570,7 @@ bool CGPassManager::runOnModule(Module &M) {
     CurSCC.initialize(NodeVec.data(), NodeVec.data() + NodeVec.size());
     ++CGI;
 
-    // At the top level, we run all the passes in this pass manager on the
-    // functions in this SCC.  However, we support iterative compilation in the
-    // case where a function pass devirtualizes a call to a function.  For
-    // example, it is very common for a function pass (often GVN or instcombine)
-    // to eliminate the addressing that feeds into a call.  With that improved
-    // information, we would like the call to be an inline candidate, infer
-    // mod-ref information etc.
-    //
-    // Because of this, we allow iteration up to a specified iteration count.
-    // This only happens in the case of a devirtualized call, so we only burn
-    // compile time in the case that we're making progress.  We also have a hard
-    // iteration count limit in case there is crazy code.
-    unsigned Iteration = 0;
-    bool DevirtualizedCall = false;
-    do {
-      DEBUG(if (Iteration)
-              dbgs() << "  SCCPASSMGR: Re-visiting SCC, iteration #"
-                     << Iteration << '\n');
-      DevirtualizedCall = false;
-      Changed |= RunAllPassesOnSCC(CurSCC, CG, DevirtualizedCall);
-    } while (Iteration++ < MaxIterations && DevirtualizedCall);
-    
-    if (DevirtualizedCall)
-      DEBUG(dbgs() << "  CGSCCPASSMGR: Stopped iteration after " << Iteration
-                   << " times, due to -max-cg-scc-iterations\n");
-    
-    if (Iteration > MaxSCCIterations)
-      MaxSCCIterations = Iteration;
-    
+    Changed |= RunToFixpointOnSCC(CurSCC, CG);
   }
   Changed |= doFinalization(CG);
   return Changed;
@@ -533,9 +623,10 @@ void CallGraphSCC::ReplaceNode(CallGraphNode *Old, CallGraphNode *New) {
   }
   
   // Update the active scc_iterator so that it doesn't contain dangling
-  // pointers to the old CallGraphNode.
-  scc_iterator<CallGraph*> *CGI = (scc_iterator<CallGraph*>*)Context;
-  CGI->ReplaceNode(Old, New);
+  // pointers to the old CallGraphNode. When the SCCs are run from the SCC DAG
+  // there is no iterator, and Old cannot be in any SCC that is still to come.
+  if (scc_iterator<CallGraph*> *CGI = (scc_iterator<CallGraph*>*)Context)
+    CGI->ReplaceNode(Old, New);
 }
 
 
@@ -72,7 +72,7 @@ INITIALIZE_PASS_END(MemoryDependenceAnalysis, "memdep",
                       "Memory Dependence Analysis", false, true)
 
 MemoryDependenceAnalysis::MemoryDependenceAnalysis()
-    : FunctionPass(ID) {
+    : FunctionPass(ID), NumBlocksWalked(0), BlockWalkLimit(~0U) {
   initializeMemoryDependenceAnalysisPass(*PassRegistry::getPassRegistry());
 }
 MemoryDependenceAnalysis::~MemoryDependenceAnalysis() {
@@ -949,7 +949,10 @@ MemoryDependenceAnalysis::getNonLocalCallDependency(CallSite QueryCS) {
 ///
 void MemoryDependenceAnalysis::
 getNonLocalPointerDependency(Instruction *QueryInst,
-                             SmallVectorImpl<NonLocalDepResult> &Result) {
+                             SmallVectorImpl<NonLocalDepResult> &Result,
+                             unsigned *NumBlocks, unsigned BlockLimit) {
+  if (NumBlocks)
+    *NumBlocks = 0;
   const MemoryLocation Loc = MemoryLocation::get(QueryInst);
   bool isLoad = isa<LoadInst>(QueryInst);
   BasicBlock *FromBB = QueryInst->getParent();
@@ -989,8 +992,13 @@ getNonLocalPointerDependency(Instruction *QueryInst,
   // a block with multiple different pointers.  This can happen during PHI
   // translation.
   DenseMap<BasicBlock*, Value*> Visited;
-  if (!getNonLocalPointerDepFromBB(QueryInst, Address, Loc, isLoad, FromBB,
-                                   Result, Visited, true))
+  NumBlocksWalked = 0;
+  BlockWalkLimit = BlockLimit;
+  bool Failed = getNonLocalPointerDepFromBB(QueryInst, Address, Loc, isLoad,
+                                            FromBB, Result, Visited, true);
+  if (NumBlocks)
+    *NumBlocks = NumBlocksWalked;
+  if (!Failed)
     return;
   Result.clear();
   Result.push_back(NonLocalDepResult(FromBB,
@@ -1206,6 +1214,7 @@ bool MemoryDependenceAnalysis::getNonLocalPointerDepFromBB(
     }
 
     Value *Addr = Pointer.getAddr();
+    NumBlocksWalked += Cache->size();
     for (NonLocalDepInfo::iterator I = Cache->begin(), E = Cache->end();
          I != E; ++I) {
       Visited.insert(std::make_pair(I->getBB(), Addr));
@@ -1252,8 +1261,9 @@ bool MemoryDependenceAnalysis::getNonLocalPointerDepFromBB(
     BasicBlock *BB = Worklist.pop_back_val();
 
     // If we do process a large number of blocks it becomes very expensive and
-    // likely it isn't worth worrying about
-    if (Result.size() > NumResultsLimit) {
+    // likely it isn't worth worrying about.  The same goes for walks that are
+    // longer than the client allows.
+    if (Result.size() > NumResultsLimit || NumBlocksWalked >= BlockWalkLimit) {
       Worklist.clear();
       // Sort it now (if needed) so that recursive invocations of
       // getNonLocalPointerDepFromBB and other routines that could reuse the
@@ -1268,6 +1278,7 @@ bool MemoryDependenceAnalysis::getNonLocalPointerDepFromBB(
       CacheInfo->Pair = BBSkipFirstBlockPair();
       return true;
     }
+    ++NumBlocksWalked;
 
     // Skip the first block if we have it.
     if (!SkipFirstBlock) {
@@ -0,0 +1,727 @@
+//===- MemorySSA.cpp - Memory SSA Builder ---------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the MemorySSA class and its clobber walkers.
+//
+// Construction is the classic SSA algorithm with all of memory treated as one
+// variable: MemoryPhis are placed at the iterated dominance frontier of the
+// blocks containing MemoryDefs, then a walk over the dominator tree links
+// every access to the nearest dominating definition.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/IteratedDominanceFrontier.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "memoryssa"
+
+static cl::opt<bool>
+VerifyMemorySSA("verify-memoryssa", cl::init(false), cl::Hidden,
+                cl::desc("Verify MemorySSA after it is built"));
+
+//===----------------------------------------------------------------------===//
+// Memory accesses
+//===----------------------------------------------------------------------===//
+
+MemoryAccess::~MemoryAccess() {}
+
+void MemoryAccess::removeUser(MemoryAccess *User) {
+  auto I = std::find(Users.begin(), Users.end(), User);
+  assert(I != Users.end() && "Not a user of this access!");
+  Users.erase(I);
+}
+
+void MemoryAccess::printAsOperand(raw_ostream &OS) const {
+  if (const auto *MD = dyn_cast<MemoryDef>(this)) {
+    if (!MD->getMemoryInst())
+      OS << "liveOnEntry";
+    else
+      OS << MD->getID();
+  } else if (const auto *MP = dyn_cast<MemoryPhi>(this)) {
+    OS << MP->getID();
+  } else {
+    llvm_unreachable("A MemoryUse cannot be an operand!");
+  }
+}
+
+void MemoryAccess::print(raw_ostream &OS) const {
+  switch (getKind()) {
+  case MemoryUseKind:
+    OS << "MemoryUse(";
+    cast<MemoryUse>(this)->getDefiningAccess()->printAsOperand(OS);
+    OS << ')';
+    break;
+  case MemoryDefKind: {
+    const auto *MD = cast<MemoryDef>(this);
+    if (!MD->getMemoryInst()) {
+      OS << "liveOnEntry";
+      break;
+    }
+    OS << MD->getID() << " = MemoryDef(";
+    MD->getDefiningAccess()->printAsOperand(OS);
+    OS << ')';
+    break;
+  }
+  case MemoryPhiKind: {
+    const auto *MP = cast<MemoryPhi>(this);
+    OS << MP->getID() << " = MemoryPhi(";
+    bool First = true;
+    for (const auto &Entry : MP->incoming()) {
+      if (!First)
+        OS << ',';
+      First = false;
+      OS << '{';
+      if (Entry.first->hasName())
+        OS << Entry.first->getName();
+      else
+        Entry.first->printAsOperand(OS, false);
+      OS << ',';
+      Entry.second->printAsOperand(OS);
+      OS << '}';
+    }
+    OS << ')';
+    break;
+  }
+  }
+}
+
+void MemoryAccess::dump() const {
+  print(dbgs());
+  dbgs() << "\n";
+}
+
+void MemoryUseOrDef::setDefiningAccess(MemoryAccess *DMA) {
+  if (DefiningAccess)
+    DefiningAccess->removeUser(this);
+  DefiningAccess = DMA;
+  if (DMA)
+    DMA->addUser(this);
+}
+
+void MemoryPhi::addIncoming(BasicBlock *BB, MemoryAccess *MA) {
+  Incoming.push_back(std::make_pair(BB, MA));
+  MA->addUser(this);
+}
+
+void MemoryPhi::setIncomingValue(unsigned I, MemoryAccess *MA) {
+  Incoming[I].second->removeUser(this);
+  Incoming[I].second = MA;
+  MA->addUser(this);
+}
+
+//===----------------------------------------------------------------------===//
+// MemorySSA construction
+//===----------------------------------------------------------------------===//
+
+MemorySSA::MemorySSA(Function &F, AliasAnalysis &AA, DominatorTree &DT)
+    : F(F), AA(AA), DT(DT), NextID(0) {
+  buildMemorySSA();
+}
+
+MemorySSA::~MemorySSA() {
+  Walker.reset();
+  for (auto &Entry : PerBlockAccesses)
+    for (MemoryAccess *MA : *Entry.second)
+      delete MA;
+}
+
+MemorySSA::AccessList &MemorySSA::getOrCreateAccessList(BasicBlock *BB) {
+  std::unique_ptr<AccessList> &Accesses = PerBlockAccesses[BB];
+  if (!Accesses)
+    Accesses.reset(new AccessList());
+  return *Accesses;
+}
+
+/// Create the MemoryUse or MemoryDef for \p I, or return null if \p I does
+/// not touch memory.  The access is not added to any block list.
+MemoryUseOrDef *MemorySSA::createNewAccess(Instruction *I, BasicBlock *BB) {
+  // AAResults::getModRefInfo(I) reports any call that reads memory as ModRef,
+  // so ask for the behavior of calls directly.
+  ModRefInfo ModRef;
+  if (auto CS = ImmutableCallSite(I))
+    ModRef = ModRefInfo(AA.getModRefBehavior(CS) & MRI_ModRef);
+  else
+    ModRef = AA.getModRefInfo(I);
+  if (!(ModRef & MRI_ModRef))
+    return nullptr;
+
+  MemoryUseOrDef *MUD;
+  if (ModRef & MRI_Mod)
+    MUD = new MemoryDef(I, BB, NextID++);
+  else
+    MUD = new MemoryUse(I, BB);
+  ValueToMemoryAccess[I] = MUD;
+  return MUD;
+}
+
+void MemorySSA::buildMemorySSA() {
+  // liveOnEntry takes ID 0, so real definitions are numbered from 1.
+  LiveOnEntryDef.reset(new MemoryDef(nullptr, &F.getEntryBlock(), NextID++));
+
+  // Create an access for every memory operation, and remember where the
+  // definitions are.  Unreachable blocks take no part in phi placement.
+  SmallPtrSet<BasicBlock *, 32> DefiningBlocks;
+  DenseMap<const BasicBlock *, unsigned> BlockNumbers;
+  unsigned NextBlockNumber = 0;
+  for (BasicBlock &BB : F) {
+    BlockNumbers[&BB] = NextBlockNumber++;
+    for (Instruction &I : BB) {
+      MemoryUseOrDef *MUD = createNewAccess(&I, &BB);
+      if (!MUD)
+        continue;
+      getOrCreateAccessList(&BB).push_back(MUD);
+      if (isa<MemoryDef>(MUD) && DT.isReachableFromEntry(&BB))
+        DefiningBlocks.insert(&BB);
+    }
+  }
+
+  // Place MemoryPhis.  Number them in function order so the IDs do not
+  // depend on the order the IDF calculation produces blocks in.
+  IDFCalculator IDFs(DT);
+  IDFs.setDefiningBlocks(DefiningBlocks);
+  SmallVector<BasicBlock *, 32> IDFBlocks;
+  IDFs.calculate(IDFBlocks);
+  std::sort(IDFBlocks.begin(), IDFBlocks.end(),
+            [&](const BasicBlock *A, const BasicBlock *B) {
+              return BlockNumbers.lookup(A) < BlockNumbers.lookup(B);
+            });
+  for (BasicBlock *BB : IDFBlocks) {
+    MemoryPhi *Phi = new MemoryPhi(BB, NextID++);
+    ValueToMemoryAccess[BB] = Phi;
+    AccessList &Accesses = getOrCreateAccessList(BB);
+    Accesses.insert(Accesses.begin(), Phi);
+  }
+
+  renamePass();
+
+  // Nothing flows into an unreachable block, so treat everything in it as
+  // reading the state on entry.
+  for (BasicBlock &BB : F)
+    if (!DT.isReachableFromEntry(&BB))
+      markUnreachableAsLiveOnEntry(&BB);
+}
+
+/// Walk the dominator tree in preorder, linking every access to the nearest
+/// dominating definition and filling in the incoming values of MemoryPhis.
+void MemorySSA::renamePass() {
+  auto RenameBlock = [&](BasicBlock *BB, MemoryAccess *IncomingVal) {
+    auto It = PerBlockAccesses.find(BB);
+    if (It != PerBlockAccesses.end()) {
+      for (MemoryAccess *MA : *It->second) {
+        if (isa<MemoryPhi>(MA)) {
+          IncomingVal = MA;
+          continue;
+        }
+        auto *MUD = cast<MemoryUseOrDef>(MA);
+        MUD->setDefiningAccess(IncomingVal);
+        if (isa<MemoryDef>(MUD))
+          IncomingVal = MUD;
+      }
+    }
+    for (BasicBlock *Succ : successors(BB))
+      if (MemoryPhi *Phi = getMemoryAccess(Succ))
+        Phi->addIncoming(BB, IncomingVal);
+    return IncomingVal;
+  };
+
+  struct RenameFrame {
+    DomTreeNode *Node;
+    DomTreeNode::iterator ChildIt;
+    MemoryAccess *IncomingVal;
+  };
+  SmallVector<RenameFrame, 32> WorkStack;
+  DomTreeNode *Root = DT.getRootNode();
+  WorkStack.push_back({Root, Root->begin(),
+                       RenameBlock(Root->getBlock(), LiveOnEntryDef.get())});
+  while (!WorkStack.empty()) {
+    RenameFrame &Top = WorkStack.back();
+    if (Top.ChildIt == Top.Node->end()) {
+      WorkStack.pop_back();
+      continue;
+    }
+    DomTreeNode *Child = *Top.ChildIt++;
+    MemoryAccess *IncomingVal = RenameBlock(Child->getBlock(), Top.IncomingVal);
+    WorkStack.push_back({Child, Child->begin(), IncomingVal});
+  }
+}
+
+void MemorySSA::markUnreachableAsLiveOnEntry(BasicBlock *BB) {
+  for (BasicBlock *Succ : successors(BB))
+    if (MemoryPhi *Phi = getMemoryAccess(Succ))
+      Phi->addIncoming(BB, LiveOnEntryDef.get());
+
+  auto It = PerBlockAccesses.find(BB);
+  if (It == PerBlockAccesses.end())
+    return;
+  for (MemoryAccess *MA : *It->second)
+    cast<MemoryUseOrDef>(MA)->setDefiningAccess(LiveOnEntryDef.get());
+}
+
+//===----------------------------------------------------------------------===//
+// Queries
+//===----------------------------------------------------------------------===//
+
+MemoryUseOrDef *MemorySSA::getMemoryAccess(const Instruction *I) const {
+  return cast_or_null<MemoryUseOrDef>(ValueToMemoryAccess.lookup(I));
+}
+
+MemoryPhi *MemorySSA::getMemoryAccess(const BasicBlock *BB) const {
+  return cast_or_null<MemoryPhi>(ValueToMemoryAccess.lookup(BB));
+}
+
+const MemorySSA::AccessList *
+MemorySSA::getBlockAccesses(const BasicBlock *BB) const {
+  auto It = PerBlockAccesses.find(BB);
+  return It == PerBlockAccesses.end() ? nullptr : It->second.get();
+}
+
+bool MemorySSA::dominates(const MemoryAccess *Dominator,
+                          const MemoryAccess *Dominatee) const {
+  if (Dominator == Dominatee || isLiveOnEntryDef(Dominator))
+    return true;
+  if (isLiveOnEntryDef(Dominatee))
+    return false;
+  if (Dominator->getBlock() != Dominatee->getBlock())
+    return DT.dominates(Dominator->getBlock(), Dominatee->getBlock());
+
+  for (const MemoryAccess *MA : *getBlockAccesses(Dominator->getBlock())) {
+    if (MA == Dominator)
+      return true;
+    if (MA == Dominatee)
+      return false;
+  }
+  llvm_unreachable("Access is not in its block's access list!");
+}
+
+MemorySSAWalker *MemorySSA::getWalker() {
+  if (!Walker)
+    Walker.reset(new CachingMemorySSAWalker(this, AA));
+  return Walker.get();
+}
+
+//===----------------------------------------------------------------------===//
+// Update API
+//===----------------------------------------------------------------------===//
+
+MemoryUseOrDef *MemorySSA::createMemoryAccessBefore(Instruction *I,
+                                                    MemoryAccess *Definition,
+                                                    MemoryUseOrDef *InsertPt) {
+  BasicBlock *BB = InsertPt->getBlock();
+  assert(I->getParent() == BB && "Instruction is not in the access's block!");
+  MemoryUseOrDef *NewAccess = createNewAccess(I, BB);
+  assert(NewAccess && "Instruction does not access memory!");
+  NewAccess->setDefiningAccess(Definition);
+
+  AccessList &Accesses = getOrCreateAccessList(BB);
+  Accesses.insert(std::find(Accesses.begin(), Accesses.end(), InsertPt),
+                  NewAccess);
+  if (Walker)
+    Walker->invalidateInfo(NewAccess);
+  return NewAccess;
+}
+
+MemoryUseOrDef *MemorySSA::createMemoryAccessAfter(Instruction *I,
+                                                   MemoryAccess *Definition,
+                                                   MemoryAccess *InsertPt) {
+  BasicBlock *BB = InsertPt->getBlock();
+  assert(I->getParent() == BB && "Instruction is not in the access's block!");
+  MemoryUseOrDef *NewAccess = createNewAccess(I, BB);
+  assert(NewAccess && "Instruction does not access memory!");
+  NewAccess->setDefiningAccess(Definition);
+
+  AccessList &Accesses = getOrCreateAccessList(BB);
+  Accesses.insert(std::next(std::find(Accesses.begin(), Accesses.end(),
+                                      InsertPt)),
+                  NewAccess);
+  if (Walker)
+    Walker->invalidateInfo(NewAccess);
+  return NewAccess;
+}
+
+void MemorySSA::replaceAllUsesWith(MemoryAccess *From, MemoryAccess *To) {
+  assert(From != To && "Replacing an access with itself!");
+  while (From->hasUsers()) {
+    MemoryAccess *User = From->Users.back();
+    if (auto *MUD = dyn_cast<MemoryUseOrDef>(User)) {
+      MUD->setDefiningAccess(To);
+      continue;
+    }
+    auto *Phi = cast<MemoryPhi>(User);
+    for (unsigned I = 0, E = Phi->getNumIncomingValues(); I != E; ++I)
+      if (Phi->getIncomingValue(I) == From)
+        Phi->setIncomingValue(I, To);
+  }
+  if (Walker)
+    Walker->invalidateInfo(From);
+}
+
+void MemorySSA::removeFromLookups(MemoryAccess *MA) {
+  if (auto *MUD = dyn_cast<MemoryUseOrDef>(MA))
+    ValueToMemoryAccess.erase(MUD->getMemoryInst());
+  else
+    ValueToMemoryAccess.erase(MA->getBlock());
+
+  auto It = PerBlockAccesses.find(MA->getBlock());
+  AccessList &Accesses = *It->second;
+  Accesses.erase(std::find(Accesses.begin(), Accesses.end(), MA));
+  if (Accesses.empty())
+    PerBlockAccesses.erase(It);
+}
+
+void MemorySSA::removeMemoryAccess(MemoryAccess *MA) {
+  assert(!isLiveOnEntryDef(MA) && "Trying to remove liveOnEntry!");
+
+  if (auto *MUD = dyn_cast<MemoryUseOrDef>(MA)) {
+    if (MUD->hasUsers())
+      replaceAllUsesWith(MUD, MUD->getDefiningAccess());
+    MUD->setDefiningAccess(nullptr);
+  } else {
+    auto *Phi = cast<MemoryPhi>(MA);
+    if (Phi->hasUsers()) {
+      MemoryAccess *Same = nullptr;
+      for (const auto &Entry : Phi->incoming()) {
+        if (Entry.second == Phi)
+          continue;
+        assert((!Same || Same == Entry.second) &&
+               "Removing a MemoryPhi that still merges several values!");
+        Same = Entry.second;
+      }
+      assert(Same && "MemoryPhi only refers to itself!");
+      replaceAllUsesWith(Phi, Same);
+    }
+    for (const auto &Entry : Phi->incoming())
+      Entry.second->removeUser(Phi);
+  }
+
+  if (Walker)
+    Walker->invalidateInfo(MA);
+  removeFromLookups(MA);
+  delete MA;
+}
+
+//===----------------------------------------------------------------------===//
+// Verification and printing
+//===----------------------------------------------------------------------===//
+
+static void checkMemorySSA(bool Cond, const char *Msg, const MemoryAccess *MA) {
+  if (Cond)
+    return;
+  errs() << "MemorySSA verification failed: " << Msg;
+  if (MA)
+    errs() << ": " << *MA;
+  errs() << "\n";
+  report_fatal_error("Broken MemorySSA");
+}
+
+void MemorySSA::verifyMemorySSA() const {
+  for (const auto &Entry : PerBlockAccesses) {
+    const BasicBlock *BB = Entry.first;
+    const AccessList &Accesses = *Entry.second;
+    checkMemorySSA(!Accesses.empty(), "empty access list", nullptr);
+
+    for (unsigned I = 0, E = Accesses.size(); I != E; ++I) {
+      const MemoryAccess *MA = Accesses[I];
+      checkMemorySSA(MA->getBlock() == BB, "access in the wrong block", MA);
+
+      // Every user must actually refer to this access.
+      for (const MemoryAccess *User : MA->users()) {
+        bool Found = false;
+        if (const auto *MUD = dyn_cast<MemoryUseOrDef>(User))
+          Found = MUD->getDefiningAccess() == MA;
+        else
+          for (const auto &In : cast<MemoryPhi>(User)->incoming())
+            Found |= In.second == MA;
+        checkMemorySSA(Found, "stale user", MA);
+      }
+
+      if (const auto *Phi = dyn_cast<MemoryPhi>(MA)) {
+        checkMemorySSA(I == 0, "MemoryPhi is not first in its block", MA);
+        checkMemorySSA(getMemoryAccess(BB) == Phi, "MemoryPhi lookup", MA);
+        unsigned NumPreds = std::distance(pred_begin(BB), pred_end(BB));
+        checkMemorySSA(Phi->getNumIncomingValues() == NumPreds,
+                       "MemoryPhi incoming count does not match predecessors",
+                       MA);
+        for (const auto &In : Phi->incoming()) {
+          checkMemorySSA(std::find(pred_begin(BB), pred_end(BB), In.first) !=
+                             pred_end(BB),
+                         "MemoryPhi incoming block is not a predecessor", MA);
+          if (DT.isReachableFromEntry(In.first))
+            checkMemorySSA(isLiveOnEntryDef(In.second) ||
+                               DT.dominates(In.second->getBlock(), In.first),
+                           "MemoryPhi incoming value does not dominate its "
+                           "edge",
+                           MA);
+        }
+        continue;
+      }
+
+      const auto *MUD = cast<MemoryUseOrDef>(MA);
+      checkMemorySSA(getMemoryAccess(MUD->getMemoryInst()) == MUD,
+                     "instruction lookup", MA);
+      checkMemorySSA(MUD->getMemoryInst()->getParent() == BB,
+                     "instruction is not in the access's block", MA);
+      checkMemorySSA(MUD->getDefiningAccess() != nullptr,
+                     "missing defining access", MA);
+      checkMemorySSA(MUD->getDefiningAccess() != MUD, "defines itself", MA);
+      if (DT.isReachableFromEntry(BB))
+        checkMemorySSA(dominates(MUD->getDefiningAccess(), MUD),
+                       "defining access does not dominate its use", MA);
+    }
+  }
+}
+
+void MemorySSA::print(raw_ostream &OS) const {
+  ModuleSlotTracker MST(F.getParent());
+  MST.incorporateFunction(F);
+
+  for (const BasicBlock &BB : F) {
+    if (BB.hasName()) {
+      OS << BB.getName() << ":\n";
+    } else {
+      OS << "; <label>:";
+      BB.printAsOperand(OS, false, MST);
+      OS << '\n';
+    }
+    if (const MemoryPhi *Phi = getMemoryAccess(&BB))
+      OS << "; " << *Phi << '\n';
+    for (const Instruction &I : BB) {
+      if (const MemoryUseOrDef *MUD = getMemoryAccess(&I))
+        OS << "  ; " << *MUD << '\n';
+      I.print(OS, MST);
+      OS << '\n';
+    }
+  }
+}
+
+void MemorySSA::dump() const { print(dbgs()); }
+
+//===----------------------------------------------------------------------===//
+// Walkers
+//===----------------------------------------------------------------------===//
+
+MemorySSAWalker::~MemorySSAWalker() {}
+
+MemoryAccess *
+DoNothingMemorySSAWalker::getClobberingMemoryAccess(const Instruction *I) {
+  MemoryUseOrDef *MUD = MSSA->getMemoryAccess(I);
+  return MUD ? MUD->getDefiningAccess() : nullptr;
+}
+
+MemoryAccess *
+DoNothingMemorySSAWalker::getClobberingMemoryAccess(MemoryAccess *Start,
+                                                    const MemoryLocation &) {
+  if (auto *MU = dyn_cast<MemoryUse>(Start))
+    return MU->getDefiningAccess();
+  return Start;
+}
+
+/// Return true if MemoryLocation::get can describe what \p I accesses.
+static bool hasMemoryLocation(const Instruction *I) {
+  return isa<LoadInst>(I) || isa<StoreInst>(I) || isa<VAArgInst>(I) ||
+         isa<AtomicCmpXchgInst>(I) || isa<AtomicRMWInst>(I);
+}
+
+bool CachingMemorySSAWalker::clobbers(MemoryDef *Def, const Query &Q) {
+  Instruction *DefInst = Def->getMemoryInst();
+  if (!Q.Call)
+    return AA.getModRefInfo(DefInst, Q.Loc) & MRI_Mod;
+
+  ImmutableCallSite QueryCS(Q.Call);
+  if (ImmutableCallSite DefCS = ImmutableCallSite(DefInst))
+    return AA.getModRefInfo(QueryCS, DefCS) != MRI_NoModRef;
+  if (!hasMemoryLocation(DefInst))
+    return true;
+  return AA.getModRefInfo(QueryCS, MemoryLocation::get(DefInst)) !=
+         MRI_NoModRef;
+}
+
+MemoryAccess *CachingMemorySSAWalker::walk(MemoryAccess *Start,
+                                           const Query &Q) {
+  DenseMap<MemoryPhi *, MemoryAccess *> PhiResults;
+  SmallPtrSet<MemoryPhi *, 8> InProgress;
+  return walkFrom(Start, Q, PhiResults, InProgress);
+}
+
+/// Follow defining accesses upward from \p Start, skipping definitions that
+/// do not clobber \p Q, until a clobber, liveOnEntry or a MemoryPhi is found.
+MemoryAccess *CachingMemorySSAWalker::walkFrom(
+    MemoryAccess *Start, const Query &Q,
+    DenseMap<MemoryPhi *, MemoryAccess *> &PhiResults,
+    SmallPtrSetImpl<MemoryPhi *> &InProgress) {
+  MemoryAccess *Current = Start;
+  while (true) {
+    if (MSSA->isLiveOnEntryDef(Current))
+      return Current;
+    if (auto *Phi = dyn_cast<MemoryPhi>(Current))
+      return walkPhi(Phi, Q, PhiResults, InProgress);
+    auto *Def = cast<MemoryDef>(Current);
+    if (clobbers(Def, Q))
+      return Def;
+    Current = Def->getDefiningAccess();
+  }
+}
+
+/// Try to look through \p Phi: if every incoming path leads to the same
+/// clobber, that is the answer, otherwise the phi itself is.  A path that
+/// comes back around to a phi still being resolved adds nothing, and is
+/// reported to the caller by returning that phi.
+MemoryAccess *CachingMemorySSAWalker::walkPhi(
+    MemoryPhi *Phi, const Query &Q,
+    DenseMap<MemoryPhi *, MemoryAccess *> &PhiResults,
+    SmallPtrSetImpl<MemoryPhi *> &InProgress) {
+  if (InProgress.count(Phi))
+    return Phi;
+
+  auto Cached = PhiResults.find(Phi);
+  if (Cached != PhiResults.end()) {
+    // The result may name a phi that was still being resolved when it was
+    // recorded; use what that phi resolved to since.
+    MemoryAccess *Result = Cached->second;
+    for (unsigned Steps = 0, E = PhiResults.size(); Steps != E; ++Steps) {
+      auto *ResultPhi = dyn_cast<MemoryPhi>(Result);
+      if (!ResultPhi || ResultPhi == Phi)
+        break;
+      auto Next = PhiResults.find(ResultPhi);
+      if (Next == PhiResults.end() || Next->second == ResultPhi)
+        break;
+      Result = Next->second;
+    }
+    return Result;
+  }
+
+  InProgress.insert(Phi);
+  MemoryAccess *Result = nullptr;
+  bool Conflict = false;
+  for (const auto &Entry : Phi->incoming()) {
+    MemoryAccess *PathResult =
+        walkFrom(Entry.second, Q, PhiResults, InProgress);
+    if (PathResult == Phi)
+      continue;
+    if (Result && Result != PathResult) {
+      Conflict = true;
+      break;
+    }
+    Result = PathResult;
+  }
+  InProgress.erase(Phi);
+
+  if (Conflict || !Result)
+    Result = Phi;
+  PhiResults[Phi] = Result;
+  return Result;
+}
+
+MemoryAccess *
+CachingMemorySSAWalker::getClobberingMemoryAccess(const Instruction *I) {
+  ++NumQueries;
+  auto Cached = CachedInstClobbers.find(I);
+  if (Cached != CachedInstClobbers.end()) {
+    ++NumCacheHits;
+    return Cached->second;
+  }
+
+  MemoryUseOrDef *StartingAccess = MSSA->getMemoryAccess(I);
+  if (!StartingAccess)
+    return nullptr;
+
+  MemoryAccess *Result;
+  MemoryAccess *DefiningAccess = StartingAccess->getDefiningAccess();
+  if (isa<CallInst>(I) || isa<InvokeInst>(I))
+    Result = walk(DefiningAccess, Query{MemoryLocation(), I});
+  else if (hasMemoryLocation(I))
+    Result = walk(DefiningAccess, Query{MemoryLocation::get(I), nullptr});
+  else
+    Result = DefiningAccess; // Fences and the like: no better answer.
+
+  CachedInstClobbers[I] = Result;
+  return Result;
+}
+
+MemoryAccess *
+CachingMemorySSAWalker::getClobberingMemoryAccess(MemoryAccess *Start,
+                                                  const MemoryLocation &Loc) {
+  ++NumQueries;
+  if (auto *MU = dyn_cast<MemoryUse>(Start))
+    Start = MU->getDefiningAccess();
+
+  auto Key = std::make_pair(Start, Loc);
+  auto Cached = CachedLocClobbers.find(Key);
+  if (Cached != CachedLocClobbers.end()) {
+    ++NumCacheHits;
+    return Cached->second;
+  }
+
+  MemoryAccess *Result = walk(Start, Query{Loc, nullptr});
+  CachedLocClobbers[Key] = Result;
+  return Result;
+}
+
+void CachingMemorySSAWalker::invalidateInfo(MemoryAccess *) {
+  // Any change to the graph can change the answer to queries that walk
+  // through it, so drop everything.
+  CachedInstClobbers.clear();
+  CachedLocClobbers.clear();
+}
+
+//===----------------------------------------------------------------------===//
+// Legacy pass
+//===----------------------------------------------------------------------===//
+
+char MemorySSAWrapperPass::ID = 0;
+INITIALIZE_PASS_BEGIN(MemorySSAWrapperPass, "memoryssa", "Memory SSA", false,
+                      true)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
+INITIALIZE_PASS_END(MemorySSAWrapperPass, "memoryssa", "Memory SSA", false,
+                    true)
+
+MemorySSAWrapperPass::MemorySSAWrapperPass() : FunctionPass(ID) {
+  initializeMemorySSAWrapperPassPass(*PassRegistry::getPassRegistry());
+}
+
+bool MemorySSAWrapperPass::runOnFunction(Function &F) {
+  auto &AA = getAnalysis<AAResultsWrapperPass>().getAAResults();
+  auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  MSSA.reset(new MemorySSA(F, AA, DT));
+  if (VerifyMemorySSA)
+    MSSA->verifyMemorySSA();
+  return false;
+}
+
+void MemorySSAWrapperPass::releaseMemory() { MSSA.reset(); }
+
+void MemorySSAWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequiredTransitive<DominatorTreeWrapperPass>();
+  AU.addRequiredTransitive<AAResultsWrapperPass>();
+}
+
+void MemorySSAWrapperPass::verifyAnalysis() const { MSSA->verifyMemorySSA(); }
+
+void MemorySSAWrapperPass::print(raw_ostream &OS, const Module *M) const {
+  MSSA->print(OS);
+}
+
+FunctionPass *llvm::createMemorySSAWrapperPass() {
+  return new MemorySSAWrapperPass();
+}
@@ -103,6 +103,20 @@ STATISTIC(NumTripCountsNotComputed,
           "Number of loops without predictable loop counts");
 STATISTIC(NumBruteForceTripCountsComputed,
           "Number of loops with trip counts computed by force");
+STATISTIC(MaxSCEVArenaKB,
+          "Largest SCEV arena of a single function, in KB");
+STATISTIC(MaxValueExprMapSize,
+          "Largest number of values with a SCEV in a single function");
+STATISTIC(MaxBackedgeTakenCounts,
+          "Largest number of cached backedge-taken counts in a function");
+STATISTIC(MaxRecomputableCacheEntries,
+          "Largest number of entries in the recomputable SCEV caches");
+STATISTIC(NumCacheEvictions,
+          "Number of times the recomputable SCEV caches were evicted");
+STATISTIC(NumForgottenSCEVs,
+          "Number of cached SCEVs dropped by forgetLoop and forgetValue");
+STATISTIC(NumForgetWalksCut,
+          "Number of def-use invalidation walks stopped at opaque values");
 
 static cl::opt<unsigned>
 MaxBruteForceIterations("scalar-evolution-max-iterations", cl::ReallyHidden,
@@ -111,10 +125,22 @@ MaxBruteForceIterations("scalar-evolution-max-iterations", cl::ReallyHidden,
                                  "derived loop"),
                         cl::init(100));
 
+static cl::opt<unsigned>
+MaxCacheEntries("scalar-evolution-max-cache-entries", cl::Hidden,
+                cl::init(0),
+                cl::desc("Drop the ScalarEvolution caches that are cheap to "
+                         "recompute once they hold more entries than this "
+                         "(default = 0, never)"));
+
 // FIXME: Enable this with XDEBUG when the test suite is clean.
 static cl::opt<bool>
 VerifySCEV("verify-scev",
            cl::desc("Verify ScalarEvolution's backedge taken counts (slow)"));
+static cl::opt<bool>
+VerifySCEVCache("verify-scev-cache",
+                cl::desc("Verify ScalarEvolution's backedge taken counts and "
+                         "cached SCEVs of values against a fresh "
+                         "ScalarEvolution (slow)"));
 
 //===----------------------------------------------------------------------===//
 //                           SCEV class definitions
@@ -3569,6 +3595,29 @@ PushDefUseChildren(Instruction *I,
     Worklist.push_back(cast<Instruction>(U));
 }
 
+/// isOpaqueToSCEV - Return true if the SCEV of the given instruction is
+/// SCEVUnknown no matter what its operands are, and neither its range nor its
+/// value at any scope can depend on them.  Invalidation walks that follow the
+/// users of a changed value can stop at such instructions.
+static bool isOpaqueToSCEV(const Instruction *I, const DataLayout &DL) {
+  // computeSCEVAtScope folds loads whose address becomes a constant, so only
+  // loads from objects that can never be constant are opaque.
+  if (const LoadInst *LI = dyn_cast<LoadInst>(I)) {
+    const Value *Obj = GetUnderlyingObject(LI->getPointerOperand(), DL);
+    return isa<Argument>(Obj) || isa<AllocaInst>(Obj);
+  }
+  if (isa<InvokeInst>(I))
+    return true;
+  // Value tracking looks through some intrinsics, and calls to foldable
+  // functions may fold at some scope.
+  if (const CallInst *CI = dyn_cast<CallInst>(I)) {
+    const Function *Callee = CI->getCalledFunction();
+    return !Callee ||
+           (!Callee->isIntrinsic() && !canConstantFoldCallTo(Callee));
+  }
+  return false;
+}
+
 /// ForgetSymbolicValue - This looks up computed SCEV values for all
 /// instructions that depend on the given instruction and removes them from
 /// the ValueExprMapType map if they reference SymName. This is used during PHI
@@ -4971,11 +5020,18 @@ ScalarEvolution::getBackedgeTakenInfo(const Loop *L) {
     PushLoopPHIs(L, Worklist);
 
     SmallPtrSet<Instruction *, 8> Visited;
+    const DataLayout &DL = getDataLayout();
     while (!Worklist.empty()) {
       Instruction *I = Worklist.pop_back_val();
       if (!Visited.insert(I).second)
         continue;
 
+      // Nothing derived from an opaque value can have used the trip count.
+      if (isOpaqueToSCEV(I, DL)) {
+        ++NumForgetWalksCut;
+        continue;
+      }
+
       ValueExprMapType::iterator It =
         ValueExprMap.find_as(static_cast<Value *>(I));
       if (It != ValueExprMap.end()) {
@@ -4999,6 +5055,16 @@ ScalarEvolution::getBackedgeTakenInfo(const Loop *L) {
     }
   }
 
+  // Record which expressions the count uses, so forgetMemoizedResults can
+  // find it.
+  SmallPtrSet<const SCEV *, 16> Ops;
+  Result.getOperands(Ops, this);
+  for (const SCEV *S : Ops) {
+    SmallVectorImpl<const Loop *> &Loops = BECountUsers[S];
+    if (std::find(Loops.begin(), Loops.end(), L) == Loops.end())
+      Loops.push_back(L);
+  }
+
   // Re-lookup the insert position, since the call to
   // computeBackedgeTakenCount above could result in a
   // recusive call to getBackedgeTakenInfo (on a different
@@ -5007,23 +5073,12 @@ ScalarEvolution::getBackedgeTakenInfo(const Loop *L) {
   return BackedgeTakenCounts.find(L)->second = Result;
 }
 
-/// forgetLoop - This method should be called by the client when it has
-/// changed a loop in a way that may effect ScalarEvolution's ability to
-/// compute a trip count, or if the loop is deleted.
-void ScalarEvolution::forgetLoop(const Loop *L) {
-  // Drop any stored trip count value.
-  DenseMap<const Loop*, BackedgeTakenInfo>::iterator BTCPos =
-    BackedgeTakenCounts.find(L);
-  if (BTCPos != BackedgeTakenCounts.end()) {
-    BTCPos->second.clear();
-    BackedgeTakenCounts.erase(BTCPos);
-  }
-
-  // Drop information about expressions based on loop-header PHIs.
-  SmallVector<Instruction *, 16> Worklist;
-  PushLoopPHIs(L, Worklist);
+void ScalarEvolution::forgetDefUseChains(ArrayRef<Instruction *> Roots) {
+  SmallVector<Instruction *, 16> Worklist(Roots.begin(), Roots.end());
+  const DataLayout &DL = getDataLayout();
 
   SmallPtrSet<Instruction *, 8> Visited;
+  SmallPtrSet<const SCEV *, 8> Cut;
   while (!Worklist.empty()) {
     Instruction *I = Worklist.pop_back_val();
     if (!Visited.insert(I).second)
@@ -5031,7 +5086,21 @@ void ScalarEvolution::forgetLoop(const Loop *L) {
 
     ValueExprMapType::iterator It =
       ValueExprMap.find_as(static_cast<Value *>(I));
+
+    // An opaque user is still SCEVUnknown of itself, and so are the parts of
+    // its users' SCEVs that came through it; keep them.  Only dispositions
+    // depend on where it is, so drop those of every SCEV that uses it once
+    // the walk is done.
+    if (isOpaqueToSCEV(I, DL) &&
+        std::find(Roots.begin(), Roots.end(), I) == Roots.end()) {
+      ++NumForgetWalksCut;
+      if (It != ValueExprMap.end())
+        Cut.insert(It->second);
+      continue;
+    }
+
     if (It != ValueExprMap.end()) {
+      ++NumForgottenSCEVs;
       forgetMemoizedResults(It->second);
       ValueExprMap.erase(It);
       if (PHINode *PN = dyn_cast<PHINode>(I))
@@ -5041,6 +5110,69 @@ void ScalarEvolution::forgetLoop(const Loop *L) {
     PushDefUseChildren(I, Worklist);
   }
 
+  forgetDispositions(Cut);
+}
+
+/// Drop the cached loop and block dispositions of the SCEVs in \p Cut and of
+/// every SCEV that has one of them as an operand.  The caches are scanned
+/// once, however many SCEVs were cut.
+void ScalarEvolution::forgetDispositions(
+    const SmallPtrSetImpl<const SCEV *> &Cut) {
+  if (Cut.empty())
+    return;
+
+  // Search for any of the SCEVs in Cut within an expression tree.
+  // Implements SCEVTraversal::Visitor.
+  struct SCEVSetSearch {
+    const SmallPtrSetImpl<const SCEV *> &Nodes;
+    bool IsFound;
+
+    SCEVSetSearch(const SmallPtrSetImpl<const SCEV *> &N)
+        : Nodes(N), IsFound(false) {}
+
+    bool follow(const SCEV *S) {
+      IsFound |= Nodes.count(S) != 0;
+      return !IsFound;
+    }
+    bool isDone() const { return IsFound; }
+  };
+  auto UsesCut = [&Cut](const SCEV *S) {
+    SCEVSetSearch Search(Cut);
+    visitAll(S, Search);
+    return Search.IsFound;
+  };
+
+  for (auto I = LoopDispositions.begin(), E = LoopDispositions.end();
+       I != E;) {
+    auto Cur = I++;
+    if (UsesCut(Cur->first))
+      LoopDispositions.erase(Cur);
+  }
+  for (auto I = BlockDispositions.begin(), E = BlockDispositions.end();
+       I != E;) {
+    auto Cur = I++;
+    if (UsesCut(Cur->first))
+      BlockDispositions.erase(Cur);
+  }
+}
+
+/// forgetLoop - This method should be called by the client when it has
+/// changed a loop in a way that may effect ScalarEvolution's ability to
+/// compute a trip count, or if the loop is deleted.
+void ScalarEvolution::forgetLoop(const Loop *L) {
+  // Drop any stored trip count value.
+  DenseMap<const Loop*, BackedgeTakenInfo>::iterator BTCPos =
+    BackedgeTakenCounts.find(L);
+  if (BTCPos != BackedgeTakenCounts.end()) {
+    BTCPos->second.clear();
+    BackedgeTakenCounts.erase(BTCPos);
+  }
+
+  // Drop information about expressions based on loop-header PHIs.
+  SmallVector<Instruction *, 16> Worklist;
+  PushLoopPHIs(L, Worklist);
+  forgetDefUseChains(Worklist);
+
   // Forget all contained loops too, to avoid dangling entries in the
   // ValuesAtScopes map.
   for (Loop::iterator I = L->begin(), E = L->end(); I != E; ++I)
@@ -5054,27 +5186,7 @@ void ScalarEvolution::forgetValue(Value *V) {
   Instruction *I = dyn_cast<Instruction>(V);
   if (!I) return;
 
-  // Drop information about expressions based on loop-header PHIs.
-  SmallVector<Instruction *, 16> Worklist;
-  Worklist.push_back(I);
-
-  SmallPtrSet<Instruction *, 8> Visited;
-  while (!Worklist.empty()) {
-    I = Worklist.pop_back_val();
-    if (!Visited.insert(I).second)
-      continue;
-
-    ValueExprMapType::iterator It =
-      ValueExprMap.find_as(static_cast<Value *>(I));
-    if (It != ValueExprMap.end()) {
-      forgetMemoizedResults(It->second);
-      ValueExprMap.erase(It);
-      if (PHINode *PN = dyn_cast<PHINode>(I))
-        ConstantEvolutionLoopExitValue.erase(PN);
-    }
-
-    PushDefUseChildren(I, Worklist);
-  }
+  forgetDefUseChains(I);
 }
 
 /// getExact - Get the exact loop backedge taken count considering all loop
@@ -5147,6 +5259,33 @@ bool ScalarEvolution::BackedgeTakenInfo::hasOperand(const SCEV *S,
   return false;
 }
 
+namespace {
+/// Collects every expression it visits.
+struct SCEVCollectAll {
+  SmallPtrSetImpl<const SCEV *> &Ops;
+
+  SCEVCollectAll(SmallPtrSetImpl<const SCEV *> &Ops) : Ops(Ops) {}
+
+  bool follow(const SCEV *S) { return Ops.insert(S).second; }
+  bool isDone() const { return false; }
+};
+}
+
+void ScalarEvolution::BackedgeTakenInfo::getOperands(
+    SmallPtrSetImpl<const SCEV *> &Ops, ScalarEvolution *SE) const {
+  SCEVCollectAll Collector(Ops);
+  if (Max && Max != SE->getCouldNotCompute())
+    visitAll(Max, Collector);
+
+  if (!ExitNotTaken.ExitingBlock)
+    return;
+
+  for (const ExitNotTakenInfo *ENT = &ExitNotTaken;
+       ENT != nullptr; ENT = ENT->getNextExit())
+    if (ENT->ExactNotTaken != SE->getCouldNotCompute())
+      visitAll(ENT->ExactNotTaken, Collector);
+}
+
 /// Allocate memory for BackedgeTakenInfo and copy the not-taken count of each
 /// computable exit into a persistent ExitNotTakenInfo array.
 ScalarEvolution::BackedgeTakenInfo::BackedgeTakenInfo(
@@ -6118,6 +6257,7 @@ const SCEV *ScalarEvolution::computeExitCountExhaustively(const Loop *L,
 /// In the case that a relevant loop exit value cannot be computed, the
 /// original value V is returned.
 const SCEV *ScalarEvolution::getSCEVAtScope(const SCEV *V, const Loop *L) {
+  evictRecomputableCachesIfNeeded();
   SmallVector<std::pair<const Loop *, const SCEV *>, 2> &Values =
       ValuesAtScopes[V];
   // Check to see if we've folded this expression at this loop before.
@@ -9067,6 +9207,7 @@ ScalarEvolution::ScalarEvolution(ScalarEvolution &&Arg)
       ValueExprMap(std::move(Arg.ValueExprMap)),
       WalkingBEDominatingConds(false), ProvingSplitPredicate(false),
       BackedgeTakenCounts(std::move(Arg.BackedgeTakenCounts)),
+      BECountUsers(std::move(Arg.BECountUsers)),
       ConstantEvolutionLoopExitValue(
           std::move(Arg.ConstantEvolutionLoopExitValue)),
       ValuesAtScopes(std::move(Arg.ValuesAtScopes)),
@@ -9082,6 +9223,8 @@ ScalarEvolution::ScalarEvolution(ScalarEvolution &&Arg)
 }
 
 ScalarEvolution::~ScalarEvolution() {
+  noteCacheSizes();
+
   // Iterate through all the SCEVUnknown instances and call their
   // destructors, so that they release their references to their values.
   for (SCEVUnknown *U = FirstUnknown; U;) {
@@ -9103,6 +9246,55 @@ ScalarEvolution::~ScalarEvolution() {
   assert(!ProvingSplitPredicate && "ProvingSplitPredicate garbage!");
 }
 
+unsigned ScalarEvolution::getNumRecomputableCacheEntries() const {
+  return ValuesAtScopes.size() + LoopDispositions.size() +
+         BlockDispositions.size() + UnsignedRanges.size() +
+         SignedRanges.size();
+}
+
+void ScalarEvolution::evictRecomputableCachesIfNeeded() {
+  if (!MaxCacheEntries || getNumRecomputableCacheEntries() <= MaxCacheEntries)
+    return;
+
+  noteCacheSizes();
+  ++NumCacheEvictions;
+  DEBUG(dbgs() << "SCEV: evicting " << getNumRecomputableCacheEntries()
+               << " cache entries\n");
+  LoopDispositions.shrink_and_clear();
+  BlockDispositions.shrink_and_clear();
+  UnsignedRanges.shrink_and_clear();
+  SignedRanges.shrink_and_clear();
+
+  // A null entry in ValuesAtScopes marks a getSCEVAtScope query that is
+  // still being computed further up the stack; it stops the recursion
+  // through PHIs from going around forever, so it has to stay.
+  for (auto I = ValuesAtScopes.begin(), E = ValuesAtScopes.end(); I != E;) {
+    auto Cur = I++;
+    auto &Values = Cur->second;
+    Values.erase(std::remove_if(Values.begin(), Values.end(),
+                                [](const std::pair<const Loop *,
+                                                   const SCEV *> &LS) {
+                                  return LS.second != nullptr;
+                                }),
+                 Values.end());
+    if (Values.empty())
+      ValuesAtScopes.erase(Cur);
+  }
+}
+
+void ScalarEvolution::noteCacheSizes() const {
+  unsigned ArenaKB = SCEVAllocator.getTotalMemory() / 1024;
+  if (ArenaKB > MaxSCEVArenaKB)
+    MaxSCEVArenaKB = ArenaKB;
+  if (ValueExprMap.size() > MaxValueExprMapSize)
+    MaxValueExprMapSize = ValueExprMap.size();
+  if (BackedgeTakenCounts.size() > MaxBackedgeTakenCounts)
+    MaxBackedgeTakenCounts = BackedgeTakenCounts.size();
+  unsigned Recomputable = getNumRecomputableCacheEntries();
+  if (Recomputable > MaxRecomputableCacheEntries)
+    MaxRecomputableCacheEntries = Recomputable;
+}
+
 bool ScalarEvolution::hasLoopInvariantBackedgeTakenCount(const Loop *L) {
   return !isa<SCEVCouldNotCompute>(getBackedgeTakenCount(L));
 }
@@ -9203,6 +9395,7 @@ void ScalarEvolution::print(raw_ostream &OS) const {
 
 ScalarEvolution::LoopDisposition
 ScalarEvolution::getLoopDisposition(const SCEV *S, const Loop *L) {
+  evictRecomputableCachesIfNeeded();
   auto &Values = LoopDispositions[S];
   for (auto &V : Values) {
     if (V.getPointer() == L)
@@ -9306,6 +9499,7 @@ bool ScalarEvolution::hasComputableLoopEvolution(const SCEV *S, const Loop *L) {
 
 ScalarEvolution::BlockDisposition
 ScalarEvolution::getBlockDisposition(const SCEV *S, const BasicBlock *BB) {
+  evictRecomputableCachesIfNeeded();
   auto &Values = BlockDispositions[S];
   for (auto &V : Values) {
     if (V.getPointer() == BB)
@@ -9421,15 +9615,21 @@ void ScalarEvolution::forgetMemoizedResults(const SCEV *S) {
   UnsignedRanges.erase(S);
   SignedRanges.erase(S);
 
-  for (DenseMap<const Loop*, BackedgeTakenInfo>::iterator I =
-         BackedgeTakenCounts.begin(), E = BackedgeTakenCounts.end(); I != E; ) {
-    BackedgeTakenInfo &BEInfo = I->second;
-    if (BEInfo.hasOperand(S, this)) {
-      BEInfo.clear();
-      BackedgeTakenCounts.erase(I++);
+  auto Users = BECountUsers.find(S);
+  if (Users == BECountUsers.end())
+    return;
+
+  // Every count that still uses S is dropped below, so the entry for S can go
+  // whether or not its loops were stale.
+  SmallVector<const Loop *, 2> Loops = std::move(Users->second);
+  BECountUsers.erase(Users);
+  for (const Loop *L : Loops) {
+    auto BTCPos = BackedgeTakenCounts.find(L);
+    if (BTCPos != BackedgeTakenCounts.end() &&
+        BTCPos->second.hasOperand(S, this)) {
+      BTCPos->second.clear();
+      BackedgeTakenCounts.erase(BTCPos);
     }
-    else
-      ++I;
   }
 }
 
@@ -9444,22 +9644,35 @@ static void replaceSubString(std::string &Str, StringRef From, StringRef To) {
   }
 }
 
+/// printSCEVForVerify - Print S in the form verify compares.
+static void printSCEVForVerify(const SCEV *S, std::string &Str) {
+  raw_string_ostream OS(Str);
+  S->print(OS);
+
+  // false and 0 are semantically equivalent. This can happen in dead loops.
+  replaceSubString(OS.str(), "false", "0");
+  // Remove wrap flags, their use in SCEV is highly fragile.
+  // FIXME: Remove this when SCEV gets smarter about them.
+  replaceSubString(OS.str(), "<nw>", "");
+  replaceSubString(OS.str(), "<nsw>", "");
+  replaceSubString(OS.str(), "<nuw>", "");
+}
+
+/// isIgnoredForVerify - Differences involving these are not reported.
+/// FIXME: We currently ignore SCEV changes from/to CouldNotCompute. This
+/// means that a pass is buggy or SCEV has to learn a new pattern but is
+/// usually not harmful.
+static bool isIgnoredForVerify(StringRef Str) {
+  return Str.find("undef") != StringRef::npos ||
+         Str == "***COULDNOTCOMPUTE***";
+}
+
 /// getLoopBackedgeTakenCounts - Helper method for verifyAnalysis.
 static void
 getLoopBackedgeTakenCounts(Loop *L, VerifyMap &Map, ScalarEvolution &SE) {
   std::string &S = Map[L];
-  if (S.empty()) {
-    raw_string_ostream OS(S);
-    SE.getBackedgeTakenCount(L)->print(OS);
-
-    // false and 0 are semantically equivalent. This can happen in dead loops.
-    replaceSubString(OS.str(), "false", "0");
-    // Remove wrap flags, their use in SCEV is highly fragile.
-    // FIXME: Remove this when SCEV gets smarter about them.
-    replaceSubString(OS.str(), "<nw>", "");
-    replaceSubString(OS.str(), "<nsw>", "");
-    replaceSubString(OS.str(), "<nuw>", "");
-  }
+  if (S.empty())
+    printSCEVForVerify(SE.getBackedgeTakenCount(L), S);
 
   for (auto *R : reverse(*L))
     getLoopBackedgeTakenCounts(R, Map, SE); // recurse.
@@ -9494,14 +9707,8 @@ void ScalarEvolution::verify() const {
 
     // Compare the stringified SCEVs. We don't care if undef backedgetaken count
     // changes.
-    // FIXME: We currently ignore SCEV changes from/to CouldNotCompute. This
-    // means that a pass is buggy or SCEV has to learn a new pattern but is
-    // usually not harmful.
-    if (OldI->second != NewI->second &&
-        OldI->second.find("undef") == std::string::npos &&
-        NewI->second.find("undef") == std::string::npos &&
-        OldI->second != "***COULDNOTCOMPUTE***" &&
-        NewI->second != "***COULDNOTCOMPUTE***") {
+    if (OldI->second != NewI->second && !isIgnoredForVerify(OldI->second) &&
+        !isIgnoredForVerify(NewI->second)) {
       dbgs() << "SCEVValidator: SCEV for loop '"
              << OldI->first->getHeader()->getName()
              << "' changed from '" << OldI->second
@@ -9510,7 +9717,34 @@ void ScalarEvolution::verify() const {
     }
   }
 
-  // TODO: Verify more things.
+  if (!VerifySCEVCache)
+    return;
+
+  // Check that every value's cached SCEV is what the fresh ScalarEvolution
+  // computes now, which catches a pass that changed IR without forgetting
+  // the SCEVs derived from it.  A value that was SCEVUnknown of itself may
+  // legitimately have become analyzable.
+  for (auto &Entry : ValueExprMap) {
+    Value *V = Entry.first;
+    const SCEV *Old = Entry.second;
+    if (!V)
+      continue;
+    if (const SCEVUnknown *U = dyn_cast<SCEVUnknown>(Old))
+      if (U->getValue() == V)
+        continue;
+
+    std::string OldStr, NewStr;
+    printSCEVForVerify(Old, OldStr);
+    printSCEVForVerify(SE2.getSCEV(V), NewStr);
+    if (OldStr != NewStr && !isIgnoredForVerify(OldStr) &&
+        !isIgnoredForVerify(NewStr)) {
+      dbgs() << "SCEVValidator: cached SCEV for '";
+      V->printAsOperand(dbgs(), /*PrintType=*/false);
+      dbgs() << "' is '" << OldStr << "' but should be '" << NewStr
+             << "'!\n";
+      std::abort();
+    }
+  }
 }
 
 char ScalarEvolutionAnalysis::PassID;
@@ -9559,7 +9793,7 @@ void ScalarEvolutionWrapperPass::print(raw_ostream &OS, const Module *) const {
 }
 
 void ScalarEvolutionWrapperPass::verifyAnalysis() const {
-  if (!VerifySCEV)
+  if (!VerifySCEV && !VerifySCEVCache)
     return;
 
   SE->verify();
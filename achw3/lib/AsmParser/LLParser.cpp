@@ -40,6 +40,18 @@ static std::string getTypeString(Type *T) {
   return Tmp.str();
 }
 
+/// getFirstForwardRef - Return the unresolved forward reference with the
+/// smallest name, so that diagnostics don't depend on hash table order.
+template <typename MapTy>
+static const typename MapTy::value_type &getFirstForwardRef(const MapTy &Map) {
+  assert(!Map.empty() && "No forward references");
+  auto First = Map.begin();
+  for (auto I = Map.begin(), E = Map.end(); I != E; ++I)
+    if (I->getKey() < First->getKey())
+      First = I;
+  return *First;
+}
+
 /// Run: module ::= toplevelentity*
 bool LLParser::Run() {
   // Prime the lexer.
@@ -162,10 +174,11 @@ bool LLParser::ValidateEndOfModule() {
                  "use of undefined comdat '$" +
                      ForwardRefComdats.begin()->first + "'");
 
-  if (!ForwardRefVals.empty())
-    return Error(ForwardRefVals.begin()->second.second,
-                 "use of undefined value '@" + ForwardRefVals.begin()->first +
-                 "'");
+  if (!ForwardRefVals.empty()) {
+    const auto &FwdRef = getFirstForwardRef(ForwardRefVals);
+    return Error(FwdRef.getValue().second,
+                 "use of undefined value '@" + FwdRef.getKey() + "'");
+  }
 
   if (!ForwardRefValIDs.empty())
     return Error(ForwardRefValIDs.begin()->second.second,
@@ -2288,11 +2301,11 @@ LLParser::PerFunctionState::~PerFunctionState() {
   // If there were any forward referenced non-basicblock values, delete them.
 
   for (const auto &P : ForwardRefVals) {
-    if (isa<BasicBlock>(P.second.first))
+    if (isa<BasicBlock>(P.getValue().first))
       continue;
-    P.second.first->replaceAllUsesWith(
-        UndefValue::get(P.second.first->getType()));
-    delete P.second.first;
+    P.getValue().first->replaceAllUsesWith(
+        UndefValue::get(P.getValue().first->getType()));
+    delete P.getValue().first;
   }
 
   for (const auto &P : ForwardRefValIDs) {
@@ -2305,10 +2318,11 @@ LLParser::PerFunctionState::~PerFunctionState() {
 }
 
 bool LLParser::PerFunctionState::FinishFunction() {
-  if (!ForwardRefVals.empty())
-    return P.Error(ForwardRefVals.begin()->second.second,
-                   "use of undefined value '%" + ForwardRefVals.begin()->first +
-                   "'");
+  if (!ForwardRefVals.empty()) {
+    const auto &FwdRef = getFirstForwardRef(ForwardRefVals);
+    return P.Error(FwdRef.getValue().second,
+                   "use of undefined value '%" + FwdRef.getKey() + "'");
+  }
   if (!ForwardRefValIDs.empty())
     return P.Error(ForwardRefValIDs.begin()->second.second,
                    "use of undefined value '%" +
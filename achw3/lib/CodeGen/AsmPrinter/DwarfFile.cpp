@@ -13,10 +13,17 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/MC/MCStreamer.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/LEB128.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Target/TargetLoweringObjectFile.h"
 
 namespace llvm {
+static cl::opt<unsigned> DwarfLayoutThreads(
+    "dwarf-layout-threads", cl::Hidden, cl::init(1),
+    cl::desc("Number of threads used to compute the sizes and offsets of "
+             "DIEs"));
+
 DwarfFile::DwarfFile(AsmPrinter *AP, StringRef Pref, BumpPtrAllocator &DA)
     : Asm(AP), StrPool(DA, *Asm, Pref) {}
 
@@ -70,6 +77,11 @@ void DwarfFile::emitUnits(bool UseOffsets) {
 
 // Compute the size and offset for each DIE.
 void DwarfFile::computeSizeAndOffsets() {
+  if (DwarfLayoutThreads > 1) {
+    computeSizeAndOffsetsInParallel(DwarfLayoutThreads);
+    return;
+  }
+
   // Offset from the first CU in the debug info section is 0 initially.
   unsigned SecOffset = 0;
 
@@ -121,6 +133,107 @@ unsigned DwarfFile::computeSizeAndOffset(DIE &Die, unsigned Offset) {
   return Offset;
 }
 
+// Assign abbreviation numbers to Die and its children, in the order
+// computeSizeAndOffset visits them.
+static void assignAbbrevNumbers(DwarfFile &File, DIE &Die) {
+  File.assignAbbrevNumber(Die);
+  for (auto &Child : Die.children())
+    assignAbbrevNumbers(File, Child);
+}
+
+// Compute the size of the abbreviation code and attribute values of a DIE,
+// which have to be numbered already.
+static unsigned getDIEHeaderSize(const AsmPrinter *AP, const DIE &Die) {
+  unsigned Size = getULEB128Size(Die.getAbbrevNumber());
+  for (const auto &V : Die.values())
+    Size += V.SizeOf(AP);
+  return Size;
+}
+
+// Like DwarfFile::computeSizeAndOffset, but for DIEs that are numbered
+// already. This only reads shared state, so subtrees can be laid out
+// concurrently.
+static unsigned layoutDIE(const AsmPrinter *AP, DIE &Die, unsigned Offset) {
+  Die.setOffset(Offset);
+  Offset += getDIEHeaderSize(AP, Die);
+  if (Die.hasChildren()) {
+    for (auto &Child : Die.children())
+      Offset = layoutDIE(AP, Child, Offset);
+    Offset += sizeof(int8_t);
+  }
+  Die.setSize(Offset - Die.getOffset());
+  return Offset;
+}
+
+// Move Die and its children Delta bytes further into their unit.
+static void shiftDIE(DIE &Die, unsigned Delta) {
+  Die.setOffset(Die.getOffset() + Delta);
+  for (auto &Child : Die.children())
+    shiftDIE(Child, Delta);
+}
+
+void DwarfFile::computeSizeAndOffsetsInParallel(unsigned Threads) {
+  // Abbreviation numbers depend on the order DIEs are first seen in, and the
+  // size of a DIE depends on its number, so assign them up front in the order
+  // of the serial layout.
+  for (const auto &TheU : CUs)
+    assignAbbrevNumbers(*this, TheU->getUnitDie());
+
+  // The sizes of the top-level DIEs of each unit (subprograms, types, ...) do
+  // not depend on where they end up, so lay each of them out from offset 0 on
+  // the pool. Batch them, as there are usually many small ones.
+  std::vector<DIE *> Subtrees;
+  for (const auto &TheU : CUs)
+    for (auto &Child : TheU->getUnitDie().children())
+      Subtrees.push_back(&Child);
+  std::vector<unsigned> Sizes(Subtrees.size());
+  unsigned BatchSize = Subtrees.size() / (Threads * 8) + 1;
+
+  ThreadPool Pool(Threads);
+  for (unsigned Begin = 0, E = Subtrees.size(); Begin < E; Begin += BatchSize) {
+    unsigned End = std::min(Begin + BatchSize, E);
+    Pool.async([this, &Subtrees, &Sizes, Begin, End]() {
+      for (unsigned I = Begin; I != End; ++I)
+        Sizes[I] = layoutDIE(Asm, *Subtrees[I], 0);
+    });
+  }
+  Pool.wait();
+
+  // Place the subtrees one after the other, in order, exactly where
+  // computeSizeAndOffset would have put them.
+  std::vector<unsigned> Starts(Subtrees.size());
+  unsigned SecOffset = 0;
+  unsigned Idx = 0;
+  for (const auto &TheU : CUs) {
+    TheU->setDebugInfoOffset(SecOffset);
+
+    DIE &UnitDie = TheU->getUnitDie();
+    unsigned Offset = sizeof(int32_t) +      // Length of Unit Info
+                      TheU->getHeaderSize(); // Unit-specific headers
+    UnitDie.setOffset(Offset);
+    Offset += getDIEHeaderSize(Asm, UnitDie);
+    if (UnitDie.hasChildren()) {
+      for (auto &Child : UnitDie.children()) {
+        (void)Child;
+        Starts[Idx] = Offset;
+        Offset += Sizes[Idx++];
+      }
+      Offset += sizeof(int8_t);
+    }
+    UnitDie.setSize(Offset - UnitDie.getOffset());
+    SecOffset += Offset;
+  }
+
+  for (unsigned Begin = 0, E = Subtrees.size(); Begin < E; Begin += BatchSize) {
+    unsigned End = std::min(Begin + BatchSize, E);
+    Pool.async([&Subtrees, &Starts, Begin, End]() {
+      for (unsigned I = Begin; I != End; ++I)
+        shiftDIE(*Subtrees[I], Starts[I]);
+    });
+  }
+  Pool.wait();
+}
+
 void DwarfFile::emitAbbrevs(MCSection *Section) {
   // Check to see if it is worth the effort.
   if (!Abbreviations.empty()) {
@@ -74,6 +74,11 @@ public:
   /// \brief Compute the size and offset of all the DIEs.
   void computeSizeAndOffsets();
 
+  /// \brief Compute the size and offset of all the DIEs, laying out the
+  /// top-level DIEs of the units on \p Threads threads. The result is the
+  /// same as that of the serial layout.
+  void computeSizeAndOffsetsInParallel(unsigned Threads);
+
   /// Define a unique number for the abbreviation.
   ///
   /// Compute the abbreviation for \c Die, look up its unique number, and
@@ -49,6 +49,7 @@ void InterferenceCache::init(MachineFunction *mf,
   LIUArray = liuarray;
   TRI = tri;
   reinitPhysRegEntries();
+  NumEntryFills = 0;
   for (unsigned i = 0; i != CacheEntries; ++i)
     Entries[i].clear(mf, indexes, lis);
 }
@@ -56,8 +57,10 @@ void InterferenceCache::init(MachineFunction *mf,
 InterferenceCache::Entry *InterferenceCache::get(unsigned PhysReg) {
   unsigned E = PhysRegEntries[PhysReg];
   if (E < CacheEntries && Entries[E].getPhysReg() == PhysReg) {
-    if (!Entries[E].valid(LIUArray, TRI))
+    if (!Entries[E].valid(LIUArray, TRI)) {
       Entries[E].revalidate(LIUArray, TRI);
+      ++NumEntryFills;
+    }
     return &Entries[E];
   }
   // No valid entry exists, pick the next round-robin entry.
@@ -72,6 +75,7 @@ InterferenceCache::Entry *InterferenceCache::get(unsigned PhysReg) {
       continue;
     }
     Entries[E].reset(PhysReg, LIUArray, TRI, MF);
+    ++NumEntryFills;
     PhysRegEntries[PhysReg] = E;
     return &Entries[E];
   }
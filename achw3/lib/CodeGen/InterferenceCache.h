@@ -142,6 +142,9 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
   // Next round-robin entry to be picked.
   unsigned RoundRobin;
 
+  // Number of times an entry was filled or revalidated since init().
+  unsigned NumEntryFills;
+
   // The actual cache entries.
   Entry Entries[CacheEntries];
 
@@ -151,7 +154,7 @@ class LLVM_LIBRARY_VISIBILITY InterferenceCache {
 public:
   InterferenceCache()
     : TRI(nullptr), LIUArray(nullptr), MF(nullptr), PhysRegEntries(nullptr),
-      PhysRegEntriesCount(0), RoundRobin(0) {}
+      PhysRegEntriesCount(0), RoundRobin(0), NumEntryFills(0) {}
 
   ~InterferenceCache() {
     free(PhysRegEntries);
@@ -167,6 +170,12 @@ public:
   /// be supported.
   unsigned getMaxCursors() const { return CacheEntries; }
 
+  /// getNumEntryFills - Return the number of times a cache entry has been
+  /// (re)computed for a physreg since the last init(). Every fill makes the
+  /// per-block interference be recomputed lazily, so this tracks the work done
+  /// on behalf of the cache's clients.
+  unsigned getNumEntryFills() const { return NumEntryFills; }
+
   /// Cursor - The primary query interface for the block interference cache.
   class Cursor {
     Entry *CacheEntry;
@@ -19,6 +19,7 @@
 #include "LiveRangeCalc.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/CodeGen/LiveVariables.h"
 #include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
@@ -43,6 +44,13 @@ using namespace llvm;
 
 #define DEBUG_TYPE "regalloc"
 
+STATISTIC(NumVirtIntervals, "Number of virtual register intervals computed");
+STATISTIC(NumVirtSegments, "Number of segments in computed virtual intervals");
+STATISTIC(NumVirtOutOfLine,
+          "Number of computed virtual intervals that do not fit inline");
+STATISTIC(NumVirtLocal,
+          "Number of computed virtual intervals local to one block");
+
 char LiveIntervals::ID = 0;
 char &llvm::LiveIntervalsID = LiveIntervals::ID;
 INITIALIZE_PASS_BEGIN(LiveIntervals, "liveintervals",
@@ -214,7 +222,14 @@ void LiveIntervals::computeVirtRegs() {
     unsigned Reg = TargetRegisterInfo::index2VirtReg(i);
     if (MRI->reg_nodbg_empty(Reg))
       continue;
-    createAndComputeVirtRegInterval(Reg);
+    LiveInterval &LI = createAndComputeVirtRegInterval(Reg);
+    ++NumVirtIntervals;
+    NumVirtSegments += LI.size();
+    if (LI.size() > LiveRange::InlineSegments ||
+        LI.getNumValNums() > LiveRange::InlineValNos)
+      ++NumVirtOutOfLine;
+    if (!LI.empty() && intervalIsInOneMBB(LI))
+      ++NumVirtLocal;
   }
 }
 
@@ -23,6 +23,12 @@
 // first time it reaches a chain of basic blocks, it schedules them in the
 // function in-order.
 //
+// Optionally, the chains can instead be formed by maximizing an extended TSP
+// score over the profiled CFG: an edge earns its full execution frequency when
+// it becomes a fall-through, and a fraction of it when it becomes a short
+// jump. This models instruction fetch locality rather than just the number of
+// taken branches.
+//
 //===----------------------------------------------------------------------===//
 
 #include "llvm/CodeGen/Passes.h"
@@ -38,9 +44,11 @@
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetInstrInfo.h"
 #include "llvm/Target/TargetLowering.h"
@@ -56,6 +64,8 @@ STATISTIC(CondBranchTakenFreq,
           "Potential frequency of taking conditional branches");
 STATISTIC(UncondBranchTakenFreq,
           "Potential frequency of taking unconditional branches");
+STATISTIC(NumExtTSPFunctions, "Number of functions laid out by ext-TSP");
+STATISTIC(NumExtTSPMerges, "Number of chain merges done by ext-TSP");
 
 static cl::opt<unsigned> AlignAllBlock("align-all-blocks",
                                        cl::desc("Force the alignment of all "
@@ -109,6 +119,18 @@ static cl::opt<unsigned> JumpInstCost("jump-inst-cost",
                                       cl::desc("Cost of jump instructions."),
                                       cl::init(1), cl::Hidden);
 
+static cl::opt<bool> ExtTSPBlockPlacement(
+    "ext-tsp-block-placement",
+    cl::desc("Lay out blocks by maximizing the extended TSP score of "
+             "fall-throughs and short jumps, weighted by block frequency."),
+    cl::init(false), cl::Hidden);
+
+static cl::opt<unsigned> ExtTSPMaxBlocks(
+    "ext-tsp-block-placement-max-blocks",
+    cl::desc("Use the default placement for functions with more blocks than "
+             "this, as the ext-TSP chain merging is quadratic."),
+    cl::init(1000), cl::Hidden);
+
 namespace {
 class BlockChain;
 /// \brief Type for our function-wide basic block -> block chain mapping.
@@ -209,6 +231,114 @@ public:
 };
 }
 
+namespace {
+/// \brief Scores block orders with the extended TSP objective.
+///
+/// Each CFG edge contributes its execution frequency, relative to the
+/// function entry, in full when its destination directly follows its source,
+/// and a tenth of it, decaying linearly with distance, when it is a forward
+/// jump of less than 1024 bytes or a backward jump of less than 640 bytes.
+/// Only edges between blocks of the scored order count.
+class ExtTSPScorer {
+  /// \brief Exact instruction sizes are not known before MC, so assume this
+  /// many bytes per instruction.
+  static const unsigned InstBytes = 4;
+  static const unsigned ForwardWindow = 1024;
+  static const unsigned BackwardWindow = 640;
+
+  const MachineBranchProbabilityInfo &MBPI;
+
+  /// \brief Estimated size in bytes and relative frequency of each block,
+  /// indexed by block number.
+  std::vector<uint64_t> Size;
+  std::vector<double> Freq;
+
+  /// \brief Position and offset of each block in the order being scored, or
+  /// -1 for blocks that are not part of it.
+  std::vector<int> Position;
+  std::vector<uint64_t> Offset;
+
+public:
+  ExtTSPScorer(MachineFunction &F, const MachineBranchProbabilityInfo &MBPI,
+               const MachineBlockFrequencyInfo &MBFI)
+      : MBPI(MBPI), Size(F.getNumBlockIDs()), Freq(F.getNumBlockIDs()),
+        Position(F.getNumBlockIDs(), -1), Offset(F.getNumBlockIDs()) {
+    double EntryFreq = MBFI.getEntryFreq();
+    for (MachineBasicBlock &MBB : F) {
+      unsigned NumInsts = 0;
+      for (MachineInstr &MI : MBB)
+        if (!MI.isDebugValue())
+          ++NumInsts;
+      Size[MBB.getNumber()] = NumInsts * InstBytes;
+      Freq[MBB.getNumber()] =
+          EntryFreq ? MBFI.getBlockFreq(&MBB).getFrequency() / EntryFreq : 0;
+    }
+  }
+
+  /// \brief Return the score of laying out the blocks in \p Order.
+  double score(ArrayRef<MachineBasicBlock *> Order) {
+    uint64_t Addr = 0;
+    for (unsigned I = 0, E = Order.size(); I != E; ++I) {
+      unsigned N = Order[I]->getNumber();
+      Position[N] = I;
+      Offset[N] = Addr;
+      Addr += Size[N];
+    }
+
+    double Score = 0;
+    for (MachineBasicBlock *MBB : Order) {
+      unsigned N = MBB->getNumber();
+      uint64_t SrcEnd = Offset[N] + Size[N];
+      for (MachineBasicBlock *Succ : MBB->successors()) {
+        unsigned S = Succ->getNumber();
+        if (Position[S] < 0)
+          continue;
+        BranchProbability Prob = MBPI.getEdgeProbability(MBB, Succ);
+        double Count = Freq[N] * Prob.getNumerator() /
+                       BranchProbability::getDenominator();
+        if (Position[S] == Position[N] + 1) {
+          Score += Count;
+          continue;
+        }
+        uint64_t DstBegin = Offset[S];
+        if (DstBegin >= SrcEnd) {
+          uint64_t Dist = DstBegin - SrcEnd;
+          if (Dist < ForwardWindow)
+            Score += 0.1 * Count * (1.0 - double(Dist) / ForwardWindow);
+        } else {
+          uint64_t Dist = SrcEnd - DstBegin;
+          if (Dist < BackwardWindow)
+            Score += 0.1 * Count * (1.0 - double(Dist) / BackwardWindow);
+        }
+      }
+    }
+
+    for (MachineBasicBlock *MBB : Order)
+      Position[MBB->getNumber()] = -1;
+    return Score;
+  }
+
+  /// \brief Return the execution frequency per byte of \p Order, used to put
+  /// hot code ahead of cold code.
+  double density(ArrayRef<MachineBasicBlock *> Order) const {
+    double TotalFreq = 0;
+    uint64_t TotalSize = 0;
+    for (MachineBasicBlock *MBB : Order) {
+      TotalFreq += Freq[MBB->getNumber()];
+      TotalSize += Size[MBB->getNumber()];
+    }
+    return TotalFreq / std::max<uint64_t>(TotalSize, 1);
+  }
+};
+
+/// \brief A group of block chains that ext-TSP placement lays out together.
+struct ExtTSPChain {
+  SmallVector<BlockChain *, 4> Chains;
+  SmallVector<MachineBasicBlock *, 8> Blocks;
+  double Score;
+};
+}
+
 namespace {
 class MachineBlockPlacement : public MachineFunctionPass {
   /// \brief A typedef for a block filter set.
@@ -280,7 +410,10 @@ class MachineBlockPlacement : public MachineFunctionPass {
                   const BlockFilterSet &LoopBlockSet);
   void rotateLoopWithProfile(BlockChain &LoopChain, MachineLoop &L,
                              const BlockFilterSet &LoopBlockSet);
+  void buildGreedyChain(MachineFunction &F, BlockChain &FunctionChain);
+  void buildExtTSPChain(MachineFunction &F, BlockChain &FunctionChain);
   void buildCFGChains(MachineFunction &F);
+  void reportLayoutScore(MachineFunction &F, double InputScore);
 
 public:
   static char ID; // Pass identification, replacement for typeid
@@ -1131,36 +1264,12 @@ void MachineBlockPlacement::buildLoopChains(MachineFunction &F,
   });
 }
 
-void MachineBlockPlacement::buildCFGChains(MachineFunction &F) {
-  // Ensure that every BB in the function has an associated chain to simplify
-  // the assumptions of the remaining algorithm.
-  SmallVector<MachineOperand, 4> Cond; // For AnalyzeBranch.
-  for (MachineFunction::iterator FI = F.begin(), FE = F.end(); FI != FE; ++FI) {
-    MachineBasicBlock *BB = &*FI;
-    BlockChain *Chain =
-        new (ChainAllocator.Allocate()) BlockChain(BlockToChain, BB);
-    // Also, merge any blocks which we cannot reason about and must preserve
-    // the exact fallthrough behavior for.
-    for (;;) {
-      Cond.clear();
-      MachineBasicBlock *TBB = nullptr, *FBB = nullptr; // For AnalyzeBranch.
-      if (!TII->AnalyzeBranch(*BB, TBB, FBB, Cond) || !FI->canFallThrough())
-        break;
-
-      MachineFunction::iterator NextFI = std::next(FI);
-      MachineBasicBlock *NextBB = &*NextFI;
-      // Ensure that the layout successor is a viable block, as we know that
-      // fallthrough is a possibility.
-      assert(NextFI != FE && "Can't fallthrough past the last block.");
-      DEBUG(dbgs() << "Pre-merging due to unanalyzable fallthrough: "
-                   << getBlockName(BB) << " -> " << getBlockName(NextBB)
-                   << "\n");
-      Chain->merge(NextBB, nullptr);
-      FI = NextFI;
-      BB = NextBB;
-    }
-  }
-
+/// \brief Build the function chain greedily from branch probabilities.
+///
+/// Loops are laid out first, innermost outward, and the remaining chains are
+/// then placed in topological order, favoring the most likely successor.
+void MachineBlockPlacement::buildGreedyChain(MachineFunction &F,
+                                             BlockChain &FunctionChain) {
   if (OutlineOptionalBranches) {
     // Find the nearest common dominator of all of F's terminators.
     MachineBasicBlock *Terminator = nullptr;
@@ -1208,8 +1317,170 @@ void MachineBlockPlacement::buildCFGChains(MachineFunction &F) {
       BlockWorkList.push_back(*Chain.begin());
   }
 
-  BlockChain &FunctionChain = *BlockToChain[&F.front()];
   buildChain(&F.front(), FunctionChain, BlockWorkList);
+}
+
+/// \brief Build the function chain by maximizing the ext-TSP score.
+///
+/// Starting from the chains that must stay together, repeatedly concatenate
+/// the pair of chains connected by an edge whose concatenation gains the
+/// most score, keeping the entry block first. When no concatenation gains
+/// anything, the remaining chains are placed by decreasing density so that
+/// cold code ends up at the end of the function.
+void MachineBlockPlacement::buildExtTSPChain(MachineFunction &F,
+                                             BlockChain &FunctionChain) {
+  ++NumExtTSPFunctions;
+  ExtTSPScorer Scorer(F, *MBPI, *MBFI);
+
+  std::vector<ExtTSPChain> Chains;
+  std::vector<unsigned> ChainOf(F.getNumBlockIDs());
+  for (MachineBasicBlock &MBB : F) {
+    BlockChain *Chain = BlockToChain[&MBB];
+    if (*Chain->begin() != &MBB)
+      continue;
+    Chains.emplace_back();
+    ExtTSPChain &C = Chains.back();
+    C.Chains.push_back(Chain);
+    C.Blocks.append(Chain->begin(), Chain->end());
+    C.Score = Scorer.score(C.Blocks);
+    for (MachineBasicBlock *ChainBB : C.Blocks)
+      ChainOf[ChainBB->getNumber()] = Chains.size() - 1;
+  }
+  assert(Chains.front().Chains.front() == &FunctionChain &&
+         "Entry chain must come first");
+
+  // Gains below this are rounding noise; frequencies are relative to entry.
+  const double MinGain = 1e-9;
+
+  // The gain of concatenating each pair of chains connected by an edge, keyed
+  // by the pair in layout order. A merge only changes the gains of pairs that
+  // involve the merged chains, so all others are kept from one round to the
+  // next.
+  DenseMap<std::pair<unsigned, unsigned>, double> Gains;
+  SmallVector<MachineBasicBlock *, 16> Merged;
+  auto AddPairs = [&](unsigned X) {
+    auto AddNeighbor = [&](MachineBasicBlock *Other) {
+      unsigned Y = ChainOf[Other->getNumber()];
+      if (Y == X)
+        return;
+      // Try both X followed by Y and Y followed by X, but never move the
+      // entry chain away from the front.
+      std::pair<unsigned, unsigned> Orders[] = {{X, Y}, {Y, X}};
+      for (auto &P : Orders) {
+        if (P.second == 0 || Gains.count(P))
+          continue;
+        Merged.clear();
+        Merged.append(Chains[P.first].Blocks.begin(),
+                      Chains[P.first].Blocks.end());
+        Merged.append(Chains[P.second].Blocks.begin(),
+                      Chains[P.second].Blocks.end());
+        Gains[P] = Scorer.score(Merged) - Chains[P.first].Score -
+                   Chains[P.second].Score;
+      }
+    };
+    for (MachineBasicBlock *MBB : Chains[X].Blocks) {
+      for (MachineBasicBlock *Succ : MBB->successors())
+        AddNeighbor(Succ);
+      for (MachineBasicBlock *Pred : MBB->predecessors())
+        AddNeighbor(Pred);
+    }
+  };
+  for (unsigned X = 0, E = Chains.size(); X != E; ++X)
+    AddPairs(X);
+
+  for (;;) {
+    // Ties go to the first pair in chain order, so the result does not depend
+    // on the order of the map.
+    double BestGain = MinGain;
+    std::pair<unsigned, unsigned> Best(~0U, ~0U);
+    for (auto &Entry : Gains)
+      if (Entry.second > BestGain ||
+          (Entry.second == BestGain && Entry.first < Best)) {
+        BestGain = Entry.second;
+        Best = Entry.first;
+      }
+    if (BestGain == MinGain)
+      break;
+
+    unsigned BestPred = Best.first, BestSucc = Best.second;
+    ExtTSPChain &Pred = Chains[BestPred];
+    ExtTSPChain &Succ = Chains[BestSucc];
+    DEBUG(dbgs() << "ext-TSP: merging chain at " << getBlockName(Pred.Blocks[0])
+                 << " with chain at " << getBlockName(Succ.Blocks[0])
+                 << ", gain " << format("%.6f", BestGain) << "\n");
+    ++NumExtTSPMerges;
+    for (MachineBasicBlock *ChainBB : Succ.Blocks)
+      ChainOf[ChainBB->getNumber()] = BestPred;
+    Pred.Chains.append(Succ.Chains.begin(), Succ.Chains.end());
+    Pred.Blocks.append(Succ.Blocks.begin(), Succ.Blocks.end());
+    Pred.Score += Succ.Score + BestGain;
+    Succ.Chains.clear();
+    Succ.Blocks.clear();
+    Succ.Score = 0;
+
+    for (auto I = Gains.begin(), E = Gains.end(); I != E; ++I) {
+      const std::pair<unsigned, unsigned> &P = I->first;
+      if (P.first == BestPred || P.second == BestPred ||
+          P.first == BestSucc || P.second == BestSucc)
+        Gains.erase(I);
+    }
+    AddPairs(BestPred);
+  }
+
+  // Place the entry chain first and the rest from hot to cold. The sort is
+  // stable, so equally dense chains keep their original relative order.
+  SmallVector<ExtTSPChain *, 16> Order;
+  for (ExtTSPChain &C : make_range(std::next(Chains.begin()), Chains.end()))
+    if (!C.Blocks.empty())
+      Order.push_back(&C);
+  std::stable_sort(Order.begin(), Order.end(),
+                   [&](ExtTSPChain *A, ExtTSPChain *B) {
+                     return Scorer.density(A->Blocks) >
+                            Scorer.density(B->Blocks);
+                   });
+  Order.insert(Order.begin(), &Chains.front());
+
+  for (ExtTSPChain *C : Order)
+    for (BlockChain *Chain : C->Chains)
+      if (Chain != &FunctionChain)
+        FunctionChain.merge(*Chain->begin(), Chain);
+}
+
+void MachineBlockPlacement::buildCFGChains(MachineFunction &F) {
+  // Ensure that every BB in the function has an associated chain to simplify
+  // the assumptions of the remaining algorithm.
+  SmallVector<MachineOperand, 4> Cond; // For AnalyzeBranch.
+  for (MachineFunction::iterator FI = F.begin(), FE = F.end(); FI != FE; ++FI) {
+    MachineBasicBlock *BB = &*FI;
+    BlockChain *Chain =
+        new (ChainAllocator.Allocate()) BlockChain(BlockToChain, BB);
+    // Also, merge any blocks which we cannot reason about and must preserve
+    // the exact fallthrough behavior for.
+    for (;;) {
+      Cond.clear();
+      MachineBasicBlock *TBB = nullptr, *FBB = nullptr; // For AnalyzeBranch.
+      if (!TII->AnalyzeBranch(*BB, TBB, FBB, Cond) || !FI->canFallThrough())
+        break;
+
+      MachineFunction::iterator NextFI = std::next(FI);
+      MachineBasicBlock *NextBB = &*NextFI;
+      // Ensure that the layout successor is a viable block, as we know that
+      // fallthrough is a possibility.
+      assert(NextFI != FE && "Can't fallthrough past the last block.");
+      DEBUG(dbgs() << "Pre-merging due to unanalyzable fallthrough: "
+                   << getBlockName(BB) << " -> " << getBlockName(NextBB)
+                   << "\n");
+      Chain->merge(NextBB, nullptr);
+      FI = NextFI;
+      BB = NextBB;
+    }
+  }
+
+  BlockChain &FunctionChain = *BlockToChain[&F.front()];
+  if (ExtTSPBlockPlacement && F.size() <= ExtTSPMaxBlocks)
+    buildExtTSPChain(F, FunctionChain);
+  else
+    buildGreedyChain(F, FunctionChain);
 
 #ifndef NDEBUG
   typedef SmallPtrSet<MachineBasicBlock *, 16> FunctionBlockSetType;
@@ -1380,6 +1651,28 @@ void MachineBlockPlacement::buildCFGChains(MachineFunction &F) {
   }
 }
 
+/// \brief Report the ext-TSP score of the final layout next to that of the
+/// input layout, as a measure of layout quality. Functions too large for
+/// ext-TSP placement are laid out by branch probability and say so.
+void MachineBlockPlacement::reportLayoutScore(MachineFunction &F,
+                                              double InputScore) {
+  SmallVector<MachineBasicBlock *, 16> Layout;
+  for (MachineBasicBlock &MBB : F)
+    Layout.push_back(&MBB);
+  double Score = ExtTSPScorer(F, *MBPI, *MBFI).score(Layout);
+
+  std::string Msg;
+  raw_string_ostream OS(Msg);
+  OS << "layout score " << format("%.3f", Score) << " (input "
+     << format("%.3f", InputScore) << ") using "
+     << (F.size() <= ExtTSPMaxBlocks ? "ext-TSP" : "branch probability")
+     << " placement";
+  DEBUG(dbgs() << F.getName() << ": " << OS.str() << "\n");
+  const Function &Fn = *F.getFunction();
+  emitOptimizationRemarkAnalysis(Fn.getContext(), DEBUG_TYPE, Fn, DebugLoc(),
+                                 OS.str());
+}
+
 bool MachineBlockPlacement::runOnMachineFunction(MachineFunction &F) {
   // Check for single-block functions and skip them.
   if (std::next(F.begin()) == F.end())
@@ -1396,7 +1689,24 @@ bool MachineBlockPlacement::runOnMachineFunction(MachineFunction &F) {
   MDT = &getAnalysis<MachineDominatorTree>();
   assert(BlockToChain.empty());
 
+  // Scoring a layout walks every edge of the function, so only do it when
+  // ext-TSP placement is on and someone asked for the remark.
+  const Function &Fn = *F.getFunction();
+  bool ReportScore =
+      ExtTSPBlockPlacement &&
+      DiagnosticInfoOptimizationRemarkAnalysis(DEBUG_TYPE, Fn, DebugLoc(), "")
+          .isEnabled();
+  double InputScore = 0;
+  if (ReportScore) {
+    SmallVector<MachineBasicBlock *, 16> InputOrder;
+    for (MachineBasicBlock &MBB : F)
+      InputOrder.push_back(&MBB);
+    InputScore = ExtTSPScorer(F, *MBPI, *MBFI).score(InputOrder);
+  }
+
   buildCFGChains(F);
+  if (ReportScore)
+    reportLayoutScore(F, InputScore);
 
   BlockToChain.clear();
   ChainAllocator.DestroyAll();
@@ -14,8 +14,10 @@
 
 #include "llvm/CodeGen/MachineScheduler.h"
 #include "llvm/ADT/PriorityQueue.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/CodeGen/LiveIntervalAnalysis.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
 #include "llvm/CodeGen/MachineDominators.h"
 #include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
@@ -35,6 +37,9 @@ using namespace llvm;
 
 #define DEBUG_TYPE "misched"
 
+STATISTIC(NumHotRegions, "Number of hot regions scheduled with lookahead");
+STATISTIC(NumColdRegions, "Number of cold regions left in source order");
+
 namespace llvm {
 cl::opt<bool> ForceTopDown("misched-topdown", cl::Hidden,
                            cl::desc("Force top-down list scheduling"));
@@ -93,7 +98,8 @@ void ScheduleDAGMutation::anchor() {}
 //===----------------------------------------------------------------------===//
 
 MachineSchedContext::MachineSchedContext():
-    MF(nullptr), MLI(nullptr), MDT(nullptr), PassConfig(nullptr), AA(nullptr), LIS(nullptr) {
+    MF(nullptr), MLI(nullptr), MDT(nullptr), PassConfig(nullptr), AA(nullptr),
+    LIS(nullptr), MBFI(nullptr) {
   RegClassInfo = new RegisterClassInfo();
 }
 
@@ -154,6 +160,7 @@ INITIALIZE_PASS_BEGIN(MachineScheduler, "machine-scheduler",
 INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(SlotIndexes)
 INITIALIZE_PASS_DEPENDENCY(LiveIntervals)
+INITIALIZE_PASS_DEPENDENCY(MachineBlockFrequencyInfo)
 INITIALIZE_PASS_END(MachineScheduler, "machine-scheduler",
                     "Machine Instruction Scheduler", false, false)
 
@@ -162,8 +169,12 @@ MachineScheduler::MachineScheduler()
   initializeMachineSchedulerPass(*PassRegistry::getPassRegistry());
 }
 
+static bool isProfileGuidedSchedSelected();
+
 void MachineScheduler::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesCFG();
+  if (isProfileGuidedSchedSelected())
+    AU.addRequired<MachineBlockFrequencyInfo>();
   AU.addRequiredID(MachineDominatorsID);
   AU.addRequired<MachineLoopInfo>();
   AU.addRequired<AAResultsWrapperPass>();
@@ -330,6 +341,9 @@ bool MachineScheduler::runOnMachineFunction(MachineFunction &mf) {
   AA = &getAnalysis<AAResultsWrapperPass>().getAAResults();
 
   LIS = &getAnalysis<LiveIntervals>();
+  MBFI = isProfileGuidedSchedSelected()
+             ? &getAnalysis<MachineBlockFrequencyInfo>()
+             : nullptr;
 
   if (VerifyScheduling) {
     DEBUG(LIS->dump());
@@ -665,6 +679,10 @@ bool ScheduleDAGMI::checkSchedLimit() {
 void ScheduleDAGMI::schedule() {
   DEBUG(dbgs() << "ScheduleDAGMI::schedule starting\n");
   DEBUG(SchedImpl->dumpPolicy());
+  if (!SchedImpl->shouldScheduleRegion()) {
+    DEBUG(dbgs() << "Region left in source order\n");
+    return;
+  }
 
   // Build the DAG.
   buildSchedGraph(AA);
@@ -1029,6 +1047,10 @@ void ScheduleDAGMILive::updatePressureDiffs(ArrayRef<unsigned> LiveUses) {
 void ScheduleDAGMILive::schedule() {
   DEBUG(dbgs() << "ScheduleDAGMILive::schedule starting\n");
   DEBUG(SchedImpl->dumpPolicy());
+  if (!SchedImpl->shouldScheduleRegion()) {
+    DEBUG(dbgs() << "Region left in source order\n");
+    return;
+  }
   buildDAGWithRegPressure();
 
   Topo.InitDAGTopologicalSorting();
@@ -2308,6 +2330,7 @@ const char *GenericSchedulerBase::getReasonStr(
   case TopPathReduce:  return "TOP-PATH  ";
   case BotHeightReduce:return "BOT-HEIGHT";
   case BotPathReduce:  return "BOT-PATH  ";
+  case Lookahead:      return "LOOKAHEAD ";
   case NextDefUse:     return "DEF-USE   ";
   case NodeOrder:      return "ORDER     ";
   };
@@ -2515,6 +2538,8 @@ void GenericScheduler::dumpPolicy() {
          << " ShouldTrackPressure=" << RegionPolicy.ShouldTrackPressure
          << " OnlyTopDown=" << RegionPolicy.OnlyTopDown
          << " OnlyBottomUp=" << RegionPolicy.OnlyBottomUp
+         << " ForceLatencyHeuristic=" << RegionPolicy.ForceLatencyHeuristic
+         << " EnableLookahead=" << RegionPolicy.EnableLookahead
          << "\n";
 }
 
@@ -2612,6 +2637,21 @@ static unsigned getWeakLeft(const SUnit *SU, bool isTop) {
   return (isTop) ? SU->WeakPredsLeft : SU->WeakSuccsLeft;
 }
 
+/// Count the nodes that become ready in the zone once SU is scheduled.
+static unsigned getNumReleased(const SUnit *SU, bool isTop) {
+  unsigned NumReleased = 0;
+  if (isTop) {
+    for (const SDep &Succ : SU->Succs)
+      if (!Succ.isWeak() && Succ.getSUnit()->NumPredsLeft == 1)
+        ++NumReleased;
+  } else {
+    for (const SDep &Pred : SU->Preds)
+      if (!Pred.isWeak() && Pred.getSUnit()->NumSuccsLeft == 1)
+        ++NumReleased;
+  }
+  return NumReleased;
+}
+
 /// Minimize physical register live ranges. Regalloc wants them adjacent to
 /// their physreg def/use.
 ///
@@ -2764,11 +2804,19 @@ void GenericScheduler::tryCandidate(SchedCandidate &Cand,
 
   // Avoid serializing long latency dependence chains.
   // For acyclic path limited loops, latency was already checked above.
-  if (!RegionPolicy.DisableLatencyHeuristic && Cand.Policy.ReduceLatency &&
+  if (!RegionPolicy.DisableLatencyHeuristic &&
+      (Cand.Policy.ReduceLatency || RegionPolicy.ForceLatencyHeuristic) &&
       !Rem.IsAcyclicLatencyLimited && tryLatency(TryCand, Cand, Zone)) {
     return;
   }
 
+  // Keep as many nodes ready as possible, so later picks have a choice.
+  if (RegionPolicy.EnableLookahead &&
+      tryGreater(getNumReleased(TryCand.SU, Zone.isTop()),
+                 getNumReleased(Cand.SU, Zone.isTop()),
+                 TryCand, Cand, Lookahead))
+    return;
+
   // Prefer immediate defs/users of the last scheduled instruction. This is a
   // local pressure avoidance strategy that also makes the machine code
   // readable.
@@ -2987,6 +3035,106 @@ static MachineSchedRegistry
 GenericSchedRegistry("converge", "Standard converging scheduler.",
                      createGenericSchedLive);
 
+//===----------------------------------------------------------------------===//
+// ProfileGuidedScheduler - Spend scheduling effort where blocks are hot.
+//===----------------------------------------------------------------------===//
+
+static cl::opt<unsigned> ProfileSchedHotPercent(
+  "misched-profile-hot-percent", cl::Hidden, cl::init(400),
+  cl::desc("Block frequency, as a percentage of the entry frequency, at which "
+           "-misched=profile schedules with lookahead"));
+
+static cl::opt<unsigned> ProfileSchedColdPercent(
+  "misched-profile-cold-percent", cl::Hidden, cl::init(10),
+  cl::desc("Block frequency, as a percentage of the entry frequency, below "
+           "which -misched=profile keeps the source order"));
+
+/// Return true if Freq is at least Percent percent of EntryFreq.
+static bool isFreqAtLeast(uint64_t Freq, uint64_t EntryFreq, unsigned Percent) {
+  APInt Scaled(128, Freq);
+  Scaled *= APInt(128, 100);
+  APInt Limit(128, EntryFreq);
+  Limit *= APInt(128, Percent);
+  return Scaled.uge(Limit);
+}
+
+namespace {
+/// GenericScheduler variant that looks at the frequency of each region's
+/// block. Cold regions are left in source order without building a DAG. Hot
+/// regions are scheduled in both directions with register pressure tracking,
+/// the latency heuristic always on, and one step of lookahead. Everything in
+/// between gets the standard policy.
+class ProfileGuidedScheduler : public GenericScheduler {
+  enum RegionKind { ColdRegion, WarmRegion, HotRegion };
+  RegionKind Kind;
+
+public:
+  ProfileGuidedScheduler(const MachineSchedContext *C)
+      : GenericScheduler(C), Kind(WarmRegion) {}
+
+  void initPolicy(MachineBasicBlock::iterator Begin,
+                  MachineBasicBlock::iterator End,
+                  unsigned NumRegionInstrs) override {
+    GenericScheduler::initPolicy(Begin, End, NumRegionInstrs);
+
+    Kind = WarmRegion;
+    const MachineBlockFrequencyInfo *MBFI = Context->MBFI;
+    if (!MBFI)
+      return;
+    uint64_t Freq = MBFI->getBlockFreq(Begin->getParent()).getFrequency();
+    uint64_t EntryFreq = MBFI->getEntryFreq();
+    if (isFreqAtLeast(Freq, EntryFreq, ProfileSchedHotPercent))
+      Kind = HotRegion;
+    else if (!isFreqAtLeast(Freq, EntryFreq, ProfileSchedColdPercent))
+      Kind = ColdRegion;
+
+    if (Kind == HotRegion) {
+      RegionPolicy.ShouldTrackPressure = true;
+      RegionPolicy.OnlyTopDown = false;
+      RegionPolicy.OnlyBottomUp = false;
+      RegionPolicy.ForceLatencyHeuristic = true;
+      RegionPolicy.EnableLookahead = true;
+    }
+  }
+
+  bool shouldTrackPressure() const override {
+    return Kind != ColdRegion && GenericScheduler::shouldTrackPressure();
+  }
+
+  bool shouldScheduleRegion() const override {
+    if (Kind == ColdRegion) {
+      ++NumColdRegions;
+      return false;
+    }
+    if (Kind == HotRegion)
+      ++NumHotRegions;
+    return true;
+  }
+};
+} // namespace
+
+static ScheduleDAGInstrs *createProfileGuidedSched(MachineSchedContext *C) {
+  ScheduleDAGMILive *DAG =
+      new ScheduleDAGMILive(C, make_unique<ProfileGuidedScheduler>(C));
+  DAG->addMutation(make_unique<CopyConstrain>(DAG->TII, DAG->TRI));
+  if (EnableLoadCluster && DAG->TII->enableClusterLoads())
+    DAG->addMutation(make_unique<LoadClusterMutation>(DAG->TII, DAG->TRI));
+  if (EnableMacroFusion)
+    DAG->addMutation(make_unique<MacroFusion>(*DAG->TII, *DAG->TRI));
+  return DAG;
+}
+
+static MachineSchedRegistry
+ProfileGuidedSchedRegistry("profile",
+                           "Converging scheduler that schedules hot blocks "
+                           "harder and leaves cold blocks alone.",
+                           createProfileGuidedSched);
+
+/// MachineScheduler only computes block frequencies for this scheduler.
+static bool isProfileGuidedSchedSelected() {
+  return MachineSchedOpt == createProfileGuidedSched;
+}
+
 //===----------------------------------------------------------------------===//
 // PostGenericScheduler - Generic PostRA implementation of MachineSchedStrategy.
 //===----------------------------------------------------------------------===//
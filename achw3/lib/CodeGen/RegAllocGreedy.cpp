@@ -36,6 +36,7 @@
 #include "llvm/CodeGen/RegAllocRegistry.h"
 #include "llvm/CodeGen/RegisterClassInfo.h"
 #include "llvm/CodeGen/VirtRegMap.h"
+#include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/PassAnalysisSupport.h"
 #include "llvm/Support/BranchProbability.h"
@@ -54,6 +55,12 @@ using namespace llvm;
 STATISTIC(NumGlobalSplits, "Number of split global live ranges");
 STATISTIC(NumLocalSplits,  "Number of split local live ranges");
 STATISTIC(NumEvicted,      "Number of interferences evicted");
+STATISTIC(NumEvictBudgetExhausted,
+          "Number of functions that ran out of eviction budget");
+STATISTIC(NumSplitBudgetExhausted,
+          "Number of functions that ran out of splitting budget");
+STATISTIC(NumIntfCacheBudgetExhausted,
+          "Number of functions that ran out of interference cache budget");
 
 static cl::opt<SplitEditor::ComplementSpillMode>
 SplitSpillMode("split-spill-mode", cl::Hidden,
@@ -100,6 +107,26 @@ CSRFirstTimeCost("regalloc-csr-first-time-cost",
               cl::desc("Cost for first time use of callee-saved register."),
               cl::init(0), cl::Hidden);
 
+// Per-function compile time budgets. The defaults are far above what normal
+// code needs and only bound pathological inputs.
+static cl::opt<unsigned> EvictionBudget(
+    "regalloc-eviction-budget", cl::Hidden,
+    cl::desc("Evictions allowed per function before the greedy allocator "
+             "splits or spills instead (0 = unlimited)"),
+    cl::init(200000));
+
+static cl::opt<unsigned> SplitBudget(
+    "regalloc-split-budget", cl::Hidden,
+    cl::desc("Split attempts allowed per function before the greedy "
+             "allocator spills without splitting (0 = unlimited)"),
+    cl::init(50000));
+
+static cl::opt<unsigned> IntfCacheBudget(
+    "regalloc-intf-cache-budget", cl::Hidden,
+    cl::desc("Interference cache fills allowed per function before the "
+             "greedy allocator stops region splitting (0 = unlimited)"),
+    cl::init(2000000));
+
 static RegisterRegAlloc greedyRegAlloc("greedy", "greedy register allocator",
                                        createGreedyRegisterAllocator);
 
@@ -134,6 +161,13 @@ class RAGreedy : public MachineFunctionPass,
   PQueue Queue;
   unsigned NextCascade;
 
+  // Remaining compile time budgets for this function, see EvictionBudget,
+  // SplitBudget and IntfCacheBudget. ~0 means unlimited.
+  uint64_t EvictionsLeft;
+  uint64_t SplitsLeft;
+  uint64_t IntfCacheFillLimit;
+  bool EvictBudgetHit, SplitBudgetHit, IntfCacheBudgetHit;
+
   // Live ranges pass through a number of stages as we try to allocate them.
   // Some of the stages may also create new live ranges:
   //
@@ -363,6 +397,11 @@ private:
 
   unsigned tryAssign(LiveInterval&, AllocationOrder&,
                      SmallVectorImpl<unsigned>&);
+  void initBudgets();
+  bool mayEvict(LiveInterval&);
+  bool maySplit(LiveInterval&);
+  bool mayRegionSplit(LiveInterval&);
+  void reportBudgetExhausted(LiveInterval&, const Twine&);
   unsigned tryEvict(LiveInterval&, AllocationOrder&,
                     SmallVectorImpl<unsigned>&, unsigned = ~0u);
   unsigned tryRegionSplit(LiveInterval&, AllocationOrder&,
@@ -633,7 +672,8 @@ unsigned RAGreedy::tryAssign(LiveInterval &VirtReg,
       DEBUG(dbgs() << "missed hint " << PrintReg(Hint, TRI) << '\n');
       EvictionCost MaxCost;
       MaxCost.setBrokenHints(1);
-      if (canEvictInterference(VirtReg, Hint, true, MaxCost)) {
+      if (mayEvict(VirtReg) &&
+          canEvictInterference(VirtReg, Hint, true, MaxCost)) {
         evictInterference(VirtReg, Hint, NewVRegs);
         return Hint;
       }
@@ -835,6 +875,8 @@ void RAGreedy::evictInterference(LiveInterval &VirtReg, unsigned PhysReg,
            "Cannot decrease cascade number, illegal eviction");
     ExtraRegInfo[Intf->reg].Cascade = Cascade;
     ++NumEvicted;
+    if (EvictionsLeft && EvictionsLeft != ~0ULL)
+      --EvictionsLeft;
     NewVRegs.push_back(Intf->reg);
   }
 }
@@ -849,6 +891,80 @@ bool RAGreedy::isUnusedCalleeSavedReg(unsigned PhysReg) const {
   return !Matrix->isPhysRegUsed(PhysReg);
 }
 
+/// initBudgets - Compute the compile time budgets for the current function.
+void RAGreedy::initBudgets() {
+  auto Limit = [](unsigned Budget) -> uint64_t {
+    return Budget ? Budget : ~0ULL;
+  };
+  EvictionsLeft = Limit(EvictionBudget);
+  SplitsLeft = Limit(SplitBudget);
+  IntfCacheFillLimit = Limit(IntfCacheBudget);
+  EvictBudgetHit = SplitBudgetHit = IntfCacheBudgetHit = false;
+}
+
+/// reportBudgetExhausted - Tell the user that allocation of the current
+/// function degraded to a cheaper strategy, pointing at the live range that
+/// ran into the limit.
+void RAGreedy::reportBudgetExhausted(LiveInterval &VirtReg, const Twine &Msg) {
+  DEBUG(dbgs() << "Budget exhausted at " << PrintReg(VirtReg.reg) << ": "
+               << Msg << '\n');
+  const Function &Fn = *MF->getFunction();
+  DebugLoc DL;
+  if (const MachineInstr *Def = MRI->getUniqueVRegDef(VirtReg.reg))
+    DL = Def->getDebugLoc();
+  emitOptimizationRemarkAnalysis(Fn.getContext(), DEBUG_TYPE, Fn, DL, Msg);
+}
+
+/// mayEvict - Return true if VirtReg may still evict interference. Once the
+/// eviction budget is spent, spillable ranges go on to splitting and spilling
+/// instead. Unspillable ranges are exempt, they have no other way to get a
+/// register.
+bool RAGreedy::mayEvict(LiveInterval &VirtReg) {
+  if (EvictionsLeft || !VirtReg.isSpillable() || getStage(VirtReg) >= RS_Done)
+    return true;
+  if (!EvictBudgetHit) {
+    EvictBudgetHit = true;
+    ++NumEvictBudgetExhausted;
+    reportBudgetExhausted(VirtReg, "eviction budget exhausted; remaining live "
+                                   "ranges are split or spilled instead");
+  }
+  return false;
+}
+
+/// maySplit - Return true if VirtReg may still be split, and charge the
+/// attempt to the split budget. Without budget, the range is spilled whole.
+bool RAGreedy::maySplit(LiveInterval &VirtReg) {
+  if (SplitsLeft) {
+    if (SplitsLeft != ~0ULL)
+      --SplitsLeft;
+    return true;
+  }
+  if (!SplitBudgetHit) {
+    SplitBudgetHit = true;
+    ++NumSplitBudgetExhausted;
+    reportBudgetExhausted(VirtReg, "live range splitting budget exhausted; "
+                                   "remaining live ranges are spilled "
+                                   "without splitting");
+  }
+  return false;
+}
+
+/// mayRegionSplit - Return true if region splitting may still query the
+/// interference cache. Past the limit, global ranges fall back to the cheaper
+/// per-block splitting which does not need the cache.
+bool RAGreedy::mayRegionSplit(LiveInterval &VirtReg) {
+  if (IntfCache.getNumEntryFills() < IntfCacheFillLimit)
+    return true;
+  if (!IntfCacheBudgetHit) {
+    IntfCacheBudgetHit = true;
+    ++NumIntfCacheBudgetExhausted;
+    reportBudgetExhausted(VirtReg, "interference cache budget exhausted; "
+                                   "region splitting is disabled for the rest "
+                                   "of the function");
+  }
+  return false;
+}
+
 /// tryEvict - Try to evict all interferences for a physreg.
 /// @param  VirtReg Currently unassigned virtual register.
 /// @param  Order   Physregs to try.
@@ -857,6 +973,9 @@ unsigned RAGreedy::tryEvict(LiveInterval &VirtReg,
                             AllocationOrder &Order,
                             SmallVectorImpl<unsigned> &NewVRegs,
                             unsigned CostPerUseLimit) {
+  if (!mayEvict(VirtReg))
+    return 0;
+
   NamedRegionTimer T("Evict", TimerGroupName, TimePassesIsEnabled);
 
   // Keep track of the cheapest interference seen so far.
@@ -1945,6 +2064,9 @@ unsigned RAGreedy::trySplit(LiveInterval &VirtReg, AllocationOrder &Order,
   if (getStage(VirtReg) >= RS_Spill)
     return 0;
 
+  if (!maySplit(VirtReg))
+    return 0;
+
   // Local intervals are handled separately.
   if (LIS->intervalIsInOneMBB(VirtReg)) {
     NamedRegionTimer T("Local Splitting", TimerGroupName, TimePassesIsEnabled);
@@ -1973,7 +2095,7 @@ unsigned RAGreedy::trySplit(LiveInterval &VirtReg, AllocationOrder &Order,
   // First try to split around a region spanning multiple blocks. RS_Split2
   // ranges already made dubious progress with region splitting, so they go
   // straight to single block splitting.
-  if (getStage(VirtReg) < RS_Split2) {
+  if (getStage(VirtReg) < RS_Split2 && mayRegionSplit(VirtReg)) {
     unsigned PhysReg = tryRegionSplit(VirtReg, Order, NewVRegs);
     if (PhysReg || !NewVRegs.empty())
       return PhysReg;
@@ -2595,6 +2717,7 @@ bool RAGreedy::runOnMachineFunction(MachineFunction &mf) {
   ExtraRegInfo.clear();
   ExtraRegInfo.resize(MRI->getNumVirtRegs());
   NextCascade = 1;
+  initBudgets();
   IntfCache.init(MF, Matrix->getLiveUnions(), Indexes, LIS, TRI);
   GlobalCand.resize(32);  // This will grow as needed.
   SetOfBrokenHints.clear();
@@ -48,6 +48,8 @@ STATISTIC(PostIndexedNodes, "Number of post-indexed nodes created");
 STATISTIC(OpsNarrowed     , "Number of load/op/store narrowed");
 STATISTIC(LdStFP2Int      , "Number of fp load/store pairs transformed to int");
 STATISTIC(SlicedLoads, "Number of load sliced");
+STATISTIC(NodesVisited    , "Number of dag nodes visited by the combiner");
+STATISTIC(NodesRevisited  , "Number of dag nodes re-queued after being combined");
 
 namespace {
   static cl::opt<bool>
@@ -81,6 +83,12 @@ namespace {
     MaySplitLoadIndex("combiner-split-load-index", cl::Hidden, cl::init(true),
                       cl::desc("DAG combiner may split indexing from loads"));
 
+  static cl::opt<bool>
+    CombinerTopologicalOrder("combiner-topological-order", cl::Hidden,
+                             cl::init(false),
+                             cl::desc("Visit DAG nodes operands-first in the "
+                                      "DAG combiner"));
+
 //------------------------------ DAGCombiner ---------------------------------//
 
   class DAGCombiner {
@@ -98,21 +106,18 @@ namespace {
     /// back and when processing we pop off of the back.
     ///
     /// The worklist will not contain duplicates but may contain null entries
-    /// due to nodes being deleted from the underlying DAG.
+    /// due to nodes being deleted from the underlying DAG. Each node records
+    /// its own position on the worklist (see
+    /// SDNode::getCombinerWorklistIndex), so membership tests and removal are
+    /// constant time and need no side table. A node that has been combined
+    /// and is not queued again is marked with CombinedIndex, which lets us
+    /// add only the operands that have not been combined yet.
     SmallVector<SDNode *, 64> Worklist;
 
-    /// \brief Mapping from an SDNode to its position on the worklist.
-    ///
-    /// This is used to find and remove nodes from the worklist (by nulling
-    /// them) when they are deleted from the underlying DAG. It relies on
-    /// stable indices of nodes within the worklist.
-    DenseMap<SDNode *, unsigned> WorklistMap;
-
-    /// \brief Set of nodes which have been combined (at least once).
-    ///
-    /// This is used to allow us to reliably add any operands of a DAG node
-    /// which have not yet been combined to the worklist.
-    SmallPtrSet<SDNode *, 64> CombinedNodes;
+    /// Worklist index of a node that is not on the worklist.
+    static const int NotQueuedIndex = -1;
+    /// Worklist index of a node that has been combined and not re-queued.
+    static const int CombinedIndex = -2;
 
     // AA - Used for DAG load/store alias analysis.
     AliasAnalysis &AA;
@@ -136,21 +141,41 @@ namespace {
       if (N->getOpcode() == ISD::HANDLENODE)
         return;
 
-      if (WorklistMap.insert(std::make_pair(N, Worklist.size())).second)
-        Worklist.push_back(N);
+      int Index = N->getCombinerWorklistIndex();
+      if (Index >= 0)
+        return; // Already in the worklist.
+      if (Index == CombinedIndex)
+        ++NodesRevisited;
+
+      N->setCombinerWorklistIndex(Worklist.size());
+      Worklist.push_back(N);
     }
 
     /// Remove all instances of N from the worklist.
     void removeFromWorklist(SDNode *N) {
-      CombinedNodes.erase(N);
-
-      auto It = WorklistMap.find(N);
-      if (It == WorklistMap.end())
+      int Index = N->getCombinerWorklistIndex();
+      N->setCombinerWorklistIndex(NotQueuedIndex);
+      if (Index < 0)
         return; // Not in the worklist.
 
       // Null out the entry rather than erasing it to avoid a linear operation.
-      Worklist[It->second] = nullptr;
-      WorklistMap.erase(It);
+      Worklist[Index] = nullptr;
+    }
+
+    /// Pop the next node to combine off the worklist, skipping entries of
+    /// deleted nodes, and mark it as combined. Returns null once the worklist
+    /// is empty.
+    SDNode *getNextWorklistEntry() {
+      SDNode *N = nullptr;
+      while (!N && !Worklist.empty())
+        N = Worklist.pop_back_val();
+      if (N) {
+        assert(N->getCombinerWorklistIndex() == (int)Worklist.size() &&
+               "Found a worklist entry with a stale index!");
+        N->setCombinerWorklistIndex(CombinedIndex);
+        ++NodesVisited;
+      }
+      return N;
     }
 
     void deleteAndRecombine(SDNode *N);
@@ -1250,9 +1275,22 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
   LegalOperations = Level >= AfterLegalizeVectorOps;
   LegalTypes = Level >= AfterLegalizeTypes;
 
-  // Add all the dag nodes to the worklist.
-  for (SDNode &Node : DAG.allnodes())
-    AddToWorklist(&Node);
+  // Add all the dag nodes to the worklist, clearing any state left behind by
+  // an earlier combine of this DAG. Since the worklist is a stack, queueing a
+  // topologically sorted DAG from the bottom up means operands are combined
+  // before their users, which saves revisiting users whose operands change.
+  if (CombinerTopologicalOrder) {
+    DAG.AssignTopologicalOrder();
+    for (SDNode &Node : reverse(DAG.allnodes())) {
+      Node.setCombinerWorklistIndex(NotQueuedIndex);
+      AddToWorklist(&Node);
+    }
+  } else {
+    for (SDNode &Node : DAG.allnodes()) {
+      Node.setCombinerWorklistIndex(NotQueuedIndex);
+      AddToWorklist(&Node);
+    }
+  }
 
   // Create a dummy node (which is not added to allnodes), that adds a reference
   // to the root node, preventing it from being deleted, and tracking any
@@ -1261,18 +1299,7 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
 
   // while the worklist isn't empty, find a node and
   // try and combine it.
-  while (!WorklistMap.empty()) {
-    SDNode *N;
-    // The Worklist holds the SDNodes in order, but it may contain null entries.
-    do {
-      N = Worklist.pop_back_val();
-    } while (!N);
-
-    bool GoodWorklistEntry = WorklistMap.erase(N);
-    (void)GoodWorklistEntry;
-    assert(GoodWorklistEntry &&
-           "Found a worklist entry without a corresponding map entry!");
-
+  while (SDNode *N = getNextWorklistEntry()) {
     // If N has no uses, it is dead.  Make sure to revisit all N's operands once
     // N is deleted from the DAG, since they too may now be dead or may have a
     // reduced number of uses, allowing other xforms.
@@ -1300,9 +1327,8 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
     // Add any operands of the new node which have not yet been combined to the
     // worklist as well. Because the worklist uniques things already, this
     // won't repeatedly process the same operand.
-    CombinedNodes.insert(N);
     for (const SDValue &ChildN : N->op_values())
-      if (!CombinedNodes.count(ChildN.getNode()))
+      if (ChildN->getCombinerWorklistIndex() != CombinedIndex)
         AddToWorklist(ChildN.getNode());
 
     SDValue RV = combine(N);
@@ -37,6 +37,7 @@
 #include "llvm/CodeGen/WinEHFuncInfo.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
@@ -71,6 +72,16 @@ STATISTIC(NumDAGIselRetries,"Number of times dag isel has to try another path");
 STATISTIC(NumEntryBlocks, "Number of entry blocks encountered");
 STATISTIC(NumFastIselFailLowerArguments,
           "Number of entry blocks where fast isel failed to lower arguments");
+STATISTIC(NumFastIselMissVectorTy,
+          "Number of fast isel misses on instructions with vector types");
+STATISTIC(NumFastIselMissFPTy,
+          "Number of fast isel misses on instructions with FP types");
+STATISTIC(NumFastIselMissAggregateTy,
+          "Number of fast isel misses on instructions with aggregate types");
+STATISTIC(NumFastIselMissIllegalTy,
+          "Number of fast isel misses on instructions with illegal types");
+STATISTIC(NumFastIselMissLegalTy,
+          "Number of fast isel misses on instructions with legal scalar types");
 
 #ifndef NDEBUG
 static cl::opt<bool>
@@ -1149,6 +1160,58 @@ static void collectFailStats(const Instruction *I) {
 }
 #endif
 
+/// Return the type that decides whether FastISel can handle \p I. This is the
+/// source type for casts and compares, the type of the first operand for
+/// stores, returns and branches, and the result type otherwise.
+static Type *getFastISelMissType(const Instruction *I) {
+  if (isa<CastInst>(I) || isa<CmpInst>(I))
+    return I->getOperand(0)->getType();
+  if (!I->getType()->isVoidTy() || I->getNumOperands() == 0 ||
+      isa<CallInst>(I) || isa<InvokeInst>(I))
+    return I->getType();
+  return I->getOperand(0)->getType();
+}
+
+/// Classify a FastISel miss by the type involved and, when missed remarks are
+/// enabled for isel, report which opcode and type sent the instruction to
+/// SelectionDAG.
+static void reportFastISelMiss(const Instruction *I, const TargetLowering &TLI,
+                               const DataLayout &DL) {
+  Type *Ty = getFastISelMissType(I);
+  if (Ty->isVectorTy())
+    ++NumFastIselMissVectorTy;
+  else if (Ty->isAggregateType())
+    ++NumFastIselMissAggregateTy;
+  else if (!Ty->isVoidTy() &&
+           !TLI.isTypeLegal(TLI.getValueType(DL, Ty, /*AllowUnknown=*/true)))
+    ++NumFastIselMissIllegalTy;
+  else if (Ty->isFloatingPointTy())
+    ++NumFastIselMissFPTy;
+  else
+    ++NumFastIselMissLegalTy;
+
+  const Function &Fn = *I->getParent()->getParent();
+  const DebugLoc &DLoc = I->getDebugLoc();
+  if (!DiagnosticInfoOptimizationRemarkMissed(DEBUG_TYPE, Fn, DLoc, "")
+           .isEnabled())
+    return;
+
+  std::string TyStr;
+  raw_string_ostream OS(TyStr);
+  Ty->print(OS);
+  OS.flush();
+
+  std::string Callee;
+  if (auto *CI = dyn_cast<CallInst>(I))
+    if (const Function *F = CI->getCalledFunction())
+      Callee = (" to " + F->getName()).str();
+
+  emitOptimizationRemarkMissed(I->getContext(), DEBUG_TYPE, Fn, DLoc,
+                               "FastISel missed " + Twine(I->getOpcodeName()) +
+                                   Callee + " of type " + TyStr +
+                                   "; using SelectionDAG instead");
+}
+
 void SelectionDAGISel::SelectAllBasicBlocks(const Function &Fn) {
   // Initialize the Fast-ISel state, if needed.
   FastISel *FastIS = nullptr;
@@ -1276,6 +1339,7 @@ void SelectionDAGISel::SelectAllBasicBlocks(const Function &Fn) {
         if (EnableFastISelVerbose2)
           collectFailStats(Inst);
 #endif
+        reportFastISelMiss(Inst, *TLI, Fn.getParent()->getDataLayout());
 
         // Then handle certain instructions as single-LLVM-Instruction blocks.
         if (isa<CallInst>(Inst)) {
@@ -36,17 +36,23 @@
 #include "llvm/IR/TypeFinder.h"
 #include "llvm/IR/UseListOrder.h"
 #include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/MathExtras.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cctype>
 using namespace llvm;
 
+static cl::opt<unsigned> AsmWriterThreads(
+    "asm-writer-threads", cl::Hidden, cl::init(1),
+    cl::desc("Number of threads used to print the functions of a module"));
+
 // Make virtual table appear in this compilation unit.
 AssemblyAnnotationWriter::~AssemblyAnnotationWriter() {}
 
@@ -589,6 +595,10 @@ private:
   /// asMap - The slot map for attribute sets.
   DenseMap<AttributeSet, unsigned> asMap;
   unsigned asNext;
+
+  /// ModuleSlots - If non-null, this tracker only numbers the local values of
+  /// TheFunction and forwards every module level query to ModuleSlots.
+  SlotTracker *ModuleSlots;
 public:
   /// Construct from a module.
   ///
@@ -604,6 +614,10 @@ public:
   /// within a function (even if no functions have been initialized).
   explicit SlotTracker(const Function *F,
                        bool ShouldInitializeAllMetadata = false);
+  /// Construct a tracker for the local values of \p F that shares the module
+  /// level slots of \p ModuleSlots.  ModuleSlots must already have processed
+  /// F, and is only read from, so several of these may be used concurrently.
+  SlotTracker(SlotTracker &ModuleSlots, const Function *F);
 
   /// Return the slot number of the specified value in it's type
   /// plane.  If something is not in the SlotTracker, return -1.
@@ -739,7 +753,7 @@ static SlotTracker *createSlotTracker(const Value *V) {
 SlotTracker::SlotTracker(const Module *M, bool ShouldInitializeAllMetadata)
     : TheModule(M), TheFunction(nullptr), FunctionProcessed(false),
       ShouldInitializeAllMetadata(ShouldInitializeAllMetadata), mNext(0),
-      fNext(0), mdnNext(0), asNext(0) {}
+      fNext(0), mdnNext(0), asNext(0), ModuleSlots(nullptr) {}
 
 // Function level constructor. Causes the contents of the Module and the one
 // function provided to be added to the slot table.
@@ -747,7 +761,14 @@ SlotTracker::SlotTracker(const Function *F, bool ShouldInitializeAllMetadata)
     : TheModule(F ? F->getParent() : nullptr), TheFunction(F),
       FunctionProcessed(false),
       ShouldInitializeAllMetadata(ShouldInitializeAllMetadata), mNext(0),
-      fNext(0), mdnNext(0), asNext(0) {}
+      fNext(0), mdnNext(0), asNext(0), ModuleSlots(nullptr) {}
+
+// Function local constructor. Only the values local to the function are added
+// to the slot table; everything else is looked up in ModuleSlots.
+SlotTracker::SlotTracker(SlotTracker &ModuleSlots, const Function *F)
+    : TheModule(nullptr), TheFunction(F), FunctionProcessed(false),
+      ShouldInitializeAllMetadata(false), mNext(0), fNext(0), mdnNext(0),
+      asNext(0), ModuleSlots(&ModuleSlots) {}
 
 inline void SlotTracker::initialize() {
   if (TheModule) {
@@ -805,7 +826,7 @@ void SlotTracker::processFunction() {
   fNext = 0;
 
   // Process function metadata if it wasn't hit at the module-level.
-  if (!ShouldInitializeAllMetadata)
+  if (!ShouldInitializeAllMetadata && !ModuleSlots)
     processFunctionMetadata(*TheFunction);
 
   // Add all the function arguments with no names.
@@ -825,6 +846,10 @@ void SlotTracker::processFunction() {
       if (!I.getType()->isVoidTy() && !I.hasName())
         CreateFunctionSlot(&I);
 
+      // Call attributes were already numbered by the module level tracker.
+      if (ModuleSlots)
+        continue;
+
       // We allow direct calls to any llvm.foo function here, because the
       // target may not be linked into the optimizer.
       if (const CallInst *CI = dyn_cast<CallInst>(&I)) {
@@ -888,6 +913,9 @@ void SlotTracker::purgeFunction() {
 
 /// getGlobalSlot - Get the slot number of a global value.
 int SlotTracker::getGlobalSlot(const GlobalValue *V) {
+  if (ModuleSlots)
+    return ModuleSlots->getGlobalSlot(V);
+
   // Check for uninitialized state and do lazy initialization.
   initialize();
 
@@ -898,6 +926,9 @@ int SlotTracker::getGlobalSlot(const GlobalValue *V) {
 
 /// getMetadataSlot - Get the slot number of a MDNode.
 int SlotTracker::getMetadataSlot(const MDNode *N) {
+  if (ModuleSlots)
+    return ModuleSlots->getMetadataSlot(N);
+
   // Check for uninitialized state and do lazy initialization.
   initialize();
 
@@ -919,6 +950,9 @@ int SlotTracker::getLocalSlot(const Value *V) {
 }
 
 int SlotTracker::getAttributeGroupSlot(AttributeSet AS) {
+  if (ModuleSlots)
+    return ModuleSlots->getAttributeGroupSlot(AS);
+
   // Check for uninitialized state and do lazy initialization.
   initialize();
 
@@ -2004,7 +2038,8 @@ class AssemblyWriter {
   const Module *TheModule;
   std::unique_ptr<SlotTracker> SlotTrackerStorage;
   SlotTracker &Machine;
-  TypePrinting TypePrinter;
+  TypePrinting TypePrinterStorage;
+  TypePrinting &TypePrinter;
   AssemblyAnnotationWriter *AnnotationWriter;
   SetVector<const Comdat *> Comdats;
   bool IsForDebug;
@@ -2049,6 +2084,15 @@ public:
   void printUseLists(const Function *F);
 
 private:
+  /// Construct an AssemblyWriter that prints one function of the module being
+  /// printed by \p Parent, reusing its type numbering.
+  AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
+                 AssemblyWriter &Parent, UseListOrderStack UseListOrders);
+
+  /// Print the functions of \p M on a pool of threads, each into its own
+  /// buffer, and then copy the buffers to Out in order.
+  void printFunctionsInParallel(const Module *M, unsigned Threads);
+
   /// \brief Print out metadata attachments.
   void printMetadataAttachments(
       const SmallVectorImpl<std::pair<unsigned, MDNode *>> &MDs,
@@ -2067,8 +2111,8 @@ private:
 AssemblyWriter::AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
                                const Module *M, AssemblyAnnotationWriter *AAW,
                                bool IsForDebug, bool ShouldPreserveUseListOrder)
-    : Out(o), TheModule(M), Machine(Mac), AnnotationWriter(AAW),
-      IsForDebug(IsForDebug),
+    : Out(o), TheModule(M), Machine(Mac), TypePrinter(TypePrinterStorage),
+      AnnotationWriter(AAW), IsForDebug(IsForDebug),
       ShouldPreserveUseListOrder(ShouldPreserveUseListOrder) {
   if (!TheModule)
     return;
@@ -2081,6 +2125,15 @@ AssemblyWriter::AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
       Comdats.insert(C);
 }
 
+AssemblyWriter::AssemblyWriter(formatted_raw_ostream &o, SlotTracker &Mac,
+                               AssemblyWriter &Parent,
+                               UseListOrderStack UseListOrders)
+    : Out(o), TheModule(Parent.TheModule), Machine(Mac),
+      TypePrinter(Parent.TypePrinter), AnnotationWriter(nullptr),
+      IsForDebug(Parent.IsForDebug),
+      ShouldPreserveUseListOrder(Parent.ShouldPreserveUseListOrder),
+      UseListOrders(std::move(UseListOrders)), MDNames(Parent.MDNames) {}
+
 void AssemblyWriter::writeOperand(const Value *Operand, bool PrintType) {
   if (!Operand) {
     Out << "<null operand!>";
@@ -2260,8 +2313,11 @@ void AssemblyWriter::printModule(const Module *M) {
   printUseLists(nullptr);
 
   // Output all of the functions.
-  for (const Function &F : *M)
-    printFunction(&F);
+  if (AsmWriterThreads > 1 && !AnnotationWriter)
+    printFunctionsInParallel(M, AsmWriterThreads);
+  else
+    for (const Function &F : *M)
+      printFunction(&F);
   assert(UseListOrders.empty() && "All use-lists should have been consumed");
 
   // Output all attribute groups.
@@ -2283,6 +2339,52 @@ void AssemblyWriter::printModule(const Module *M) {
   }
 }
 
+void AssemblyWriter::printFunctionsInParallel(const Module *M,
+                                              unsigned Threads) {
+  // Number the metadata and attribute groups referenced from each function in
+  // the order the serial writer would reach them, so that the workers only
+  // ever read from Machine.  Hand each function its own use-list directives.
+  std::vector<UseListOrderStack> FunctionUseLists;
+  for (const Function &F : *M) {
+    Machine.incorporateFunction(&F);
+    Machine.initialize();
+    Machine.purgeFunction();
+
+    FunctionUseLists.emplace_back();
+    UseListOrderStack &Orders = FunctionUseLists.back();
+    while (!UseListOrders.empty() && UseListOrders.back().F == &F) {
+      Orders.push_back(std::move(UseListOrders.back()));
+      UseListOrders.pop_back();
+    }
+    std::reverse(Orders.begin(), Orders.end());
+  }
+
+  // The attachment names are read from the context, so fetch them up front.
+  if (MDNames.empty())
+    M->getMDKindNames(MDNames);
+
+  std::vector<std::string> Buffers(FunctionUseLists.size());
+  {
+    ThreadPool Pool(Threads);
+    unsigned Idx = 0;
+    for (const Function &F : *M) {
+      std::string &Buffer = Buffers[Idx];
+      UseListOrderStack &Orders = FunctionUseLists[Idx++];
+      Pool.async([this, &F, &Buffer, &Orders]() {
+        raw_string_ostream OS(Buffer);
+        formatted_raw_ostream FOS(OS);
+        SlotTracker LocalMachine(Machine, &F);
+        AssemblyWriter W(FOS, LocalMachine, *this, std::move(Orders));
+        W.printFunction(&F);
+      });
+    }
+    Pool.wait();
+  }
+
+  for (const std::string &Buffer : Buffers)
+    Out << Buffer;
+}
+
 static void printMetadataIdentifier(StringRef Name,
                                     formatted_raw_ostream &Out) {
   if (Name.empty()) {
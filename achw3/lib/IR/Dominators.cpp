@@ -279,6 +279,20 @@ bool DominatorTree::isReachableFromEntry(const Use &U) const {
   return isReachableFromEntry(I->getParent());
 }
 
+void DominatorTree::applyUpdates(ArrayRef<UpdateType> Updates) {
+  Base::applyUpdates(Updates);
+  if (VerifyDomInfo)
+    verifyDomTree();
+}
+
+void DominatorTree::insertEdge(BasicBlock *From, BasicBlock *To) {
+  applyUpdates(UpdateType(Insert, From, To));
+}
+
+void DominatorTree::deleteEdge(BasicBlock *From, BasicBlock *To) {
+  applyUpdates(UpdateType(Delete, From, To));
+}
+
 void DominatorTree::verifyDomTree() const {
   Function &F = *getRoot()->getParent();
 
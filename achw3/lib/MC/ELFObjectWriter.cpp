@@ -972,21 +972,39 @@ ELFObjectWriter::createRelocationSection(MCContext &Ctx,
 // Include the debug info compression header:
 // "ZLIB" followed by 8 bytes representing the uncompressed size of the section,
 // useful for consumers to preallocate a buffer to decompress into.
-static bool
-prependCompressionHeader(uint64_t Size,
-                         SmallVectorImpl<char> &CompressedContents) {
+static void writeCompressionHeader(uint64_t Size,
+                                   SmallVectorImpl<char> &CompressedContents) {
   const StringRef Magic = "ZLIB";
-  if (Size <= Magic.size() + sizeof(Size) + CompressedContents.size())
-    return false;
   if (sys::IsLittleEndianHost)
     sys::swapByteOrder(Size);
-  CompressedContents.insert(CompressedContents.begin(),
-                            Magic.size() + sizeof(Size), 0);
-  std::copy(Magic.begin(), Magic.end(), CompressedContents.begin());
-  std::copy(reinterpret_cast<char *>(&Size),
-            reinterpret_cast<char *>(&Size + 1),
-            CompressedContents.begin() + Magic.size());
-  return true;
+  CompressedContents.append(Magic.begin(), Magic.end());
+  CompressedContents.append(reinterpret_cast<char *>(&Size),
+                            reinterpret_cast<char *>(&Size + 1));
+}
+
+namespace {
+/// A stream that compresses everything written to it, so a section can be
+/// compressed without first collecting its uncompressed contents.
+class CompressingStream : public raw_pwrite_stream {
+  zlib::Compressor &Compressor;
+  uint64_t Pos;
+
+  void write_impl(const char *Ptr, size_t Size) override {
+    Compressor.write(StringRef(Ptr, Size));
+    Pos += Size;
+  }
+
+  void pwrite_impl(const char *Ptr, size_t Size, uint64_t Offset) override {
+    llvm_unreachable("Section contents are written sequentially");
+  }
+
+  uint64_t current_pos() const override { return Pos; }
+
+public:
+  CompressingStream(zlib::Compressor &Compressor)
+      : Compressor(Compressor), Pos(0) {}
+  ~CompressingStream() override { flush(); }
+};
 }
 
 void ELFObjectWriter::writeSectionData(const MCAssembler &Asm, MCSection &Sec,
@@ -1003,24 +1021,25 @@ void ELFObjectWriter::writeSectionData(const MCAssembler &Asm, MCSection &Sec,
     return;
   }
 
-  SmallVector<char, 128> UncompressedData;
-  raw_svector_ostream VecOS(UncompressedData);
-  raw_pwrite_stream &OldStream = getStream();
-  setStream(VecOS);
-  Asm.writeSectionData(&Section, Layout);
-  setStream(OldStream);
-
+  // Compress the fragments as they are written out, so that only the
+  // compressed copy of the section is held in memory.
+  uint64_t Size = Layout.getSectionAddressSize(&Section);
   SmallVector<char, 128> CompressedContents;
-  zlib::Status Success = zlib::compress(
-      StringRef(UncompressedData.data(), UncompressedData.size()),
-      CompressedContents);
-  if (Success != zlib::StatusOK) {
-    getStream() << UncompressedData;
-    return;
+  writeCompressionHeader(Size, CompressedContents);
+  zlib::Compressor Compressor(CompressedContents);
+  {
+    CompressingStream CompressingOS(Compressor);
+    raw_pwrite_stream &OldStream = getStream();
+    setStream(CompressingOS);
+    Asm.writeSectionData(&Section, Layout);
+    setStream(OldStream);
   }
 
-  if (!prependCompressionHeader(UncompressedData.size(), CompressedContents)) {
-    getStream() << UncompressedData;
+  // Keep the section uncompressed if compression fails or does not pay off.
+  // The fragments are still around, so just write them out again.
+  if (Compressor.finish() != zlib::StatusOK ||
+      Size <= CompressedContents.size()) {
+    Asm.writeSectionData(&Section, Layout);
     return;
   }
   Asm.getContext().renameELFSection(&Section,
@@ -54,6 +54,9 @@ STATISTIC(FragmentLayouts, "Number of fragment layouts");
 STATISTIC(ObjectBytes, "Number of emitted object file bytes");
 STATISTIC(RelaxationSteps, "Number of assembler layout and relaxation steps");
 STATISTIC(RelaxedInstructions, "Number of relaxed instructions");
+STATISTIC(RelaxationCandidates,
+          "Number of fragments that may need relaxation");
+STATISTIC(RelaxationChecks, "Number of fragment relaxation checks");
 }
 }
 
@@ -642,9 +645,21 @@ void MCAssembler::layout(MCAsmLayout &Layout) {
       Frag.setLayoutOrder(FragmentIndex++);
   }
 
+  // Collect the fragments that may change size. Everything else has a fixed
+  // size, so relaxation passes never need to look at it again.
+  RelaxCandidates.assign(size(), std::vector<MCFragment *>());
+  for (MCSection &Sec : *this) {
+    std::vector<MCFragment *> &Candidates = RelaxCandidates[Sec.getOrdinal()];
+    for (MCFragment &Frag : Sec)
+      if (isRelaxationCandidate(Frag))
+        Candidates.push_back(&Frag);
+    stats::RelaxationCandidates += Candidates.size();
+  }
+
   // Layout until everything fits.
   while (layoutOnce(Layout))
     continue;
+  RelaxCandidates.clear();
 
   DEBUG_WITH_TYPE("mc-dump", {
       llvm::errs() << "assembler backend - post-relaxation\n--\n";
@@ -812,41 +827,72 @@ bool MCAssembler::relaxDwarfCallFrameFragment(MCAsmLayout &Layout,
   return OldSize != Data.size();
 }
 
+bool MCAssembler::isRelaxationCandidate(const MCFragment &F) const {
+  switch (F.getKind()) {
+  default:
+    return false;
+  case MCFragment::FT_Relaxable:
+    // Once an instruction has been relaxed to its largest form it can not
+    // grow any further.
+    return getBackend().mayNeedRelaxation(
+        cast<MCRelaxableFragment>(F).getInst());
+  case MCFragment::FT_Dwarf:
+  case MCFragment::FT_DwarfFrame:
+  case MCFragment::FT_LEB:
+    return true;
+  }
+}
+
 bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec) {
   // Holds the first fragment which needed relaxing during this layout. It will
   // remain NULL if none were relaxed.
   // When a fragment is relaxed, all the fragments following it should get
-  // invalidated because their offset is going to change.
+  // invalidated because their offset is going to change. Offsets are computed
+  // lazily, so only the fragments from there on are laid out again, and only
+  // once they are queried.
   MCFragment *FirstRelaxedFragment = nullptr;
 
-  // Attempt to relax all the fragments in the section.
-  for (MCSection::iterator I = Sec.begin(), IE = Sec.end(); I != IE; ++I) {
+  // Attempt to relax the fragments in the section that may still change size.
+  // The candidates are kept in layout order, so the first one relaxed is also
+  // the first one whose size changed.
+  std::vector<MCFragment *> &Candidates = RelaxCandidates[Sec.getOrdinal()];
+  unsigned NumLive = 0;
+  for (unsigned i = 0, e = Candidates.size(); i != e; ++i) {
+    MCFragment *F = Candidates[i];
+    ++stats::RelaxationChecks;
+
     // Check if this is a fragment that needs relaxation.
     bool RelaxedFrag = false;
-    switch(I->getKind()) {
+    switch(F->getKind()) {
     default:
-      break;
+      llvm_unreachable("Unexpected relaxation candidate");
     case MCFragment::FT_Relaxable:
       assert(!getRelaxAll() &&
              "Did not expect a MCRelaxableFragment in RelaxAll mode");
-      RelaxedFrag = relaxInstruction(Layout, *cast<MCRelaxableFragment>(I));
+      RelaxedFrag = relaxInstruction(Layout, *cast<MCRelaxableFragment>(F));
       break;
     case MCFragment::FT_Dwarf:
       RelaxedFrag = relaxDwarfLineAddr(Layout,
-                                       *cast<MCDwarfLineAddrFragment>(I));
+                                       *cast<MCDwarfLineAddrFragment>(F));
       break;
     case MCFragment::FT_DwarfFrame:
       RelaxedFrag =
         relaxDwarfCallFrameFragment(Layout,
-                                    *cast<MCDwarfCallFrameFragment>(I));
+                                    *cast<MCDwarfCallFrameFragment>(F));
       break;
     case MCFragment::FT_LEB:
-      RelaxedFrag = relaxLEB(Layout, *cast<MCLEBFragment>(I));
+      RelaxedFrag = relaxLEB(Layout, *cast<MCLEBFragment>(F));
       break;
     }
     if (RelaxedFrag && !FirstRelaxedFragment)
-      FirstRelaxedFragment = &*I;
+      FirstRelaxedFragment = F;
+
+    // Drop fragments that reached their final size.
+    if (!RelaxedFrag || isRelaxationCandidate(*F))
+      Candidates[NumLive++] = F;
   }
+  Candidates.resize(NumLive);
+
   if (FirstRelaxedFragment) {
     Layout.invalidateFragmentsFrom(FirstRelaxedFragment);
     return true;
@@ -80,6 +80,85 @@ uint32_t zlib::crc32(StringRef Buffer) {
   return ::crc32(0, (const Bytef *)Buffer.data(), Buffer.size());
 }
 
+struct zlib::Compressor::Impl {
+  z_stream Stream;
+  SmallVectorImpl<char> &Out;
+  Status Res;
+  bool Initialized;
+
+  Impl(SmallVectorImpl<char> &Out)
+      : Out(Out), Res(StatusOK), Initialized(false) {}
+
+  void deflate(StringRef Input, int Flush);
+};
+
+void zlib::Compressor::Impl::deflate(StringRef Input, int Flush) {
+  if (Res != StatusOK)
+    return;
+  // zlib does not write through next_in, it is only non-const so that it can
+  // be built without ZLIB_CONST.
+  Stream.next_in = const_cast<Bytef *>((const Bytef *)Input.data());
+  Stream.avail_in = Input.size();
+
+  // Let zlib fill fixed-size chunks at the end of the output buffer until it
+  // stops running out of room.
+  const size_t ChunkSize = 16384;
+  int ReturnValue;
+  do {
+    size_t OldSize = Out.size();
+    Out.resize(OldSize + ChunkSize);
+    Stream.next_out = (Bytef *)Out.data() + OldSize;
+    Stream.avail_out = ChunkSize;
+    ReturnValue = ::deflate(&Stream, Flush);
+    size_t Produced = ChunkSize - Stream.avail_out;
+    // Tell MemorySanitizer that zlib output buffer is fully initialized.
+    // This avoids a false report when running LLVM with uninstrumented ZLib.
+    __msan_unpoison(Out.data() + OldSize, Produced);
+    Out.resize(OldSize + Produced);
+  } while (ReturnValue == Z_OK && Stream.avail_out == 0);
+
+  // Z_BUF_ERROR only means that no progress was possible, which is expected
+  // once all of the input has been consumed.
+  if (ReturnValue != Z_OK && ReturnValue != Z_BUF_ERROR &&
+      ReturnValue != Z_STREAM_END)
+    Res = encodeZlibReturnValue(ReturnValue);
+  else if (Flush == Z_FINISH && ReturnValue != Z_STREAM_END)
+    Res = StatusBufferTooShort;
+}
+
+zlib::Compressor::Compressor(SmallVectorImpl<char> &CompressedBuffer,
+                             CompressionLevel Level)
+    : I(new Impl(CompressedBuffer)) {
+  I->Stream.zalloc = Z_NULL;
+  I->Stream.zfree = Z_NULL;
+  I->Stream.opaque = Z_NULL;
+  int ReturnValue =
+      ::deflateInit(&I->Stream, encodeZlibCompressionLevel(Level));
+  I->Initialized = ReturnValue == Z_OK;
+  I->Res = encodeZlibReturnValue(ReturnValue);
+}
+
+zlib::Compressor::~Compressor() {
+  // The stream only owns memory if deflateInit() succeeded.
+  if (I->Initialized)
+    ::deflateEnd(&I->Stream);
+}
+
+void zlib::Compressor::write(StringRef InputBuffer) {
+  // avail_in is only 32 bits wide.
+  const size_t MaxInput = 1U << 30;
+  while (InputBuffer.size() > MaxInput) {
+    I->deflate(InputBuffer.substr(0, MaxInput), Z_NO_FLUSH);
+    InputBuffer = InputBuffer.drop_front(MaxInput);
+  }
+  I->deflate(InputBuffer, Z_NO_FLUSH);
+}
+
+zlib::Status zlib::Compressor::finish() {
+  I->deflate(StringRef(), Z_FINISH);
+  return I->Res;
+}
+
 #else
 bool zlib::isAvailable() { return false; }
 zlib::Status zlib::compress(StringRef InputBuffer,
@@ -95,5 +174,12 @@ zlib::Status zlib::uncompress(StringRef InputBuffer,
 uint32_t zlib::crc32(StringRef Buffer) {
   llvm_unreachable("zlib::crc32 is unavailable");
 }
+
+struct zlib::Compressor::Impl {};
+zlib::Compressor::Compressor(SmallVectorImpl<char> &CompressedBuffer,
+                             CompressionLevel Level) {}
+zlib::Compressor::~Compressor() {}
+void zlib::Compressor::write(StringRef InputBuffer) {}
+zlib::Status zlib::Compressor::finish() { return zlib::StatusUnsupported; }
 #endif
 
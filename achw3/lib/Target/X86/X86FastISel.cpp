@@ -415,6 +415,24 @@ bool X86FastISel::X86FastEmitLoad(EVT VT, X86AddressMode &AM,
       Opc = Subtarget->hasAVX() ? X86::VMOVDQUrm : X86::MOVDQUrm;
     RC  = &X86::VR128RegClass;
     break;
+  case MVT::v8f32:
+    assert(Subtarget->hasAVX());
+    Opc = (Alignment >= 32) ? X86::VMOVAPSYrm : X86::VMOVUPSYrm;
+    RC  = &X86::VR256RegClass;
+    break;
+  case MVT::v4f64:
+    assert(Subtarget->hasAVX());
+    Opc = (Alignment >= 32) ? X86::VMOVAPDYrm : X86::VMOVUPDYrm;
+    RC  = &X86::VR256RegClass;
+    break;
+  case MVT::v8i32:
+  case MVT::v4i64:
+  case MVT::v16i16:
+  case MVT::v32i8:
+    assert(Subtarget->hasAVX());
+    Opc = (Alignment >= 32) ? X86::VMOVDQAYrm : X86::VMOVDQUYrm;
+    RC  = &X86::VR256RegClass;
+    break;
   }
 
   ResultReg = createResultReg(RC);
@@ -509,6 +527,30 @@ bool X86FastISel::X86FastEmitStore(EVT VT, unsigned ValReg, bool ValIsKill,
     } else
       Opc = Subtarget->hasAVX() ? X86::VMOVDQUmr : X86::MOVDQUmr;
     break;
+  case MVT::v8f32:
+    assert(HasAVX);
+    if (Aligned)
+      Opc = IsNonTemporal ? X86::VMOVNTPSYmr : X86::VMOVAPSYmr;
+    else
+      Opc = X86::VMOVUPSYmr;
+    break;
+  case MVT::v4f64:
+    assert(HasAVX);
+    if (Aligned)
+      Opc = IsNonTemporal ? X86::VMOVNTPDYmr : X86::VMOVAPDYmr;
+    else
+      Opc = X86::VMOVUPDYmr;
+    break;
+  case MVT::v8i32:
+  case MVT::v4i64:
+  case MVT::v16i16:
+  case MVT::v32i8:
+    assert(HasAVX);
+    if (Aligned)
+      Opc = IsNonTemporal ? X86::VMOVNTDQYmr : X86::VMOVDQAYmr;
+    else
+      Opc = X86::VMOVDQUYmr;
+    break;
   }
 
   MachineInstrBuilder MIB =
@@ -1997,9 +2039,25 @@ bool X86FastISel::X86FastEmitPseudoSelect(MVT RetVT, const Instruction *I) {
   case MVT::i32: Opc = X86::CMOV_GR32; break;
   case MVT::f32: Opc = X86::CMOV_FR32; break;
   case MVT::f64: Opc = X86::CMOV_FR64; break;
+  case MVT::v4f32: Opc = X86::CMOV_V4F32; break;
+  case MVT::v2f64: Opc = X86::CMOV_V2F64; break;
+  case MVT::v16i8:
+  case MVT::v8i16:
+  case MVT::v4i32:
+  case MVT::v2i64: Opc = X86::CMOV_V2I64; break;
+  case MVT::v8f32: Opc = X86::CMOV_V8F32; break;
+  case MVT::v4f64: Opc = X86::CMOV_V4F64; break;
+  case MVT::v32i8:
+  case MVT::v16i16:
+  case MVT::v8i32:
+  case MVT::v4i64: Opc = X86::CMOV_V4I64; break;
   }
 
   const Value *Cond = I->getOperand(0);
+  // A vector select picks lanes individually; only a scalar condition maps
+  // onto the pseudo CMOVs.
+  if (!Cond->getType()->isIntegerTy(1))
+    return false;
   X86::CondCode CC = X86::COND_NE;
 
   // Optimize conditions coming from a compare if both instructions are in the
@@ -2042,7 +2100,15 @@ bool X86FastISel::X86FastEmitPseudoSelect(MVT RetVT, const Instruction *I) {
   if (!LHSReg || !RHSReg)
     return false;
 
-  const TargetRegisterClass *RC = TLI.getRegClassFor(RetVT);
+  // The vector pseudos are defined on the non-EVEX register classes, which
+  // may be narrower than the legal class for the type when AVX-512 is on.
+  const TargetRegisterClass *RC;
+  if (RetVT.is128BitVector())
+    RC = &X86::VR128RegClass;
+  else if (RetVT.is256BitVector())
+    RC = &X86::VR256RegClass;
+  else
+    RC = TLI.getRegClassFor(RetVT);
 
   unsigned ResultReg =
     fastEmitInst_rri(Opc, RC, RHSReg, RHSIsKill, LHSReg, LHSIsKill, CC);
@@ -2413,6 +2479,21 @@ bool X86FastISel::fastLowerIntrinsicCall(const IntrinsicInst *II) {
 
     return lowerCallTo(II, "memcpy", II->getNumArgOperands() - 2);
   }
+  case Intrinsic::memmove: {
+    const MemMoveInst *MMI = cast<MemMoveInst>(II);
+    // The source and destination may overlap, so always call the library.
+    if (MMI->isVolatile())
+      return false;
+
+    unsigned SizeWidth = Subtarget->is64Bit() ? 64 : 32;
+    if (!MMI->getLength()->getType()->isIntegerTy(SizeWidth))
+      return false;
+
+    if (MMI->getSourceAddressSpace() > 255 || MMI->getDestAddressSpace() > 255)
+      return false;
+
+    return lowerCallTo(II, "memmove", II->getNumArgOperands() - 2);
+  }
   case Intrinsic::memset: {
     const MemSetInst *MSI = cast<MemSetInst>(II);
 
@@ -2853,6 +2934,13 @@ bool X86FastISel::fastLowerCall(CallLoweringInfo &CLI) {
   case CallingConv::X86_64_Win64:
   case CallingConv::X86_64_SysV:
     break;
+  // These only change the set of preserved registers, which comes from the
+  // regmask below; arguments are passed as for the C convention.
+  case CallingConv::PreserveMost:
+  case CallingConv::PreserveAll:
+    if (!Is64Bit)
+      return false;
+    break;
   }
 
   // Allow SelectionDAG isel to handle tail calls.
@@ -0,0 +1,369 @@
+//===- HotColdSplitting.cpp - Outline cold regions of profiled functions --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass uses profile data to find the parts of a function that are never
+// (or almost never) executed, and outlines them into separate functions. The
+// outlined functions are marked cold and, on ELF targets, placed in
+// .text.unlikely, so the hot text of the original function shrinks.
+//
+// A region is a cold block together with the cold blocks it dominates that
+// are only entered from inside the region. Blocks involved in exception
+// handling are left alone: landing pads and funclets must stay in the
+// function whose code unwinds to them.
+//
+// Outlined functions get an artificial subprogram of their own, and the
+// debug locations of the outlined instructions are moved into it, so line
+// tables still cover the outlined code. The variables of the original
+// function are not described in the outlined code.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BlockFrequencyInfoImpl.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/CodeExtractor.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "hotcoldsplit"
+
+STATISTIC(NumColdRegions, "Number of cold regions outlined");
+STATISTIC(NumColdBlocks, "Number of cold blocks outlined");
+
+static cl::opt<unsigned> ColdCountThreshold(
+    "hot-cold-split-max-count", cl::init(0), cl::Hidden,
+    cl::desc("Treat blocks whose estimated profile count is at most this as "
+             "cold"));
+
+static cl::opt<unsigned> MinRegionSize(
+    "hot-cold-split-min-size", cl::init(4), cl::Hidden,
+    cl::desc("Minimum number of instructions in an outlined cold region"));
+
+namespace {
+struct HotColdSplitting : public ModulePass {
+  static char ID; // Pass identification, replacement for typeid
+  HotColdSplitting() : ModulePass(ID) {
+    initializeHotColdSplittingPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  bool splitFunction(Function &F, bool IsELF);
+};
+}
+
+char HotColdSplitting::ID = 0;
+INITIALIZE_PASS(HotColdSplitting, "hot-cold-split",
+                "Outline cold regions of profiled functions", false, false)
+
+ModulePass *llvm::createHotColdSplittingPass() {
+  return new HotColdSplitting();
+}
+
+/// Return true if \p BB may be moved into an outlined function.
+static bool mayOutline(const BasicBlock &BB) {
+  if (BB.isEHPad())
+    return false;
+
+  // Returning from the region would return from the outlined function, and
+  // unwinding edges must stay next to their pads.
+  const TerminatorInst *TI = BB.getTerminator();
+  if (isa<ReturnInst>(TI) || isa<InvokeInst>(TI) || isa<ResumeInst>(TI) ||
+      isa<CleanupReturnInst>(TI) || isa<CatchReturnInst>(TI))
+    return false;
+
+  for (const Instruction &I : BB) {
+    if (isa<AllocaInst>(I))
+      return false;
+    const CallInst *CI = dyn_cast<CallInst>(&I);
+    if (!CI)
+      continue;
+    // Funclet bundles tie a call to its EH pad, a musttail call to the return
+    // that follows it, and setjmp to the frame of its caller.
+    if (CI->hasOperandBundles() || CI->isMustTailCall() ||
+        CI->canReturnTwice())
+      return false;
+    if (const IntrinsicInst *II = dyn_cast<IntrinsicInst>(CI))
+      switch (II->getIntrinsicID()) {
+      case Intrinsic::vastart:
+      case Intrinsic::eh_typeid_for:
+      case Intrinsic::localescape:
+        return false;
+      default:
+        break;
+      }
+  }
+  return true;
+}
+
+/// Return the profile count of \p BB, scaled from the function entry count
+/// by the block frequency.
+static uint64_t getBlockCount(const BlockFrequencyInfo &BFI,
+                              const BasicBlock *BB, uint64_t EntryCount) {
+  APInt Count(128, EntryCount);
+  Count *= APInt(128, BFI.getBlockFreq(BB).getFrequency());
+  Count = Count.udiv(APInt(128, BFI.getEntryFreq()));
+  return Count.getLimitedValue();
+}
+
+/// Give \p Outlined the function attributes of \p F that affect how code is
+/// generated for it, such as target features and sanitizers.
+static void copyCodeGenAttributes(const Function &F, Function &Outlined) {
+  AttributeSet FnAttrs = F.getAttributes().getFnAttributes();
+  for (unsigned Slot = 0, E = FnAttrs.getNumSlots(); Slot != E; ++Slot)
+    for (Attribute A : make_range(FnAttrs.begin(Slot), FnAttrs.end(Slot))) {
+      if (A.isStringAttribute()) {
+        Outlined.addFnAttr(A.getKindAsString(), A.getValueAsString());
+        continue;
+      }
+      switch (A.getKindAsEnum()) {
+      case Attribute::NoImplicitFloat:
+      case Attribute::NoRedZone:
+      case Attribute::SafeStack:
+      case Attribute::SanitizeAddress:
+      case Attribute::SanitizeMemory:
+      case Attribute::SanitizeThread:
+      case Attribute::StackProtect:
+      case Attribute::StackProtectReq:
+      case Attribute::StackProtectStrong:
+      case Attribute::UWTable:
+        Outlined.addFnAttr(A.getKindAsEnum());
+        break;
+      default:
+        break;
+      }
+    }
+}
+
+/// CodeExtractor can only rewrite a PHI outside of \p Region that has a single
+/// incoming block in it. Give every block with PHIs that is reached from more
+/// than one block of the region a new predecessor in the region that merges
+/// those edges.
+static void splitExitPHIs(SetVector<BasicBlock *> &Region) {
+  SmallSetVector<BasicBlock *, 4> Exits;
+  for (BasicBlock *BB : Region)
+    for (BasicBlock *Succ : successors(BB))
+      if (!Region.count(Succ) && isa<PHINode>(Succ->begin()))
+        Exits.insert(Succ);
+
+  for (BasicBlock *Exit : Exits) {
+    SmallSetVector<BasicBlock *, 4> Preds;
+    for (BasicBlock *Pred : predecessors(Exit))
+      if (Region.count(Pred))
+        Preds.insert(Pred);
+    if (Preds.size() > 1)
+      Region.insert(SplitBlockPredecessors(Exit, Preds.getArrayRef(), ".cold"));
+  }
+}
+
+/// Return \p Loc with the outermost scope, which is in the function the code
+/// was outlined from, replaced by \p SP.
+static DILocation *moveToSubprogram(DILocation *Loc, DISubprogram *SP) {
+  if (DILocation *InlinedAt = Loc->getInlinedAt())
+    return DILocation::get(Loc->getContext(), Loc->getLine(),
+                           Loc->getColumn(), Loc->getScope(),
+                           moveToSubprogram(InlinedAt, SP));
+  return DILocation::get(Loc->getContext(), Loc->getLine(), Loc->getColumn(),
+                         SP);
+}
+
+/// Give \p Outlined, which was outlined from \p F at \p DL, an artificial
+/// subprogram in the compile unit of \p F, and move the debug locations of its
+/// instructions into it.
+static void addOutlinedSubprogram(Function &F, Function &Outlined,
+                                  DebugLoc DL) {
+  DISubprogram *SP = F.getSubprogram();
+  if (!SP)
+    return;
+
+  DICompileUnit *CU = nullptr;
+  SmallVector<Metadata *, 16> SPs;
+  if (NamedMDNode *CUNodes = F.getParent()->getNamedMetadata("llvm.dbg.cu"))
+    for (MDNode *N : CUNodes->operands()) {
+      auto *Unit = cast<DICompileUnit>(N);
+      SPs.clear();
+      for (DISubprogram *UnitSP : Unit->getSubprograms()) {
+        SPs.push_back(UnitSP);
+        if (UnitSP == SP)
+          CU = Unit;
+      }
+      if (CU)
+        break;
+    }
+  if (!CU)
+    return;
+
+  LLVMContext &Ctx = F.getContext();
+  Metadata *Types[] = {nullptr};
+  unsigned Line = DL ? DL.getLine() : SP->getLine();
+  DISubprogram *NewSP = DISubprogram::getDistinct(
+      Ctx, DIScopeRef::get(SP->getFile()), Outlined.getName(),
+      Outlined.getName(), SP->getFile(), Line,
+      DISubroutineType::get(Ctx, 0, MDTuple::get(Ctx, Types)),
+      /*IsLocalToUnit=*/true, /*IsDefinition=*/true, Line, nullptr, 0, 0,
+      DINode::FlagArtificial, SP->isOptimized());
+  SPs.push_back(NewSP);
+  CU->replaceSubprograms(MDTuple::get(Ctx, SPs));
+  Outlined.setSubprogram(NewSP);
+
+  // The variables of F are scoped to its subprogram, so their intrinsics
+  // cannot move along.
+  for (BasicBlock &BB : Outlined)
+    for (auto II = BB.begin(), IE = BB.end(); II != IE;) {
+      Instruction &I = *II++;
+      if (isa<DbgInfoIntrinsic>(I)) {
+        I.eraseFromParent();
+        continue;
+      }
+      if (DILocation *Loc = I.getDebugLoc())
+        I.setDebugLoc(moveToSubprogram(Loc, NewSP));
+    }
+
+  // The call to the outlined code stands in for it in F.
+  for (User *U : Outlined.users())
+    cast<Instruction>(U)->setDebugLoc(DL);
+}
+
+bool HotColdSplitting::splitFunction(Function &F, bool IsELF) {
+  // Without an entry count there is no profile to tell cold code apart, and a
+  // function that never runs is cold as a whole.
+  Optional<uint64_t> EntryCount = F.getEntryCount();
+  if (!EntryCount || !*EntryCount)
+    return false;
+  if (F.hasFnAttribute(Attribute::Cold) || F.hasFnAttribute(Attribute::Naked))
+    return false;
+
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  BranchProbabilityInfo BPI(F, LI);
+  BlockFrequencyInfo BFI(F, BPI, LI);
+
+  auto IsCold = [&](BasicBlock *BB) {
+    return getBlockCount(BFI, BB, *EntryCount) <= ColdCountThreshold &&
+           mayOutline(*BB);
+  };
+
+  // Visit blocks in reverse post-order, so the outermost cold block of each
+  // region is seen first.
+  SmallPtrSet<BasicBlock *, 16> Taken;
+  SmallVector<SetVector<BasicBlock *>, 4> Regions;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT) {
+    if (BB == &F.getEntryBlock() || Taken.count(BB) || !IsCold(BB))
+      continue;
+
+    // Start with the cold part of BB's dominator subtree.
+    SetVector<BasicBlock *> Region;
+    SmallVector<DomTreeNode *, 8> Worklist(1, DT.getNode(BB));
+    while (!Worklist.empty()) {
+      DomTreeNode *N = Worklist.pop_back_val();
+      Region.insert(N->getBlock());
+      for (DomTreeNode *Child : *N)
+        if (!Taken.count(Child->getBlock()) && IsCold(Child->getBlock()))
+          Worklist.push_back(Child);
+    }
+
+    // Only the first block may be entered from outside the region. Dropping
+    // a block can strand its successors, so repeat until nothing changes.
+    for (;;) {
+      SmallVector<BasicBlock *, 4> Stranded;
+      for (BasicBlock *RB : make_range(std::next(Region.begin()), Region.end()))
+        for (BasicBlock *Pred : predecessors(RB))
+          if (!Region.count(Pred)) {
+            Stranded.push_back(RB);
+            break;
+          }
+      if (Stranded.empty())
+        break;
+      for (BasicBlock *RB : Stranded)
+        Region.remove(RB);
+    }
+
+    unsigned Size = 0;
+    for (BasicBlock *RB : Region)
+      for (Instruction &I : *RB)
+        if (!isa<DbgInfoIntrinsic>(I))
+          ++Size;
+    if (Size < MinRegionSize)
+      continue;
+
+    Taken.insert(Region.begin(), Region.end());
+    Regions.push_back(std::move(Region));
+  }
+
+  bool Changed = false;
+  for (SetVector<BasicBlock *> &Region : Regions) {
+    BasicBlock *Header = Region[0];
+    DebugLoc DL = Header->getFirstNonPHI()->getDebugLoc();
+    unsigned NumBlocks = Region.size();
+    splitExitPHIs(Region);
+
+    // Regions are disjoint and single-entry, so extracting one leaves the
+    // others intact; the dominator tree is not kept up to date, though.
+    Function *Outlined = CodeExtractor(Region.getArrayRef()).extractCodeRegion();
+    if (!Outlined)
+      continue;
+
+    Outlined->addFnAttr(Attribute::Cold);
+    Outlined->addFnAttr(Attribute::NoInline);
+    Outlined->addFnAttr(Attribute::MinSize);
+    copyCodeGenAttributes(F, *Outlined);
+    addOutlinedSubprogram(F, *Outlined, DL);
+    if (F.hasSection())
+      Outlined->setSection(F.getSection());
+    else if (IsELF)
+      Outlined->setSection(".text.unlikely");
+
+    DEBUG(dbgs() << "HotColdSplit: outlined " << NumBlocks
+                 << " blocks of " << F.getName() << " into "
+                 << Outlined->getName() << "\n");
+    emitOptimizationRemark(F.getContext(), DEBUG_TYPE, F, DL,
+                           "outlined " + Twine(NumBlocks) +
+                               " cold blocks into " + Outlined->getName());
+    ++NumColdRegions;
+    NumColdBlocks += NumBlocks;
+    Changed = true;
+  }
+  return Changed;
+}
+
+bool HotColdSplitting::runOnModule(Module &M) {
+  bool IsELF = Triple(M.getTargetTriple()).isOSBinFormatELF();
+
+  // Outlining adds functions to the module; only visit the original ones.
+  SmallVector<Function *, 16> Worklist;
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      Worklist.push_back(&F);
+
+  bool Changed = false;
+  for (Function *F : Worklist)
+    Changed |= splitFunction(*F, IsELF);
+  return Changed;
+}
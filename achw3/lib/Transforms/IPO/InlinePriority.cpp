@@ -0,0 +1,376 @@
+//===- InlinePriority.cpp - Profile-guided module-wide inliner ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements an inliner that, instead of walking the call graph
+// bottom-up and deciding every call site on its own, ranks all call sites in
+// the module by how often they run relative to how much code inlining them
+// adds, and inlines them in that order until a module-wide size budget is
+// spent. Hot call sites deep in the call graph are thus no longer crowded out
+// by cold ones that happened to be visited first.
+//
+// Call site counts come from the function entry counts recorded by
+// instrumentation or sample profiles, scaled by the block frequencies of the
+// caller. Without profile data every function is assumed to be entered once.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ScaledNumber.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <queue>
+using namespace llvm;
+
+#define DEBUG_TYPE "priority-inline"
+
+STATISTIC(NumInlined, "Number of call sites inlined");
+STATISTIC(NumRequeued, "Number of call sites ranked again after their callee "
+                       "changed");
+STATISTIC(NumOverBudget, "Number of call sites skipped for not fitting the "
+                         "budget");
+STATISTIC(NumDeleted, "Number of functions deleted because all callers found");
+
+static cl::opt<unsigned> SizeBudgetPercent(
+    "priority-inline-budget", cl::Hidden, cl::init(20),
+    cl::desc("Let the priority inliner grow the module by this percentage "
+             "of its instruction count, not counting always-inline calls"));
+
+static cl::opt<unsigned> MinSizeBudget(
+    "priority-inline-min-budget", cl::Hidden, cl::init(100),
+    cl::desc("Let the priority inliner grow the module by at least this many "
+             "instructions, however small it is"));
+
+static cl::opt<int> MaxCallSiteCost(
+    "priority-inline-max-cost", cl::Hidden, cl::init(1000),
+    cl::desc("Never inline a single call site whose inline cost is above "
+             "this, however hot it is"));
+
+namespace {
+
+typedef ScaledNumber<uint64_t> Scaled64;
+
+/// A call site waiting to be inlined, ordered by its priority.
+struct CandidateCall {
+  WeakVH Call;
+  Scaled64 Count;
+  Scaled64 Priority;
+
+  CandidateCall(Instruction *I, Scaled64 Count, Scaled64 Priority)
+      : Call(I), Count(Count), Priority(Priority) {}
+
+  bool operator<(const CandidateCall &RHS) const {
+    return Priority < RHS.Priority;
+  }
+};
+
+/// The calls from one function to another, summed over all call sites.
+struct CallSummary {
+  Scaled64 Count;
+  unsigned NumSites;
+
+  CallSummary() : NumSites(0) {}
+};
+
+/// \brief Module-wide inliner driven by a priority queue of call sites.
+class PriorityInliner : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+
+  PriorityInliner() : ModulePass(ID) {
+    initializePriorityInlinerPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override;
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<AssumptionCacheTracker>();
+    AU.addRequired<BlockFrequencyInfoWrapperPass>();
+    AU.addRequired<CallGraphWrapperPass>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
+    AU.addPreserved<CallGraphWrapperPass>();
+  }
+
+private:
+  /// Rank \p CS, which runs \p Count times, and queue it if it may be inlined.
+  void enqueue(CallSite CS, Scaled64 Count);
+
+  /// \returns the cost of inlining \p CS.
+  InlineCost getCost(CallSite CS);
+
+  /// \returns the priority of \p CS, whose inline cost is \p IC, when it runs
+  /// \p Count times, or None if it should not be inlined at all.
+  Optional<Scaled64> getPriority(CallSite CS, const InlineCost &IC,
+                                 Scaled64 Count);
+
+  /// Move the calls made by \p Callee into \p Caller, which calls it
+  /// \p Count times, in the call summaries.
+  void inheritCalls(Function *Caller, Function *Callee, Scaled64 Count);
+
+  /// Delete the functions that have no callers left after inlining.
+  void removeDeadFunctions(CallGraph &CG);
+
+  AssumptionCacheTracker *ACT;
+  std::priority_queue<CandidateCall> Queue;
+  DenseMap<Function *, Scaled64> EntryCounts;
+  /// The calls each function makes, by callee.
+  DenseMap<Function *, SmallDenseMap<Function *, CallSummary, 4>> Calls;
+  SmallSetVector<Function *, 16> InlinedCallees;
+};
+
+} // end anonymous namespace
+
+char PriorityInliner::ID = 0;
+INITIALIZE_PASS_BEGIN(PriorityInliner, "priority-inline",
+                      "Profile-guided priority inliner", false, false)
+INITIALIZE_PASS_DEPENDENCY(AssumptionCacheTracker)
+INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(CallGraphWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
+INITIALIZE_PASS_END(PriorityInliner, "priority-inline",
+                    "Profile-guided priority inliner", false, false)
+
+ModulePass *llvm::createPriorityInlinerPass() { return new PriorityInliner(); }
+
+static unsigned getInstructionCount(const Function &F) {
+  unsigned Count = 0;
+  for (const BasicBlock &BB : F)
+    for (const Instruction &I : BB)
+      if (!isa<DbgInfoIntrinsic>(I))
+        ++Count;
+  return Count;
+}
+
+/// \returns the directly called function of \p CS if it has a body we could
+/// inline, or null otherwise.
+static Function *getInlinableCallee(CallSite CS) {
+  Function *Callee = CS.getCalledFunction();
+  if (!Callee || Callee->isDeclaration() || Callee == CS.getCaller())
+    return nullptr;
+  return Callee;
+}
+
+InlineCost PriorityInliner::getCost(CallSite CS) {
+  Function *Callee = CS.getCalledFunction();
+  TargetTransformInfo &TTI =
+      getAnalysis<TargetTransformInfoWrapperPass>().getTTI(*Callee);
+  return getInlineCost(CS, MaxCallSiteCost, TTI, ACT);
+}
+
+Optional<Scaled64> PriorityInliner::getPriority(CallSite CS,
+                                                const InlineCost &IC,
+                                                Scaled64 Count) {
+  if (IC.isAlways())
+    return Scaled64::getLargest();
+  if (!IC)
+    return None;
+
+  // Calls that were never executed in the profile are left alone.
+  if (Count.isZero() && CS.getCaller()->getEntryCount())
+    return None;
+
+  // The benefit of inlining grows with the number of times the call is made,
+  // the cost with the amount of code that is added. A callee that simplifies
+  // away entirely is as cheap as a single instruction.
+  int Size = std::max(IC.getCost(), 0) + InlineConstants::InstrCost;
+  return Count / Scaled64(Size, 0);
+}
+
+void PriorityInliner::enqueue(CallSite CS, Scaled64 Count) {
+  if (!getInlinableCallee(CS))
+    return;
+  if (Optional<Scaled64> Priority = getPriority(CS, getCost(CS), Count)) {
+    DEBUG(dbgs() << "PI: Queueing call to " << CS.getCalledFunction()->getName()
+                 << " in " << CS.getCaller()->getName() << " with count "
+                 << Count << " and priority " << *Priority << "\n");
+    Queue.push(CandidateCall(CS.getInstruction(), Count, *Priority));
+  }
+}
+
+void PriorityInliner::inheritCalls(Function *Caller, Function *Callee,
+                                   Scaled64 Count) {
+  Scaled64 CalleeEntry = EntryCounts.lookup(Callee);
+  // Copy the callee's calls first, creating the caller's entry may move them.
+  SmallDenseMap<Function *, CallSummary, 4> CalleeCalls = Calls[Callee];
+  auto &CallerCalls = Calls[Caller];
+
+  CallSummary &Direct = CallerCalls[Callee];
+  Direct.Count = Direct.Count > Count ? Direct.Count - Count
+                                      : Scaled64::getZero();
+  if (Direct.NumSites)
+    --Direct.NumSites;
+
+  for (auto &Entry : CalleeCalls) {
+    CallSummary &Inherited = CallerCalls[Entry.first];
+    if (!CalleeEntry.isZero())
+      Inherited.Count += Entry.second.Count * Count / CalleeEntry;
+    Inherited.NumSites += Entry.second.NumSites;
+  }
+}
+
+void PriorityInliner::removeDeadFunctions(CallGraph &CG) {
+  for (Function *F : InlinedCallees) {
+    F->removeDeadConstantUsers();
+    if (!F->isDefTriviallyDead())
+      continue;
+
+    // Dropping a function from a COMDAT is only safe if nobody outside this
+    // module can refer to the other members.
+    if (!F->hasLocalLinkage() && F->hasComdat())
+      continue;
+
+    CallGraphNode *CGN = CG[F];
+    CGN->removeAllCalledFunctions();
+    CG.getExternalCallingNode()->removeAnyCallEdgeTo(CGN);
+    delete CG.removeFunctionFromModule(CGN);
+    ++NumDeleted;
+  }
+}
+
+bool PriorityInliner::runOnModule(Module &M) {
+  CallGraph &CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
+  ACT = &getAnalysis<AssumptionCacheTracker>();
+  EntryCounts.clear();
+  Calls.clear();
+  InlinedCallees.clear();
+
+  // Count the calls made by every function and queue the ones worth
+  // inlining, and measure the module to set the budget.
+  uint64_t ModuleSize = 0;
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    ModuleSize += getInstructionCount(F);
+
+    Optional<uint64_t> ProfileCount = F.getEntryCount();
+    Scaled64 Entry(ProfileCount ? *ProfileCount : 1, 0);
+    EntryCounts[&F] = Entry;
+
+    BlockFrequencyInfo &BFI =
+        getAnalysis<BlockFrequencyInfoWrapperPass>(F).getBFI();
+    Scaled64 EntryFreq(BFI.getEntryFreq(), 0);
+    for (BasicBlock &BB : F) {
+      Scaled64 Count =
+          Entry * Scaled64(BFI.getBlockFreq(&BB).getFrequency(), 0) / EntryFreq;
+      for (Instruction &I : BB) {
+        CallSite CS(&I);
+        if (!CS || isa<IntrinsicInst>(I))
+          continue;
+        if (Function *Callee = getInlinableCallee(CS)) {
+          CallSummary &Summary = Calls[&F][Callee];
+          Summary.Count += Count;
+          ++Summary.NumSites;
+          enqueue(CS, Count);
+        }
+      }
+    }
+  }
+
+  // A percentage of a small module leaves no room for even the smallest
+  // callee, so the budget has a floor.
+  uint64_t Budget = std::max<uint64_t>(ModuleSize * SizeBudgetPercent / 100,
+                                       MinSizeBudget);
+  DEBUG(dbgs() << "PI: Module has " << ModuleSize << " instructions, budget "
+               << Budget << "\n");
+
+  bool Changed = false;
+  InlineFunctionInfo IFI(&CG, ACT);
+  while (!Queue.empty()) {
+    CandidateCall Candidate = Queue.top();
+    Queue.pop();
+
+    // The call may have been deleted, or inlined along with its caller.
+    Instruction *I = cast_or_null<Instruction>(Candidate.Call);
+    if (!I)
+      continue;
+    CallSite CS(I);
+    Function *Caller = CS.getCaller();
+    Function *Callee = getInlinableCallee(CS);
+    if (!Callee)
+      continue;
+
+    // Inlining elsewhere may have changed the callee since the call was
+    // ranked. If it is now worth less than the next call in line, rank it
+    // again.
+    InlineCost IC = getCost(CS);
+    Optional<Scaled64> Priority = getPriority(CS, IC, Candidate.Count);
+    if (!Priority)
+      continue;
+    if (*Priority < Candidate.Priority && !Queue.empty() &&
+        *Priority < Queue.top().Priority) {
+      ++NumRequeued;
+      Queue.push(CandidateCall(I, Candidate.Count, *Priority));
+      continue;
+    }
+
+    // Calls are charged for the code they add, the body of the callee less the
+    // call it replaces. Always-inline calls are inlined whatever the budget
+    // says and are not charged to it. Other calls that do not fit are
+    // skipped, a smaller callee further down the queue may still fit.
+    unsigned Growth = 0;
+    if (!IC.isAlways())
+      Growth = std::max(getInstructionCount(*Callee), 1U) - 1;
+    if (Growth > Budget) {
+      DEBUG(dbgs() << "PI: Call to " << Callee->getName() << " in "
+                   << Caller->getName() << " does not fit the budget\n");
+      ++NumOverBudget;
+      continue;
+    }
+
+    DebugLoc DLoc = I->getDebugLoc();
+    IFI.reset();
+    if (!InlineFunction(CS, IFI))
+      continue;
+    AttributeFuncs::mergeAttributesForInlining(*Caller, *Callee);
+    Budget -= Growth;
+    ++NumInlined;
+    Changed = true;
+    InlinedCallees.insert(Callee);
+    emitOptimizationRemark(Caller->getContext(), DEBUG_TYPE, *Caller, DLoc,
+                           Twine(Callee->getName() + " inlined into " +
+                                 Caller->getName()));
+
+    // The calls the callee makes are now made by the caller, as often as
+    // the callee made them per call.
+    inheritCalls(Caller, Callee, Candidate.Count);
+    for (WeakVH &NewCall : IFI.InlinedCalls) {
+      Instruction *NewI = cast_or_null<Instruction>(NewCall);
+      if (!NewI)
+        continue;
+      CallSite NewCS(NewI);
+      Function *NewCallee = getInlinableCallee(NewCS);
+      if (!NewCallee)
+        continue;
+      CallSummary Summary = Calls[Caller].lookup(NewCallee);
+      Scaled64 Count = Summary.NumSites
+                           ? Summary.Count / Scaled64(Summary.NumSites, 0)
+                           : Scaled64::getZero();
+      enqueue(NewCS, Count);
+    }
+  }
+
+  removeDeadFunctions(CG);
+  return Changed;
+}
@@ -101,6 +101,15 @@ static cl::opt<bool> EnableNonLTOGlobalsModRef(
     cl::desc(
         "Enable the GlobalsModRef AliasAnalysis outside of the LTO pipeline."));
 
+static cl::opt<bool> UsePriorityInliner(
+    "use-priority-inliner", cl::init(false), cl::Hidden,
+    cl::desc("Inline in module-wide order of profile count and size instead "
+             "of bottom-up over the call graph"));
+
+static cl::opt<bool> EnableHotColdSplit(
+    "enable-hot-cold-split", cl::init(false), cl::Hidden,
+    cl::desc("Outline the never executed regions of profiled functions"));
+
 static cl::opt<bool> EnableLoopLoadElim(
     "enable-loop-load-elim", cl::init(false), cl::Hidden,
     cl::desc("Enable the new, experimental LoopLoadElimination Pass"));
@@ -237,6 +246,14 @@ void PassManagerBuilder::populateModulePassManager(
     MPM.add(createCFGSimplificationPass());   // Clean up after IPCP & DAE
   }
 
+  // The priority inliner sees the whole module at once, so it runs ahead of
+  // the CallGraph SCC passes and takes the place of the bottom-up inliner.
+  if (Inliner && UsePriorityInliner) {
+    MPM.add(createPriorityInlinerPass());
+    delete Inliner;
+    Inliner = nullptr;
+  }
+
   if (EnableNonLTOGlobalsModRef)
     // We add a module alias analysis pass here. In part due to bugs in the
     // analysis infrastructure this "works" in that the analysis stays alive
@@ -468,6 +485,11 @@ void PassManagerBuilder::populateModulePassManager(
   // about pointer alignments.
   MPM.add(createAlignmentFromAssumptionsPass());
 
+  // Outline cold code once inlining is done, so it does not inflate the hot
+  // text of the functions it was inlined into.
+  if (EnableHotColdSplit)
+    MPM.add(createHotColdSplittingPass());
+
   if (!DisableUnitAtATime) {
     // FIXME: We shouldn't bother with this anymore.
     MPM.add(createStripDeadPrototypesPass()); // Get rid of dead prototypes
@@ -331,6 +331,10 @@ public:
   // visitInstruction - Specify what to return for unhandled instructions...
   Instruction *visitInstruction(Instruction &I) { return nullptr; }
 
+  /// \brief Try the folds described in InstCombineRules.td, which run before
+  /// the visitors.  Same return convention as the visitors.
+  Instruction *tryTableRules(Instruction &I);
+
   // True when DB dominates all uses of DI execpt UI.
   // UI must be in the same block as DI.
   // The routine checks that the DI parent and DB are different.
@@ -350,6 +354,9 @@ private:
                             SmallVectorImpl<Value *> &NewIndices);
   Instruction *FoldOpIntoSelect(Instruction &Op, SelectInst *SI);
 
+  /// \brief The decision tree generated from InstCombineRules.td.
+  Instruction *matchTableRules(BinaryOperator &I);
+
   /// \brief Classify whether a cast is worth optimizing.
   ///
   /// Returns true if the cast from "V to Ty" actually results in any code
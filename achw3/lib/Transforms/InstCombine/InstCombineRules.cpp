@@ -0,0 +1,41 @@
+//===- InstCombineRules.cpp -----------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the table-driven folds.  The rules are written in
+// InstCombineRules.td and compiled by llvm-tblgen into matchTableRules, a
+// decision tree on the opcodes of the instruction and its operands.
+//
+//===----------------------------------------------------------------------===//
+
+#include "InstCombineInternal.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/Support/CommandLine.h"
+using namespace llvm;
+using namespace PatternMatch;
+
+#define DEBUG_TYPE "instcombine"
+
+STATISTIC(NumTableRuleFolds, "Number of table-driven folds");
+
+static cl::opt<bool>
+EnableTableRules("instcombine-table-rules", cl::Hidden, cl::init(true),
+                 cl::desc("Try the folds from InstCombineRules.td before the "
+                          "hand-written ones"));
+
+Instruction *InstCombiner::tryTableRules(Instruction &I) {
+  if (!EnableTableRules)
+    return nullptr;
+  if (BinaryOperator *BO = dyn_cast<BinaryOperator>(&I))
+    return matchTableRules(*BO);
+  return nullptr;
+}
+
+#define GET_INSTCOMBINE_RULES
+#include "InstCombineRules.inc"
@@ -36,6 +36,7 @@
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "InstCombineInternal.h"
 #include "llvm-c/Initialization.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringSwitch.h"
@@ -75,6 +76,14 @@ STATISTIC(NumSunkInst , "Number of instructions sunk");
 STATISTIC(NumExpand,    "Number of expansions");
 STATISTIC(NumFactor   , "Number of factorizations");
 STATISTIC(NumReassoc  , "Number of reassociations");
+STATISTIC(NumRequeued , "Number of instructions re-queued after a change");
+STATISTIC(NumDupAdds  , "Number of duplicate worklist adds dropped");
+STATISTIC(NumRescans  , "Number of whole-function rescans");
+
+static cl::opt<bool>
+ChangeDriven("instcombine-change-driven", cl::Hidden, cl::init(false),
+             cl::desc("Only revisit instructions affected by a change instead "
+                      "of rescanning the whole function until nothing changes"));
 
 Value *InstCombiner::EmitGEPOffset(User *GEP) {
   return llvm::EmitGEPOffset(Builder, DL, GEP);
@@ -2822,7 +2831,10 @@ bool InstCombiner::run() {
     DEBUG(raw_string_ostream SS(OrigI); I->print(SS); OrigI = SS.str(););
     DEBUG(dbgs() << "IC: Visiting: " << OrigI << '\n');
 
-    if (Instruction *Result = visit(*I)) {
+    Instruction *Result = tryTableRules(*I);
+    if (!Result)
+      Result = visit(*I);
+    if (Result) {
       ++NumCombined;
       // Should we replace the old instruction with a new one?
       if (Result != I) {
@@ -2877,7 +2889,7 @@ bool InstCombiner::run() {
 }
 
 /// Walk the function in depth-first order, adding all reachable code to the
-/// worklist.
+/// worklist in reverse post-order.
 ///
 /// This has a couple of tricks to make the code faster and more powerful.  In
 /// particular, we constant fold and DCE instructions as we go, to avoid adding
@@ -2885,19 +2897,18 @@ bool InstCombiner::run() {
 /// many instructions are dead or constant).  Additionally, if we find a branch
 /// whose condition is a known constant, we only visit the reachable successors.
 ///
-static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
+static bool AddReachableCodeToWorklist(Function &F, const DataLayout &DL,
                                        SmallPtrSetImpl<BasicBlock *> &Visited,
                                        InstCombineWorklist &ICWorklist,
                                        const TargetLibraryInfo *TLI) {
   bool MadeIRChange = false;
   SmallVector<BasicBlock*, 256> Worklist;
-  Worklist.push_back(BB);
+  Worklist.push_back(&F.front());
 
-  SmallVector<Instruction*, 128> InstrsForInstCombineWorklist;
   DenseMap<ConstantExpr*, Constant*> FoldedConstants;
 
   do {
-    BB = Worklist.pop_back_val();
+    BasicBlock *BB = Worklist.pop_back_val();
 
     // We have now visited this block!  If we've already been here, ignore it.
     if (!Visited.insert(BB).second)
@@ -2944,8 +2955,6 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
           MadeIRChange = true;
         }
       }
-
-      InstrsForInstCombineWorklist.push_back(Inst);
     }
 
     // Recursively visit successors.  If this is a branch or switch on a
@@ -2980,10 +2989,17 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
   } while (!Worklist.empty());
 
   // Once we've found all of the instructions to add to instcombine's worklist,
-  // add them in reverse order.  This way instcombine will visit from the top
-  // of the function down.  This jives well with the way that it adds all uses
+  // add them in reverse order.  Ordering the blocks in reverse post-order means
+  // that, apart from loop back edges, instcombine visits an instruction after
+  // all of its operands.  This jives well with the way that it adds all uses
   // of instructions to the worklist after doing a transformation, thus avoiding
   // some N^2 behavior in pathological cases.
+  SmallVector<Instruction*, 128> InstrsForInstCombineWorklist;
+  ReversePostOrderTraversal<BasicBlock *> RPOT(&F.front());
+  for (BasicBlock *BB : RPOT)
+    if (Visited.count(BB))
+      for (Instruction &I : *BB)
+        InstrsForInstCombineWorklist.push_back(&I);
   ICWorklist.AddInitialGroup(InstrsForInstCombineWorklist);
 
   return MadeIRChange;
@@ -3003,8 +3019,7 @@ static bool prepareICWorklistFromFunction(Function &F, const DataLayout &DL,
   // the reachable instructions.  Ignore blocks that are not reachable.  Keep
   // track of which blocks we visit.
   SmallPtrSet<BasicBlock *, 64> Visited;
-  MadeIRChange |=
-      AddReachableCodeToWorklist(&F.front(), DL, Visited, ICWorklist, TLI);
+  MadeIRChange |= AddReachableCodeToWorklist(F, DL, Visited, ICWorklist, TLI);
 
   // Do a quick scan over the function.  If we find any blocks that are
   // unreachable, remove any instructions inside of them.  This prevents
@@ -3050,7 +3065,7 @@ combineInstructionsOverFunction(Function &F, InstCombineWorklist &Worklist,
 
   // Lower dbg.declare intrinsics otherwise their value may be clobbered
   // by instcombiner.
-  bool DbgDeclaresChanged = LowerDbgDeclare(F);
+  bool MadeIRChange = LowerDbgDeclare(F);
 
   // Iterate while there is work to do.
   int Iteration = 0;
@@ -3058,6 +3073,8 @@ combineInstructionsOverFunction(Function &F, InstCombineWorklist &Worklist,
     ++Iteration;
     DEBUG(dbgs() << "\n\nINSTCOMBINE ITERATION #" << Iteration << " on "
                  << F.getName() << "\n");
+    if (Iteration > 1)
+      ++NumRescans;
 
     bool Changed = false;
     if (prepareICWorklistFromFunction(F, DL, &TLI, Worklist))
@@ -3068,11 +3085,21 @@ combineInstructionsOverFunction(Function &F, InstCombineWorklist &Worklist,
     if (IC.run())
       Changed = true;
 
-    if (!Changed)
+    MadeIRChange |= Changed;
+
+    // Combines queue the users of what they changed, so in change-driven mode
+    // rely on that instead of visiting the rest of the function again.  Folds
+    // that only a rescan would find are missed; this is why the mode is off
+    // by default.
+    if (!Changed || ChangeDriven)
       break;
   }
 
-  return DbgDeclaresChanged || Iteration > 1;
+  NumRequeued += Worklist.getNumRequeued();
+  NumDupAdds += Worklist.getNumDuplicateAdds();
+  Worklist.resetCounters();
+
+  return MadeIRChange;
 }
 
 PreservedAnalyses InstCombinePass::run(Function &F,
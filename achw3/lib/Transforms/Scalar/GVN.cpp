@@ -37,6 +37,7 @@
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IRBuilder.h"
@@ -64,6 +65,9 @@ STATISTIC(NumGVNBlocks, "Number of blocks merged");
 STATISTIC(NumGVNSimpl,  "Number of instructions simplified");
 STATISTIC(NumGVNEqProp, "Number of equalities propagated");
 STATISTIC(NumPRELoad,   "Number of loads PRE'd");
+STATISTIC(NumGVNMemDepBudget, "Number of functions that ran out of non-local "
+                              "load budget");
+STATISTIC(NumGVNPREBudget, "Number of functions that ran out of PRE budget");
 
 static cl::opt<bool> EnablePRE("enable-pre",
                                cl::init(true), cl::Hidden);
@@ -74,6 +78,24 @@ static cl::opt<uint32_t>
 MaxRecurseDepth("max-recurse-depth", cl::Hidden, cl::init(1000), cl::ZeroOrMore,
                 cl::desc("Max recurse depth (default = 1000)"));
 
+// Per-function compile-time budgets.  Once one runs out, GVN keeps going
+// without the expensive part: loads are only eliminated against local
+// dependencies, or no more PRE is attempted.
+static cl::opt<unsigned>
+MaxNonLocalBlocks("gvn-max-nonlocal-blocks", cl::Hidden, cl::init(100000),
+                  cl::desc("Max number of blocks walked by non-local "
+                           "memory dependence queries per function "
+                           "(default = 100000)"));
+
+// A load whose non-local dependencies span more blocks than this is not worth
+// optimizing.
+static const unsigned MaxNonLocalDeps = 100;
+
+static cl::opt<unsigned>
+MaxPREAttempts("gvn-max-pre-attempts", cl::Hidden, cl::init(20000),
+               cl::desc("Max number of load and scalar PRE attempts per "
+                        "function (default = 20000)"));
+
 //===----------------------------------------------------------------------===//
 //                         ValueTable Class
 //===----------------------------------------------------------------------===//
@@ -601,6 +623,13 @@ namespace {
     AssumptionCache *AC;
     SetVector<BasicBlock *> DeadBlocks;
 
+    // What is left of the per-function budgets, and whether running out of
+    // them has been reported.
+    unsigned NonLocalBlocksLeft;
+    unsigned PREAttemptsLeft;
+    bool NonLocalBudgetExhausted;
+    bool PREBudgetExhausted;
+
     ValueTable VN;
 
     /// A mapping from value numbers to lists of Value*'s that
@@ -709,6 +738,8 @@ namespace {
     bool processLoad(LoadInst *L);
     bool processNonLocalLoad(LoadInst *L);
     bool processAssumeIntrinsic(IntrinsicInst *II);
+    bool hasNonLocalBudget(LoadInst *LI);
+    bool consumePREBudget(Instruction *I);
     void AnalyzeLoadAvailability(LoadInst *LI, LoadDepVect &Deps, 
                                  AvailValInBlkVect &ValuesPerBlock,
                                  UnavailBlkVect &UnavailableBlocks);
@@ -1714,15 +1745,22 @@ bool GVN::processNonLocalLoad(LoadInst *LI) {
   if (LI->getParent()->getParent()->hasFnAttribute(Attribute::SanitizeAddress))
     return false;
 
-  // Step 1: Find the non-local dependencies of the load.
+  // Once the non-local budget is spent, only local dependencies are used.
+  if (!hasNonLocalBudget(LI))
+    return false;
+
+  // Step 1: Find the non-local dependencies of the load.  The walk is paid
+  // for by the blocks it visits, and gives up once it has used what is left.
   LoadDepVect Deps;
-  MD->getNonLocalPointerDependency(LI, Deps);
+  unsigned NumBlocks;
+  MD->getNonLocalPointerDependency(LI, Deps, &NumBlocks, NonLocalBlocksLeft);
+  NonLocalBlocksLeft -= std::min(NumBlocks, NonLocalBlocksLeft);
+  unsigned NumDeps = Deps.size();
 
   // If we had to process more than one hundred blocks to find the
   // dependencies, this load isn't worth worrying about.  Optimizing
   // it will be too expensive.
-  unsigned NumDeps = Deps.size();
-  if (NumDeps > 100)
+  if (NumDeps > MaxNonLocalDeps)
     return false;
 
   // If we had a phi translation failure, we'll have a single entry which is a
@@ -1781,12 +1819,52 @@ bool GVN::processNonLocalLoad(LoadInst *LI) {
   }
 
   // Step 4: Eliminate partial redundancy.
-  if (!EnablePRE || !EnableLoadPRE)
+  if (!EnablePRE || !EnableLoadPRE || !consumePREBudget(LI))
     return false;
 
   return PerformLoadPRE(LI, ValuesPerBlock, UnavailableBlocks);
 }
 
+/// Return true if any of the non-local load budget is left for the dependence
+/// walk of \p LI.  Running out is reported once.
+bool GVN::hasNonLocalBudget(LoadInst *LI) {
+  if (NonLocalBlocksLeft)
+    return true;
+  if (NonLocalBudgetExhausted)
+    return false;
+
+  NonLocalBudgetExhausted = true;
+  ++NumGVNMemDepBudget;
+  Function *F = LI->getParent()->getParent();
+  DEBUG(dbgs() << "GVN: non-local load budget exhausted in " << F->getName()
+               << "\n");
+  emitOptimizationRemarkAnalysis(
+      F->getContext(), DEBUG_TYPE, *F, LI->getDebugLoc(),
+      "non-local load budget exhausted; only local loads are eliminated in "
+      "the rest of the function");
+  return false;
+}
+
+/// Take one attempt from the PRE budget.  Returns false once there are none
+/// left.  Running out is reported once, when the first attempt is refused.
+bool GVN::consumePREBudget(Instruction *I) {
+  if (PREAttemptsLeft) {
+    --PREAttemptsLeft;
+    return true;
+  }
+  if (PREBudgetExhausted)
+    return false;
+
+  PREBudgetExhausted = true;
+  ++NumGVNPREBudget;
+  Function *F = I->getParent()->getParent();
+  DEBUG(dbgs() << "GVN: PRE budget exhausted in " << F->getName() << "\n");
+  emitOptimizationRemarkAnalysis(
+      F->getContext(), DEBUG_TYPE, *F, I->getDebugLoc(),
+      "PRE budget exhausted; no more PRE in the rest of the function");
+  return false;
+}
+
 bool GVN::processAssumeIntrinsic(IntrinsicInst *IntrinsicI) {
   assert(IntrinsicI->getIntrinsicID() == Intrinsic::assume &&
          "This function can only be called with llvm.assume intrinsic");
@@ -2434,6 +2512,9 @@ bool GVN::runOnFunction(Function& F) {
   VN.setAliasAnalysis(&getAnalysis<AAResultsWrapperPass>().getAAResults());
   VN.setMemDep(MD);
   VN.setDomTree(DT);
+  NonLocalBlocksLeft = MaxNonLocalBlocks;
+  PREAttemptsLeft = MaxPREAttempts;
+  NonLocalBudgetExhausted = PREBudgetExhausted = false;
 
   bool Changed = false;
   bool ShouldContinue = true;
@@ -2660,6 +2741,13 @@ bool GVN::performScalarPRE(Instruction *CurInst) {
       toSplit.push_back(std::make_pair(PREPred->getTerminator(), SuccNum));
       return false;
     }
+  }
+
+  // This is a real PRE attempt; charge it to the budget.
+  if (!consumePREBudget(CurInst))
+    return false;
+
+  if (NumWithout != 0) {
     // We need to insert somewhere, so let's give it a shot
     PREInstr = CurInst->clone();
     if (!performScalarPREInsertion(PREInstr, PREPred, ValNo)) {
@@ -113,6 +113,8 @@ using namespace llvm::PatternMatch;
 
 STATISTIC(LoopsVectorized, "Number of loops vectorized");
 STATISTIC(LoopsAnalyzed, "Number of loops analyzed for vectorization");
+STATISTIC(EpiloguesVectorized, "Number of epilogue loops vectorized");
+STATISTIC(LoopsTailFolded, "Number of loops vectorized with a masked tail");
 
 static cl::opt<bool>
 EnableIfConversion("enable-if-conversion", cl::init(true), cl::Hidden,
@@ -236,6 +238,37 @@ static cl::opt<unsigned> PragmaVectorizeSCEVCheckThreshold(
     cl::desc("The maximum number of SCEV checks allowed with a "
              "vectorize(enable) pragma"));
 
+/// The ways the iterations left over by the vector loop can be executed.
+enum TailKind {
+  TK_Scalar,   ///< Run them in the scalar loop.
+  TK_Epilogue, ///< Vectorize the scalar loop again at a narrower width.
+  TK_Masked,   ///< Fold them into the vector loop using masked operations.
+  TK_Auto      ///< Let the cost model choose.
+};
+
+static cl::opt<TailKind> VectorizerTail(
+    "vectorizer-tail", cl::Hidden, cl::init(TK_Scalar),
+    cl::desc("Choose how the iterations left over by the vector loop are "
+             "executed"),
+    cl::values(clEnumValN(TK_Scalar, "scalar", "use the scalar loop"),
+               clEnumValN(TK_Epilogue, "epilogue",
+                          "vectorize the scalar loop at a narrower width"),
+               clEnumValN(TK_Masked, "masked",
+                          "fold them into the vector loop where possible"),
+               clEnumValN(TK_Auto, "auto",
+                          "let the cost model choose between all three"),
+               clEnumValEnd));
+
+static cl::opt<unsigned> TailTripCountEstimate(
+    "vectorizer-tail-trip-count-estimate", cl::init(64), cl::Hidden,
+    cl::desc("The trip count assumed when choosing how to execute the tail "
+             "of a loop whose trip count is unknown"));
+
+static cl::opt<unsigned> EpilogueCheckCost(
+    "vectorizer-epilogue-check-cost", cl::init(4), cl::Hidden,
+    cl::desc("The estimated cost of the checks that guard a vectorized "
+             "epilogue loop"));
+
 namespace {
 
 // Forward declarations.
@@ -314,12 +347,12 @@ public:
                       LoopInfo *LI, DominatorTree *DT,
                       const TargetLibraryInfo *TLI,
                       const TargetTransformInfo *TTI, unsigned VecWidth,
-                      unsigned UnrollFactor)
+                      unsigned UnrollFactor, bool FoldTail = false)
       : OrigLoop(OrigLoop), PSE(PSE), LI(LI), DT(DT), TLI(TLI), TTI(TTI),
         VF(VecWidth), UF(UnrollFactor), Builder(PSE.getSE()->getContext()),
         Induction(nullptr), OldInduction(nullptr), WidenMap(UnrollFactor),
         TripCount(nullptr), VectorTripCount(nullptr), Legal(nullptr),
-        AddedSafetyChecks(false) {}
+        AddedSafetyChecks(false), FoldTailByMasking(FoldTail) {}
 
   // Perform the actual loop widening (vectorization).
   // MinimumBitWidths maps scalar integer values to the smallest bitwidth they
@@ -381,6 +414,10 @@ protected:
   /// and DST.
   VectorParts createEdgeMask(BasicBlock *Src, BasicBlock *Dst);
 
+  /// Compute the mask of lanes that run an iteration of the original loop,
+  /// which becomes the entry mask of the header when the tail is folded.
+  void createTailMask();
+
   /// A helper function to vectorize a single BB within the innermost loop.
   void vectorizeBlockInLoop(BasicBlock *BB, PhiVector *PV);
   
@@ -435,7 +472,9 @@ protected:
   Value *getOrCreateVectorTripCount(Loop *NewLoop);
 
   /// Emit a bypass check to see if the trip count would overflow, or we
-  /// wouldn't have enough iterations to execute one vector loop.
+  /// wouldn't have enough iterations to execute one vector loop. When the tail
+  /// is folded, check instead that rounding the trip count up does not
+  /// overflow.
   void emitMinimumIterationCountCheck(Loop *L, BasicBlock *Bypass);
   /// Emit a bypass check to see if the vector trip count is nonzero.
   void emitVectorLoopEnteredCheck(Loop *L, BasicBlock *Bypass);
@@ -543,7 +582,8 @@ protected:
   EdgeMaskCache MaskCache;
   /// Trip count of the original loop.
   Value *TripCount;
-  /// Trip count of the widened loop (TripCount - TripCount % (VF*UF))
+  /// Trip count of the widened loop (TripCount - TripCount % (VF*UF)), or
+  /// TripCount rounded up to a multiple of VF*UF when the tail is folded.
   Value *VectorTripCount;
 
   /// Map of scalar integer values to the smallest bitwidth they can be legally
@@ -554,6 +594,13 @@ protected:
 
   // Record whether runtime check is added.
   bool AddedSafetyChecks;
+
+  /// True if the vector loop runs the remainder iterations itself, with the
+  /// lanes past the trip count masked off, so that the scalar loop is only
+  /// reached through the bypass checks.
+  bool FoldTailByMasking;
+  /// The per-part mask of active lanes when the tail is folded.
+  VectorParts TailMask;
 };
 
 class InnerLoopUnroller : public InnerLoopVectorizer {
@@ -1296,6 +1343,16 @@ public:
   unsigned getNumPredStores() const {
     return NumPredStores;
   }
+
+  /// Returns true if the vector loop can execute the remainder iterations
+  /// itself: every memory access must be a consecutive access that the target
+  /// can mask, and no other instruction may trap or touch memory in the lanes
+  /// past the trip count.
+  bool canFoldTailByMasking();
+
+  /// Require masks on all memory accesses, so that the remainder iterations
+  /// can be folded into the vector loop.
+  void foldTailByMasking();
 private:
   /// Check if a single basic block loop is vectorizable.
   /// At this point we know that this is a loop with a constant trip count
@@ -1417,7 +1474,8 @@ public:
                              const LoopVectorizeHints *Hints,
                              SmallPtrSetImpl<const Value *> &ValuesToIgnore)
       : TheLoop(L), SE(SE), LI(LI), Legal(Legal), TTI(TTI), TLI(TLI), DB(DB),
-        TheFunction(F), Hints(Hints), ValuesToIgnore(ValuesToIgnore) {}
+        TheFunction(F), Hints(Hints), ValuesToIgnore(ValuesToIgnore),
+        FoldTailByMasking(false) {}
 
   /// Information about vectorization costs
   struct VectorizationFactor {
@@ -1449,6 +1507,18 @@ public:
   unsigned computeInterleaveCount(bool OptForSize, unsigned VF,
                                   unsigned LoopCost);
 
+  /// Information about how the iterations left over by the vector loop are
+  /// executed.
+  struct TailDecision {
+    TailKind Kind;
+    unsigned EpilogueWidth; // Vector width of the epilogue for TK_Epilogue.
+  };
+  /// \return How to execute the iterations left over by a vector loop of
+  /// width \p VF that is interleaved \p IC times. \p Requested is used if it
+  /// is possible, except that TK_Auto picks the cheapest of all strategies.
+  TailDecision selectTailStrategy(TailKind Requested, unsigned VF,
+                                  unsigned IC);
+
   /// \brief A struct that represents some properties of the register usage
   /// of a loop.
   struct RegisterUsage {
@@ -1476,6 +1546,10 @@ private:
   /// width. Vector width of one means scalar.
   unsigned getInstructionCost(Instruction *I, unsigned VF);
 
+  /// Returns the cost per vector iteration of computing the tail mask and of
+  /// keeping the reductions of the masked-off lanes unchanged.
+  unsigned getTailMaskCost(unsigned VF);
+
   /// Returns whether the instruction is a load or store and will be a emitted
   /// as a vector operation.
   bool isConsecutiveLoadOrStore(Instruction *I);
@@ -1513,6 +1587,9 @@ public:
   const LoopVectorizeHints *Hints;
   // Values to ignore in the cost model.
   const SmallPtrSetImpl<const Value *> &ValuesToIgnore;
+  /// Cost every vectorized memory access as a masked one, as it will be when
+  /// the tail is folded into the vector loop.
+  bool FoldTailByMasking;
 };
 
 /// \brief This holds vectorization requirements that must be verified late in
@@ -1887,22 +1964,35 @@ struct LoopVectorize : public FunctionPass {
                              Twine("interleaved loop (interleaved count: ") +
                                  Twine(IC) + ")");
     } else {
+      // Decide how to execute the iterations left over by the vector loop.
+      LoopVectorizationCostModel::TailDecision Tail = CM.selectTailStrategy(
+          OptForSize ? TK_Scalar : VectorizerTail, VF.Width, IC);
+      bool FoldTail = Tail.Kind == TK_Masked;
+      if (FoldTail)
+        LVL.foldTailByMasking();
+
       // If we decided that it is *legal* to vectorize the loop then do it.
-      InnerLoopVectorizer LB(L, PSE, LI, DT, TLI, TTI, VF.Width, IC);
+      InnerLoopVectorizer LB(L, PSE, LI, DT, TLI, TTI, VF.Width, IC, FoldTail);
       LB.vectorize(&LVL, CM.MinBWs);
       ++LoopsVectorized;
+      if (FoldTail)
+        ++LoopsTailFolded;
 
       // Add metadata to disable runtime unrolling scalar loop when there's no
       // runtime check about strides and memory. Because at this situation,
       // scalar loop is rarely used not worthy to be unrolled.
-      if (!LB.IsSafetyChecksAdded())
+      if (!LB.IsSafetyChecksAdded() && Tail.Kind != TK_Epilogue)
         AddRuntimeUnrollDisableMetaData(L);
 
       // Report the vectorization decision.
       emitOptimizationRemark(F->getContext(), LV_NAME, *F, L->getStartLoc(),
                              Twine("vectorized loop (vectorization width: ") +
                                  Twine(VF.Width) + ", interleaved count: " +
-                                 Twine(IC) + ")");
+                                 Twine(IC) +
+                                 (FoldTail ? ", masked tail)" : ")"));
+
+      if (Tail.Kind == TK_Epilogue)
+        vectorizeEpilogue(L, Tail.EpilogueWidth);
     }
 
     // Mark the loop as already vectorized to avoid vectorizing again.
@@ -1912,6 +2002,37 @@ struct LoopVectorize : public FunctionPass {
     return true;
   }
 
+  /// Vectorize \p L, the scalar remainder loop of a loop that was just
+  /// vectorized, again at the narrower width \p VF. The remainder now starts
+  /// where the vector loop stopped, so its legality is established afresh.
+  bool vectorizeEpilogue(Loop *L, unsigned VF) {
+    Function *F = L->getHeader()->getParent();
+    LAA->forgetLoop(L);
+
+    PredicatedScalarEvolution PSE(*SE);
+    LoopVectorizationRequirements Requirements;
+    LoopVectorizeHints Hints(L, /*DisableInterleaving=*/true);
+    LoopVectorizationLegality LVL(L, PSE, DT, TLI, AA, F, TTI, LAA,
+                                  &Requirements, &Hints);
+    if (!LVL.canVectorize()) {
+      DEBUG(dbgs() << "LV: Not vectorizing the epilogue: Cannot prove "
+                      "legality.\n");
+      return false;
+    }
+
+    InnerLoopVectorizer LB(L, PSE, LI, DT, TLI, TTI, VF, 1);
+    LB.vectorize(&LVL, MapVector<Instruction *, uint64_t>());
+    ++EpiloguesVectorized;
+
+    if (!LB.IsSafetyChecksAdded())
+      AddRuntimeUnrollDisableMetaData(L);
+
+    emitOptimizationRemark(F->getContext(), LV_NAME, *F, L->getStartLoc(),
+                           Twine("vectorized epilogue loop (vectorization "
+                                 "width: ") + Twine(VF) + ")");
+    return true;
+  }
+
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<AssumptionCacheTracker>();
     AU.addRequiredID(LoopSimplifyID);
@@ -2700,6 +2821,13 @@ Value *InnerLoopVectorizer::getOrCreateVectorTripCount(Loop *L) {
   // The loop step is equal to the vectorization factor (num of SIMD elements)
   // times the unroll factor (num of SIMD instructions).
   Constant *Step = ConstantInt::get(TC->getType(), VF * UF);
+
+  // If the tail is folded, the vector body executes all iterations, so round
+  // N up to a multiple of the step instead.
+  if (FoldTailByMasking)
+    TC = Builder.CreateAdd(TC, ConstantInt::get(TC->getType(), VF * UF - 1),
+                           "n.rnd.up");
+
   Value *R = Builder.CreateURem(TC, Step, "n.mod.vf");
   VectorTripCount = Builder.CreateSub(TC, R, "n.vec");
 
@@ -2714,10 +2842,18 @@ void InnerLoopVectorizer::emitMinimumIterationCountCheck(Loop *L,
 
   // Generate code to check that the loop's trip count that we computed by
   // adding one to the backedge-taken count will not overflow.
-  Value *CheckMinIters =
-    Builder.CreateICmpULT(Count,
-                          ConstantInt::get(Count->getType(), VF * UF),
-                          "min.iters.check");
+  Value *CheckMinIters;
+  if (FoldTailByMasking)
+    // Any number of iterations fits into the vector loop, as long as rounding
+    // it up to a multiple of the step does not overflow.
+    CheckMinIters = Builder.CreateICmpUGT(
+        Count, ConstantInt::get(Count->getType(), -(uint64_t)(VF * UF)),
+        "min.iters.check");
+  else
+    CheckMinIters =
+      Builder.CreateICmpULT(Count,
+                            ConstantInt::get(Count->getType(), VF * UF),
+                            "min.iters.check");
   
   BasicBlock *NewBB = BB->splitBasicBlock(BB->getTerminator(),
                                           "min.iters.checked");
@@ -2959,10 +3095,15 @@ void InnerLoopVectorizer::createEmptyLoop() {
 
   // Add a check in the middle block to see if we have completed
   // all of the iterations in the first vector loop.
-  // If (N - N%VF) == N, then we *don't* need to run the remainder.
-  Value *CmpN = CmpInst::Create(Instruction::ICmp, CmpInst::ICMP_EQ, Count,
-                                CountRoundDown, "cmp.n",
-                                MiddleBlock->getTerminator());
+  // If (N - N%VF) == N, then we *don't* need to run the remainder. With a
+  // folded tail the vector loop always runs all of them.
+  Value *CmpN;
+  if (FoldTailByMasking)
+    CmpN = ConstantInt::getTrue(Count->getContext());
+  else
+    CmpN = CmpInst::Create(Instruction::ICmp, CmpInst::ICMP_EQ, Count,
+                           CountRoundDown, "cmp.n",
+                           MiddleBlock->getTerminator());
   ReplaceInstWithInst(MiddleBlock->getTerminator(),
                       BranchInst::Create(ExitBlock, ScalarPH, CmpN));
 
@@ -3281,6 +3422,9 @@ void InnerLoopVectorizer::vectorizeLoop() {
   LoopBlocksDFS DFS(OrigLoop);
   DFS.perform(LI);
 
+  if (FoldTailByMasking)
+    createTailMask();
+
   // Vectorize all of the blocks in the original loop.
   for (LoopBlocksDFS::RPOIterator bb = DFS.beginRPO(),
        be = DFS.endRPO(); bb != be; ++bb)
@@ -3367,6 +3511,16 @@ void InnerLoopVectorizer::vectorizeLoop() {
     BasicBlock *Latch = OrigLoop->getLoopLatch();
     Value *LoopVal = RdxPhi->getIncomingValueForBlock(Latch);
     VectorParts &Val = getVectorValue(LoopVal);
+
+    // With a folded tail, the lanes past the trip count must not contribute
+    // to the reduction: keep the value they had on entry to the iteration.
+    // This also updates the value that leaves the loop.
+    if (FoldTailByMasking) {
+      Builder.SetInsertPoint(LoopVectorBody.back()->getTerminator());
+      for (unsigned part = 0; part < UF; ++part)
+        Val[part] = Builder.CreateSelect(TailMask[part], Val[part],
+                                         VecRdxPhi[part], "rdx.masked");
+    }
     for (unsigned part = 0; part < UF; ++part) {
       // Make sure to add the reduction stat value only to the
       // first unroll part.
@@ -3487,13 +3641,13 @@ void InnerLoopVectorizer::vectorizeLoop() {
       PHINode *LCSSAPhi = dyn_cast<PHINode>(LEI);
       if (!LCSSAPhi) break;
 
-      // All PHINodes need to have a single entry edge, or two if
-      // we already fixed them.
-      assert(LCSSAPhi->getNumIncomingValues() < 3 && "Invalid LCSSA PHI");
-
       // We found our reduction value exit-PHI. Update it with the
       // incoming bypass edge.
       if (LCSSAPhi->getIncomingValue(0) == LoopExitInst) {
+        // The PHI has a single entry edge, plus one for each vector loop
+        // that we already fixed it for, but none from this one yet.
+        assert(LCSSAPhi->getBasicBlockIndex(LoopMiddleBlock) == -1 &&
+               "Invalid LCSSA PHI");
         // Add an edge coming from the bypass.
         LCSSAPhi->addIncoming(ReducedPartRdx, LoopMiddleBlock);
         break;
@@ -3536,7 +3690,7 @@ void InnerLoopVectorizer::fixLCSSAPHIs() {
        LEE = LoopExitBlock->end(); LEI != LEE; ++LEI) {
     PHINode *LCSSAPhi = dyn_cast<PHINode>(LEI);
     if (!LCSSAPhi) break;
-    if (LCSSAPhi->getNumIncomingValues() == 1)
+    if (LCSSAPhi->getBasicBlockIndex(LoopMiddleBlock) == -1)
       LCSSAPhi->addIncoming(UndefValue::get(LCSSAPhi->getType()),
                             LoopMiddleBlock);
   }
@@ -3581,8 +3735,11 @@ InnerLoopVectorizer::VectorParts
 InnerLoopVectorizer::createBlockInMask(BasicBlock *BB) {
   assert(OrigLoop->contains(BB) && "Block is not a part of a loop");
 
-  // Loop incoming mask is all-one.
+  // Loop incoming mask is all-one, unless the lanes past the trip count are
+  // masked off.
   if (OrigLoop->getHeader() == BB) {
+    if (FoldTailByMasking)
+      return TailMask;
     Value *C = ConstantInt::get(IntegerType::getInt1Ty(BB->getContext()), 1);
     return getVectorValue(C);
   }
@@ -3601,6 +3758,27 @@ InnerLoopVectorizer::createBlockInMask(BasicBlock *BB) {
   return BlockMask;
 }
 
+void InnerLoopVectorizer::createTailMask() {
+  assert(FoldTailByMasking && VF > 1 && "No tail to mask");
+
+  // A lane is active if its iteration number does not exceed the
+  // backedge-taken count. Comparing against the backedge-taken count rather
+  // than the trip count stays correct when the trip count wraps to zero.
+  IRBuilder<> PHBuilder(LoopVectorPreHeader->getTerminator());
+  Value *BTC = PHBuilder.CreateSub(
+      TripCount, ConstantInt::get(TripCount->getType(), 1),
+      "trip.count.minus.1");
+  Value *BTCSplat = PHBuilder.CreateVectorSplat(VF, BTC, "broadcast.btc");
+
+  Value *IVSplat = Builder.CreateVectorSplat(VF, Induction, "broadcast.iv");
+  Value *One = ConstantInt::get(Induction->getType(), 1);
+  TailMask.resize(UF);
+  for (unsigned part = 0; part < UF; ++part) {
+    Value *Lanes = getStepVector(IVSplat, VF * part, One);
+    TailMask[part] = Builder.CreateICmpULE(Lanes, BTCSplat, "tail.mask");
+  }
+}
+
 void InnerLoopVectorizer::widenPHIInstruction(
     Instruction *PN, InnerLoopVectorizer::VectorParts &Entry, unsigned UF,
     unsigned VF, PhiVector *PV) {
@@ -3963,9 +4141,12 @@ void InnerLoopVectorizer::updateAnalysis() {
   // Forget the original basic block.
   PSE.getSE()->forgetLoop(OrigLoop);
 
-  // Update the dominator tree information.
-  assert(DT->properlyDominates(LoopBypassBlocks.front(), LoopExitBlock) &&
-         "Entry does not dominate exit.");
+  // Update the dominator tree information. If the loop is itself the
+  // remainder of a vector loop, the exit may also be reached from that loop's
+  // middle block, so it is not necessarily dominated by our entry.
+  BasicBlock *ExitDom = DT->findNearestCommonDominator(
+      DT->getNode(LoopExitBlock)->getIDom()->getBlock(),
+      LoopBypassBlocks.front());
 
   for (unsigned I = 1, E = LoopBypassBlocks.size(); I != E; ++I)
     DT->addNewBlock(LoopBypassBlocks[I], LoopBypassBlocks[I-1]);
@@ -3979,7 +4160,7 @@ void InnerLoopVectorizer::updateAnalysis() {
   DT->addNewBlock(LoopMiddleBlock, LoopVectorBody.back());
   DT->addNewBlock(LoopScalarPreHeader, LoopBypassBlocks[0]);
   DT->changeImmediateDominator(LoopScalarBody, LoopScalarPreHeader);
-  DT->changeImmediateDominator(LoopExitBlock, LoopBypassBlocks[0]);
+  DT->changeImmediateDominator(LoopExitBlock, ExitDom);
 
   DEBUG(DT->verifyDomTree());
 }
@@ -4487,6 +4668,57 @@ bool LoopVectorizationLegality::blockNeedsPredication(BasicBlock *BB)  {
   return LoopAccessInfo::blockNeedsPredication(BB, TheLoop, DT);
 }
 
+bool LoopVectorizationLegality::canFoldTailByMasking() {
+  const DataLayout &DL = TheFunction->getParent()->getDataLayout();
+  for (BasicBlock *BB : TheLoop->blocks()) {
+    for (Instruction &I : *BB) {
+      LoadInst *LI = dyn_cast<LoadInst>(&I);
+      StoreInst *SI = dyn_cast<StoreInst>(&I);
+      if (LI || SI) {
+        Value *Ptr = LI ? LI->getPointerOperand() : SI->getPointerOperand();
+        // A load from a loop invariant address stays scalar and is executed
+        // by every vector iteration anyway.
+        if (LI && isUniform(Ptr))
+          continue;
+        Type *Ty = LI ? LI->getType() : SI->getValueOperand()->getType();
+        if (isAccessInterleaved(&I) ||
+            DL.getTypeAllocSizeInBits(Ty) != DL.getTypeSizeInBits(Ty))
+          return false;
+        if (LI ? !isLegalMaskedLoad(Ty, Ptr) : !isLegalMaskedStore(Ty, Ptr))
+          return false;
+        continue;
+      }
+
+      if (I.mayReadOrWriteMemory() || I.mayThrow())
+        return false;
+
+      // These may trap on the values in the masked-off lanes.
+      switch (I.getOpcode()) {
+      default:
+        continue;
+      case Instruction::UDiv:
+      case Instruction::SDiv:
+      case Instruction::URem:
+      case Instruction::SRem:
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void LoopVectorizationLegality::foldTailByMasking() {
+  for (BasicBlock *BB : TheLoop->blocks())
+    for (Instruction &I : *BB) {
+      if (auto *LI = dyn_cast<LoadInst>(&I)) {
+        if (!isUniform(LI->getPointerOperand()))
+          MaskedOp.insert(LI);
+      } else if (auto *SI = dyn_cast<StoreInst>(&I)) {
+        MaskedOp.insert(SI);
+      }
+    }
+}
+
 bool LoopVectorizationLegality::blockCanBePredicated(BasicBlock *BB,
                                            SmallPtrSetImpl<Value *> &SafePtrs) {
   
@@ -4922,6 +5154,81 @@ LoopVectorizationCostModel::getSmallestAndWidestTypes() {
   return {MinWidth, MaxWidth};
 }
 
+LoopVectorizationCostModel::TailDecision
+LoopVectorizationCostModel::selectTailStrategy(TailKind Requested,
+                                               unsigned VF, unsigned IC) {
+  TailDecision Decision = { TK_Scalar, 1U };
+  if (Requested == TK_Scalar || VF == 1)
+    return Decision;
+
+  // Work out how many full vector iterations run and how many iterations may
+  // be left over. Without a constant trip count every remainder is assumed to
+  // be equally likely, and the costs below are summed over all of them.
+  unsigned Step = VF * IC;
+  unsigned TC = SE->getSmallConstantTripCount(TheLoop);
+  unsigned VectorIters = (TC ? TC : TailTripCountEstimate) / Step;
+  unsigned MinRem = TC ? TC % Step : 0;
+  unsigned MaxRem = TC ? TC % Step : Step - 1;
+  if (!MaxRem)
+    return Decision;
+
+  // The scalar loop is only a candidate if we are asked to choose. The sums
+  // over all remainders easily exceed 32 bits for long loops, so they are
+  // done in 64 bits.
+  uint64_t ScalarIterCost = expectedCost(1);
+  uint64_t MainCost = uint64_t(VectorIters) * expectedCost(VF) * IC;
+  uint64_t ScalarCost = 0;
+  for (unsigned Rem = MinRem; Rem <= MaxRem; ++Rem)
+    ScalarCost += MainCost + Rem * ScalarIterCost;
+  uint64_t BestCost = Requested == TK_Auto ? ScalarCost : ~0ULL;
+  DEBUG(dbgs() << "LV: Tail with a scalar loop costs: " << ScalarCost
+               << ".\n");
+
+  if (Requested == TK_Epilogue || Requested == TK_Auto) {
+    // Narrower widths leave more iterations for the scalar loop but are used
+    // for more remainders, so try all of them.
+    for (unsigned EVF = 2; EVF <= VF && EVF <= MaxRem; EVF *= 2) {
+      uint64_t EpilogueIterCost = expectedCost(EVF);
+      uint64_t Cost = 0;
+      for (unsigned Rem = MinRem; Rem <= MaxRem; ++Rem) {
+        Cost += MainCost;
+        if (Rem)
+          Cost += EpilogueCheckCost + (Rem / EVF) * EpilogueIterCost +
+                  (Rem % EVF) * ScalarIterCost;
+      }
+      DEBUG(dbgs() << "LV: Tail with an epilogue of width " << EVF
+                   << " costs: " << Cost << ".\n");
+      // On a tie prefer the wider epilogue, which runs fewer iterations.
+      if (Cost < BestCost ||
+          (Cost == BestCost && Decision.Kind == TK_Epilogue)) {
+        BestCost = Cost;
+        Decision = { TK_Epilogue, EVF };
+      }
+    }
+  }
+
+  if ((Requested == TK_Masked || Requested == TK_Auto) &&
+      Legal->canFoldTailByMasking()) {
+    // Every vector iteration pays for the masks, and one more runs if there
+    // is a remainder.
+    FoldTailByMasking = true;
+    uint64_t MaskedIterCost =
+        (uint64_t(expectedCost(VF)) + getTailMaskCost(VF)) * IC;
+    FoldTailByMasking = false;
+    uint64_t Cost = 0;
+    for (unsigned Rem = MinRem; Rem <= MaxRem; ++Rem)
+      Cost += (VectorIters + (Rem ? 1 : 0)) * MaskedIterCost;
+    DEBUG(dbgs() << "LV: Tail folded into the vector loop costs: " << Cost
+                 << ".\n");
+    if (Cost < BestCost) {
+      BestCost = Cost;
+      Decision = { TK_Masked, 1U };
+    }
+  }
+
+  return Decision;
+}
+
 unsigned LoopVectorizationCostModel::selectInterleaveCount(bool OptForSize,
                                                            unsigned VF,
                                                            unsigned LoopCost) {
@@ -5271,6 +5578,22 @@ unsigned LoopVectorizationCostModel::expectedCost(unsigned VF) {
   return Cost;
 }
 
+unsigned LoopVectorizationCostModel::getTailMaskCost(unsigned VF) {
+  // The mask is a compare of the widened induction against the trip count.
+  Type *IdxVecTy = ToVectorTy(Legal->getWidestInductionType(), VF);
+  unsigned Cost = TTI.getArithmeticInstrCost(Instruction::Add, IdxVecTy) +
+                  TTI.getCmpSelInstrCost(Instruction::ICmp, IdxVecTy);
+
+  // Each reduction selects its previous value in the masked-off lanes.
+  Type *MaskTy = ToVectorTy(Type::getInt1Ty(TheLoop->getHeader()->getContext()),
+                            VF);
+  for (auto &Reduction : *Legal->getReductionVars())
+    Cost += TTI.getCmpSelInstrCost(
+        Instruction::Select, ToVectorTy(Reduction.first->getType(), VF),
+        MaskTy);
+  return Cost;
+}
+
 /// \brief Check whether the address computation for a non-consecutive memory
 /// access looks like an unlikely candidate for being merged into the indexing
 /// mode.
@@ -5519,7 +5842,7 @@ LoopVectorizationCostModel::getInstructionCost(Instruction *I, unsigned VF) {
 
     // Wide load/stores.
     unsigned Cost = TTI.getAddressComputationCost(VectorTy);
-    if (Legal->isMaskRequired(I))
+    if (Legal->isMaskRequired(I) || FoldTailByMasking)
       Cost += TTI.getMaskedMemoryOpCost(I->getOpcode(), VectorTy, Alignment,
                                         AS);
     else
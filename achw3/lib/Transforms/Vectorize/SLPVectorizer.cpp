@@ -55,6 +55,9 @@ using namespace llvm;
 #define DEBUG_TYPE "SLP"
 
 STATISTIC(NumVectorInstructions, "Number of vector instructions generated");
+STATISTIC(NumKnownFailures, "Number of bundles skipped because they failed "
+                            "before");
+STATISTIC(NumBlocksOverBudget, "Number of blocks whose tree budget ran out");
 
 static cl::opt<int>
     SLPCostThreshold("slp-threshold", cl::init(0), cl::Hidden,
@@ -82,6 +85,14 @@ static cl::opt<int>
 ScheduleRegionSizeBudget("slp-schedule-budget", cl::init(100000), cl::Hidden,
     cl::desc("Limit the size of the SLP scheduling region per block"));
 
+/// Limits the number of tree entries built for a block to this many per
+/// instruction, so that the time spent trying seeds grows linearly with the
+/// size of the block rather than with the number of seed combinations.
+static cl::opt<unsigned>
+TreeBudgetPerInst("slp-tree-budget-per-inst", cl::init(64), cl::Hidden,
+    cl::desc("Limit the number of SLP tree entries built per instruction "
+             "in a block"));
+
 namespace {
 
 // FIXME: Set this via cl::opt to allow overriding.
@@ -89,6 +100,9 @@ static const unsigned MinVecRegSize = 128;
 
 static const unsigned RecursionMaxDepth = 12;
 
+/// Blocks smaller than this get the tree budget of a block of this size.
+static const unsigned MinTreeBudgetInsts = 16;
+
 // Limit the number of alias checks. The limit is chosen so that
 // it has no negative effect on the llvm benchmarks.
 static const unsigned AliasedCheckLimit = 10;
@@ -364,9 +378,9 @@ public:
   BoUpSLP(Function *Func, ScalarEvolution *Se, TargetTransformInfo *Tti,
           TargetLibraryInfo *TLi, AliasAnalysis *Aa, LoopInfo *Li,
           DominatorTree *Dt, AssumptionCache *AC)
-      : NumLoadsWantToKeepOrder(0), NumLoadsWantToChangeOrder(0), F(Func),
-        SE(Se), TTI(Tti), TLI(TLi), AA(Aa), LI(Li), DT(Dt),
-        Builder(Se->getContext()) {
+      : NumLoadsWantToKeepOrder(0), NumLoadsWantToChangeOrder(0),
+        TreeBudget(~0U), F(Func), SE(Se), TTI(Tti), TLI(TLi), AA(Aa), LI(Li),
+        DT(Dt), Builder(Se->getContext()) {
     CodeMetrics::collectEphemeralValues(F, AC, EphValues);
   }
 
@@ -412,6 +426,27 @@ public:
     return NumLoadsWantToChangeOrder > NumLoadsWantToKeepOrder;
   }
 
+  /// Prepare for the seeds of a new basic block of \p NumInsts instructions:
+  /// forget the bundles that failed in the previous block and grant a tree
+  /// budget proportional to the size of this one.
+  void startBlock(unsigned NumInsts) {
+    FailedBundles.clear();
+    TreeBudget = std::max(NumInsts, MinTreeBudgetInsts) * TreeBudgetPerInst;
+  }
+
+  /// \returns true if the current block has used up its tree budget. Any
+  /// tree built after that point is gathered right away.
+  bool isBudgetExhausted() const { return TreeBudget == 0; }
+
+  /// \returns true if a tree rooted at \p VL was found not to be worth
+  /// vectorizing, and nothing has been vectorized since.
+  bool isKnownFailure(ArrayRef<Value *> VL) const;
+
+  /// Remember that the tree rooted at \p VL is not worth vectorizing.
+  void recordFailure(ArrayRef<Value *> VL) {
+    FailedBundles[VL[0]].push_back(ValueList(VL.begin(), VL.end()));
+  }
+
 private:
   struct TreeEntry;
 
@@ -909,6 +944,14 @@ private:
   // Number of load-bundles of size 2, which are consecutive loads if reversed.
   int NumLoadsWantToChangeOrder;
 
+  /// Roots of trees that were not worth vectorizing, keyed by their first
+  /// scalar. Vectorizing anything changes the costs, so this is cleared
+  /// whenever the IR changes.
+  DenseMap<Value *, SmallVector<ValueList, 2>> FailedBundles;
+
+  /// Number of tree entries that may still be built in the current block.
+  unsigned TreeBudget;
+
   // Analysis and block reference.
   Function *F;
   ScalarEvolution *SE;
@@ -934,6 +977,10 @@ void BoUpSLP::buildTree(ArrayRef<Value *> Roots,
   UserIgnoreList = UserIgnoreLst;
   if (!getSameType(Roots))
     return;
+  if (isBudgetExhausted()) {
+    DEBUG(dbgs() << "SLP: Not building a tree, the block budget is used up.\n");
+    return;
+  }
   buildTree_rec(Roots, 0);
 
   // Collect the values that we need to extract from the tree.
@@ -997,6 +1044,14 @@ void BoUpSLP::buildTree_rec(ArrayRef<Value *> VL, unsigned Depth) {
     return;
   }
 
+  if (isBudgetExhausted()) {
+    DEBUG(dbgs() << "SLP: Gathering due to exhausted block budget.\n");
+    newTreeEntry(VL, false);
+    return;
+  }
+  if (--TreeBudget == 0)
+    ++NumBlocksOverBudget;
+
   // Don't handle vectors.
   if (VL[0]->getType()->isVectorTy()) {
     DEBUG(dbgs() << "SLP: Gathering due to vector type.\n");
@@ -2551,7 +2606,21 @@ Value *BoUpSLP::vectorizeTree(TreeEntry *E) {
   return nullptr;
 }
 
+bool BoUpSLP::isKnownFailure(ArrayRef<Value *> VL) const {
+  auto I = FailedBundles.find(VL[0]);
+  if (I == FailedBundles.end())
+    return false;
+  for (const ValueList &Bundle : I->second)
+    if (VL.equals(Bundle)) {
+      ++NumKnownFailures;
+      return true;
+    }
+  return false;
+}
+
 Value *BoUpSLP::vectorizeTree() {
+  // The failed trees may now be profitable, and their scalars may be gone.
+  FailedBundles.clear();
 
   // All blocks must be scheduled before any instructions are inserted.
   for (auto &BSIter : BlocksSchedules) {
@@ -3206,6 +3275,8 @@ struct SLPVectorizer : public FunctionPass {
 
     // Scan the blocks in the function in post order.
     for (auto BB : post_order(&F.getEntryBlock())) {
+      R.startBlock(BB->size());
+
       // Vectorize trees that end at stores.
       if (unsigned count = collectStores(BB, R)) {
         (void)count;
@@ -3320,6 +3391,8 @@ bool SLPVectorizer::vectorizeStoreChain(ArrayRef<Value *> Chain,
     DEBUG(dbgs() << "SLP: Analyzing " << VF << " stores at offset " << i
           << "\n");
     ArrayRef<Value *> Operands = Chain.slice(i, VF);
+    if (R.isKnownFailure(Operands))
+      continue;
 
     R.buildTree(Operands);
 
@@ -3333,6 +3406,8 @@ bool SLPVectorizer::vectorizeStoreChain(ArrayRef<Value *> Chain,
       // Move to the next bundle.
       i += VF - 1;
       Changed = true;
+    } else {
+      R.recordFailure(Operands);
     }
   }
 
@@ -3394,16 +3469,40 @@ bool SLPVectorizer::vectorizeStores(ArrayRef<StoreInst *> Stores,
       I = ConsecutiveChain[I];
     }
 
+    // The stores that a wider vector factor leaves over are tried again with
+    // the narrower ones, so that chains whose length is not a multiple of the
+    // widest factor are vectorized completely. Every run of consecutive
+    // left-over stores is retried, as a vectorized bundle in the middle of
+    // the chain leaves one run on each side. Vectorized stores are unlinked
+    // from their block, but only deleted along with R.
+    auto IsLeftOver = [&](unsigned Idx) {
+      return cast<StoreInst>(Operands[Idx])->getParent() != nullptr;
+    };
+    bool ChainChanged = false;
+
     // FIXME: Is division-by-2 the correct step? Should we assert that the
     // register size is a power-of-2?
     for (unsigned Size = MaxVecRegSize; Size >= MinVecRegSize; Size /= 2) {
-      if (vectorizeStoreChain(Operands, costThreshold, R, Size)) {
-        // Mark the vectorized stores so that we don't vectorize them again.
-        VectorizedStores.insert(Operands.begin(), Operands.end());
-        Changed = true;
-        break;
+      for (unsigned j = 0, e = Operands.size(); j != e;) {
+        if (!IsLeftOver(j)) {
+          ++j;
+          continue;
+        }
+        unsigned Begin = j;
+        while (j != e && IsLeftOver(j))
+          ++j;
+        if (j - Begin >= 2 &&
+            vectorizeStoreChain(makeArrayRef(Operands).slice(Begin, j - Begin),
+                                costThreshold, R, Size))
+          ChainChanged = true;
       }
     }
+
+    if (ChainChanged) {
+      // Mark the vectorized stores so that we don't vectorize them again.
+      VectorizedStores.insert(Operands.begin(), Operands.end());
+      Changed = true;
+    }
   }
 
   return Changed;
@@ -3500,6 +3599,12 @@ bool SLPVectorizer::tryToVectorizeList(ArrayRef<Value *> VL, BoUpSLP &R,
                  << "\n");
     ArrayRef<Value *> Ops = VL.slice(i, OpsWidth);
 
+    // The cost of a tree feeding a build vector depends on the inserts it
+    // ignores, so only plain lists are remembered as failures.
+    bool Memoise = BuildVector.empty();
+    if (Memoise && R.isKnownFailure(Ops))
+      continue;
+
     ArrayRef<Value *> BuildVectorSlice;
     if (!BuildVector.empty())
       BuildVectorSlice = BuildVector.slice(i, OpsWidth);
@@ -3543,6 +3648,8 @@ bool SLPVectorizer::tryToVectorizeList(ArrayRef<Value *> VL, BoUpSLP &R,
       // Move to the next bundle.
       i += VF - 1;
       Changed = true;
+    } else if (Memoise) {
+      R.recordFailure(Ops);
     }
   }
 
@@ -3777,29 +3884,35 @@ public:
     Builder.setFastMathFlags(Unsafe);
     unsigned i = 0;
 
-    for (; i < NumReducedVals - ReduxWidth + 1; i += ReduxWidth) {
-      V.buildTree(makeArrayRef(&ReducedVals[i], ReduxWidth), ReductionOps);
-
-      // Estimate cost.
-      int Cost = V.getTreeCost() + getReductionCost(TTI, ReducedVals[i]);
-      if (Cost >= -SLPCostThreshold)
-        break;
-
-      DEBUG(dbgs() << "SLP: Vectorizing horizontal reduction at cost:" << Cost
-                   << ". (HorRdx)\n");
-
-      // Vectorize a tree.
-      DebugLoc Loc = cast<Instruction>(ReducedVals[i])->getDebugLoc();
-      Value *VectorizedRoot = V.vectorizeTree();
+    // Reduce the values in chunks of ReduxWidth, then go on with narrower
+    // power-of-two chunks, so that a reduction over a number of values that is
+    // not a power of two is vectorized as far as the cost model allows.
+    for (unsigned Width = ReduxWidth; Width >= 2; Width /= 2) {
+      for (; i + Width <= NumReducedVals; i += Width) {
+        V.buildTree(makeArrayRef(&ReducedVals[i], Width), ReductionOps);
+
+        // Estimate cost.
+        int Cost =
+            V.getTreeCost() + getReductionCost(TTI, ReducedVals[i], Width);
+        if (Cost >= -SLPCostThreshold)
+          break;
 
-      // Emit a reduction.
-      Value *ReducedSubTree = emitReduction(VectorizedRoot, Builder);
-      if (VectorizedTree) {
-        Builder.SetCurrentDebugLocation(Loc);
-        VectorizedTree = createBinOp(Builder, ReductionOpcode, VectorizedTree,
-                                     ReducedSubTree, "bin.rdx");
-      } else
-        VectorizedTree = ReducedSubTree;
+        DEBUG(dbgs() << "SLP: Vectorizing horizontal reduction of width "
+                     << Width << " at cost:" << Cost << ". (HorRdx)\n");
+
+        // Vectorize a tree.
+        DebugLoc Loc = cast<Instruction>(ReducedVals[i])->getDebugLoc();
+        Value *VectorizedRoot = V.vectorizeTree();
+
+        // Emit a reduction.
+        Value *ReducedSubTree = emitReduction(VectorizedRoot, Builder, Width);
+        if (VectorizedTree) {
+          Builder.SetCurrentDebugLocation(Loc);
+          VectorizedTree = createBinOp(Builder, ReductionOpcode, VectorizedTree,
+                                       ReducedSubTree, "bin.rdx");
+        } else
+          VectorizedTree = ReducedSubTree;
+      }
     }
 
     if (VectorizedTree) {
@@ -3827,9 +3940,10 @@ public:
 
 private:
   /// \brief Calculate the cost of a reduction.
-  int getReductionCost(TargetTransformInfo *TTI, Value *FirstReducedVal) {
+  int getReductionCost(TargetTransformInfo *TTI, Value *FirstReducedVal,
+                       unsigned Width) {
     Type *ScalarTy = FirstReducedVal->getType();
-    Type *VecTy = VectorType::get(ScalarTy, ReduxWidth);
+    Type *VecTy = VectorType::get(ScalarTy, Width);
 
     int PairwiseRdxCost = TTI->getReductionCost(ReductionOpcode, VecTy, true);
     int SplittingRdxCost = TTI->getReductionCost(ReductionOpcode, VecTy, false);
@@ -3838,7 +3952,7 @@ private:
     int VecReduxCost = IsPairwiseReduction ? PairwiseRdxCost : SplittingRdxCost;
 
     int ScalarReduxCost =
-        ReduxWidth * TTI->getArithmeticInstrCost(ReductionOpcode, VecTy);
+        Width * TTI->getArithmeticInstrCost(ReductionOpcode, VecTy);
 
     DEBUG(dbgs() << "SLP: Adding cost " << VecReduxCost - ScalarReduxCost
                  << " for reduction that starts with " << *FirstReducedVal
@@ -3856,19 +3970,21 @@ private:
     return Builder.CreateBinOp((Instruction::BinaryOps)Opcode, L, R, Name);
   }
 
-  /// \brief Emit a horizontal reduction of the vectorized value.
-  Value *emitReduction(Value *VectorizedValue, IRBuilder<> &Builder) {
+  /// \brief Emit a horizontal reduction of the vectorized value, which has
+  /// \p Width elements.
+  Value *emitReduction(Value *VectorizedValue, IRBuilder<> &Builder,
+                       unsigned Width) {
     assert(VectorizedValue && "Need to have a vectorized tree node");
-    assert(isPowerOf2_32(ReduxWidth) &&
-           "We only handle power-of-two reductions for now");
+    assert(isPowerOf2_32(Width) &&
+           "Each vector part of a reduction must be a power of two");
 
     Value *TmpVec = VectorizedValue;
-    for (unsigned i = ReduxWidth / 2; i != 0; i >>= 1) {
+    for (unsigned i = Width / 2; i != 0; i >>= 1) {
       if (IsPairwiseReduction) {
         Value *LeftMask =
-          createRdxShuffleMask(ReduxWidth, i, true, true, Builder);
+          createRdxShuffleMask(Width, i, true, true, Builder);
         Value *RightMask =
-          createRdxShuffleMask(ReduxWidth, i, true, false, Builder);
+          createRdxShuffleMask(Width, i, true, false, Builder);
 
         Value *LeftShuf = Builder.CreateShuffleVector(
           TmpVec, UndefValue::get(TmpVec->getType()), LeftMask, "rdx.shuf.l");
@@ -3879,7 +3995,7 @@ private:
                              "bin.rdx");
       } else {
         Value *UpperHalf =
-          createRdxShuffleMask(ReduxWidth, i, false, false, Builder);
+          createRdxShuffleMask(Width, i, false, false, Builder);
         Value *Shuf = Builder.CreateShuffleVector(
           TmpVec, UndefValue::get(TmpVec->getType()), UpperHalf, "rdx.shuf");
         TmpVec = createBinOp(Builder, ReductionOpcode, TmpVec, Shuf, "bin.rdx");
@@ -4000,8 +4116,9 @@ static bool canMatchHorizontalReduction(PHINode *P, BinaryOperator *BI,
     return false;
 
   // If there is a sufficient number of reduction values, reduce
-  // to a nearby power-of-2. Can safely generate oversized
-  // vectors and rely on the backend to split them to legal sizes.
+  // to a nearby power-of-2, and the rest with narrower vectors. Can safely
+  // generate oversized vectors and rely on the backend to split them to legal
+  // sizes.
   HorRdx.ReduxWidth =
     std::max((uint64_t)4, PowerOf2Floor(HorRdx.numReductionValues()));
 
@@ -4062,6 +4179,13 @@ bool SLPVectorizer::vectorizeChainsInBlock(BasicBlock *BB, BoUpSLP &R) {
   VisitedInstrs.clear();
 
   for (BasicBlock::iterator it = BB->begin(), e = BB->end(); it != e; it++) {
+    // Every further seed would only be gathered.
+    if (R.isBudgetExhausted()) {
+      DEBUG(dbgs() << "SLP: Tree budget used up in " << BB->getName()
+                   << ".\n");
+      break;
+    }
+
     // We may go through BB multiple times so skip the one we have checked.
     if (!VisitedInstrs.insert(&*it).second)
       continue;
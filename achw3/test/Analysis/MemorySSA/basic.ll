@@ -0,0 +1,95 @@
+; RUN: opt -basicaa -memoryssa -analyze -verify-memoryssa < %s | FileCheck %s
+
+declare void @clobber()
+declare void @reader() readonly
+declare void @pure() readnone
+
+; CHECK-LABEL: Printing analysis 'Memory SSA' for function 'straight':
+; CHECK: entry:
+; CHECK-NEXT: %p = alloca i32
+; CHECK-NEXT: ; 1 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i32 4, i32* %p
+; CHECK-NEXT: ; MemoryUse(1)
+; CHECK-NEXT: %v = load i32, i32* %p
+; CHECK-NEXT: ; MemoryUse(1)
+; CHECK-NEXT: call void @reader()
+; CHECK-NEXT: call void @pure()
+; CHECK-NEXT: ; 2 = MemoryDef(1)
+; CHECK-NEXT: call void @clobber()
+; CHECK-NEXT: ret i32 %v
+define i32 @straight() {
+entry:
+  %p = alloca i32
+  store i32 4, i32* %p
+  %v = load i32, i32* %p
+  call void @reader()
+  call void @pure()
+  call void @clobber()
+  ret i32 %v
+}
+
+; CHECK-LABEL: Printing analysis 'Memory SSA' for function 'loop':
+; CHECK: entry:
+; CHECK-NEXT: ; 1 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i32 0, i32* %p
+; CHECK: loop:
+; CHECK-NEXT: ; 3 = MemoryPhi({entry,1},{loop,2})
+; CHECK-NEXT: ; MemoryUse(3)
+; CHECK-NEXT: %v = load i32, i32* %p
+; CHECK-NEXT: ; 2 = MemoryDef(3)
+; CHECK-NEXT: store i32 %v, i32* %p
+; CHECK: exit:
+; CHECK-NEXT: ; MemoryUse(2)
+; CHECK-NEXT: %w = load i32, i32* %p
+define i32 @loop(i32* %p, i1 %c) {
+entry:
+  store i32 0, i32* %p
+  br label %loop
+
+loop:
+  %v = load i32, i32* %p
+  store i32 %v, i32* %p
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %w = load i32, i32* %p
+  ret i32 %w
+}
+
+; A block without predecessors reads the state on entry, and its edge into
+; the merge point contributes liveOnEntry.
+; CHECK-LABEL: Printing analysis 'Memory SSA' for function 'diamond':
+; CHECK: left:
+; CHECK-NEXT: ; 1 = MemoryDef(liveOnEntry)
+; CHECK: right:
+; CHECK-NEXT: ; 2 = MemoryDef(liveOnEntry)
+; CHECK: dead:
+; CHECK-NEXT: ; MemoryUse(liveOnEntry)
+; CHECK-NEXT: %d = load i32, i32* %p
+; CHECK-NEXT: ; 3 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i32 %d, i32* %p
+; CHECK: merge:
+; CHECK-NEXT: ; 4 = MemoryPhi({left,1},{right,2},{dead,liveOnEntry})
+; CHECK-NEXT: ; MemoryUse(4)
+; CHECK-NEXT: %m = load i32, i32* %p
+define i32 @diamond(i32* %p, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 1, i32* %p
+  br label %merge
+
+right:
+  store i32 2, i32* %p
+  br label %merge
+
+dead:
+  %d = load i32, i32* %p
+  store i32 %d, i32* %p
+  br label %merge
+
+merge:
+  %m = load i32, i32* %p
+  ret i32 %m
+}
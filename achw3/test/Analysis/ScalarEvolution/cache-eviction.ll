@@ -0,0 +1,43 @@
+; RUN: opt -analyze -scalar-evolution < %s > %t.full
+; RUN: opt -analyze -scalar-evolution -scalar-evolution-max-cache-entries=4 \
+; RUN:   -stats < %s > %t.evict 2> %t.stats
+; RUN: diff %t.full %t.evict
+; RUN: FileCheck %s < %t.stats
+; REQUIRES: asserts
+
+; Dropping the recomputable caches must not change any result.
+
+; CHECK-DAG: Largest SCEV arena of a single function, in KB
+; CHECK-DAG: Largest number of values with a SCEV in a single function
+; CHECK-DAG: Number of times the recomputable SCEV caches were evicted
+
+define void @nest(i32* %a, i32 %n, i32 %m) {
+entry:
+  %n.pos = icmp sgt i32 %n, 0
+  br i1 %n.pos, label %outer, label %exit
+
+outer:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %row = mul nsw i32 %i, %m
+  br label %inner
+
+inner:
+  %j = phi i32 [ 0, %outer ], [ %j.next, %inner ]
+  %idx = add nsw i32 %row, %j
+  %idx.ext = sext i32 %idx to i64
+  %p = getelementptr inbounds i32, i32* %a, i64 %idx.ext
+  %v = load i32, i32* %p
+  %v.inc = add i32 %v, %j
+  store i32 %v.inc, i32* %p
+  %j.next = add nuw nsw i32 %j, 1
+  %j.cond = icmp slt i32 %j.next, %m
+  br i1 %j.cond, label %inner, label %outer.latch
+
+outer.latch:
+  %i.next = add nuw nsw i32 %i, 1
+  %i.cond = icmp slt i32 %i.next, %n
+  br i1 %i.cond, label %outer, label %exit
+
+exit:
+  ret void
+}
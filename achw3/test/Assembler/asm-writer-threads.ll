@@ -0,0 +1,67 @@
+; RUN: llvm-as < %s | llvm-dis -preserve-ll-uselistorder > %t.serial
+; RUN: llvm-as < %s | llvm-dis -preserve-ll-uselistorder -asm-writer-threads=4 > %t.parallel
+; RUN: diff %t.serial %t.parallel
+; RUN: FileCheck %s < %t.parallel
+
+; Printing functions on several threads must give exactly the serial output,
+; including metadata, attribute group and use-list numbering.
+
+; CHECK: define i32 @f32(
+; CHECK: uselistorder
+; CHECK: define void @calls()
+; CHECK: call void @g() #1
+; CHECK: define internal void @0()
+; CHECK: attributes #0 = { nounwind }
+; CHECK: attributes #1 = { noinline }
+; CHECK: !0 = !{!"first"}
+
+@glob = global i32 0
+
+define i32 @f32(i32 %a, i32 %b, i32 %c, i32 %d) {
+entry:
+  br label %first
+
+; <label 0>:
+  %eh = mul i32 %e, %1
+  %sum = add i32 %eh, %ef
+  br label %preexit
+
+preexit:
+  %product = phi i32 [%ef, %first], [%sum, %0]
+  %backto0 = icmp slt i32 %product, -9
+  br i1 %backto0, label %0, label %exit
+
+exit:
+  ret i32 %product
+
+first:
+  %e = add i32 %a, 7
+  %f = add i32 %b, 7
+  %g = add i32 %c, 8
+  %1 = add i32 %d, 8
+  %ef = mul i32 %e, %f
+  %g1 = mul i32 %g, %1
+  %goto0 = icmp slt i32 %g1, -9
+  br i1 %goto0, label %0, label %preexit
+
+  uselistorder i32 %e, { 1, 0 }
+}
+
+declare void @g() nounwind
+
+define void @calls() {
+  %1 = load i32, i32* @glob, !note !0
+  call void @g() noinline
+  call void @0()
+  store i32 %1, i32* @glob, !note !1
+  ret void
+}
+
+define internal void @0() {
+  %x = load i32, i32* @glob, !note !2
+  ret void
+}
+
+!0 = !{!"first"}
+!1 = !{i32 0, i32 10}
+!2 = !{!"second"}
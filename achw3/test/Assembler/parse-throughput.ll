@@ -0,0 +1,13 @@
+; RUN: llvm-as -parse-throughput -disable-output < %s 2>&1 | FileCheck %s
+
+; CHECK: parsed {{[0-9.]+}} MB in {{[0-9.]+}} s ({{[0-9.]+}} MB/s)
+
+@str = private constant [13 x i8] c"hello, world\00"
+
+define i32 @f(i32 %a) {
+entry:                                  ; a comment between tokens
+  %b = add i32 %a, 1
+  br label %exit
+exit:
+  ret i32 %b
+}
@@ -0,0 +1,56 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -ext-tsp-block-placement \
+; RUN:   | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -ext-tsp-block-placement \
+; RUN:   -pass-remarks-analysis=block-placement -o /dev/null 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=REMARK
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -ext-tsp-block-placement \
+; RUN:   -ext-tsp-block-placement-max-blocks=2 \
+; RUN:   -pass-remarks-analysis=block-placement -o /dev/null 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=LARGE
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown \
+; RUN:   -pass-remarks-analysis=block-placement -o /dev/null 2>&1 | count 0
+
+; The rarely taken block in the middle of the hot loop is moved past the
+; return, so the loop body falls through to its latch.
+
+; REMARK: remark: {{.*}}layout score {{[0-9.]+}} (input {{[0-9.]+}}) using ext-TSP placement
+; LARGE: remark: {{.*}}layout score {{[0-9.]+}} (input {{[0-9.]+}}) using branch probability placement
+
+; Layouts are only scored with ext-TSP placement on, so there is no remark
+; without it.
+
+; CHECK-LABEL: hot_loop:
+; CHECK: callq hot
+; CHECK: retq
+; CHECK: callq cold
+
+declare void @hot()
+declare void @cold()
+
+define void @hot_loop(i32 %n, i32* %p) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  call void @hot()
+  %q = getelementptr i32, i32* %p, i32 %i
+  %v = load i32, i32* %q
+  %rare = icmp eq i32 %v, 0
+  br i1 %rare, label %slow, label %latch, !prof !0
+
+slow:
+  call void @cold()
+  br label %latch
+
+latch:
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit, !prof !1
+
+exit:
+  ret void
+}
+
+!0 = !{!"branch_weights", i32 1, i32 1000}
+!1 = !{!"branch_weights", i32 1000, i32 1}
@@ -0,0 +1,22 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -combiner-topological-order \
+; RUN:   | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -combiner-topological-order \
+; RUN:   -stats 2>&1 | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts
+
+; Visiting operands before their users gives the same result as the default
+; worklist order.
+
+; STATS: dagcombine - Number of dag nodes visited by the combiner
+
+; CHECK-LABEL: fold_chain:
+; CHECK: andl $15
+; CHECK-NOT: and
+; CHECK: retq
+define i32 @fold_chain(i32 %x) {
+  %a = and i32 %x, 255
+  %b = and i32 %a, 63
+  %c = and i32 %b, 15
+  ret i32 %c
+}
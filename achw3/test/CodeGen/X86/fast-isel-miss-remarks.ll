@@ -0,0 +1,57 @@
+; RUN: llc < %s -O0 -mtriple=x86_64-unknown-unknown -mattr=+avx \
+; RUN:   -pass-remarks-missed=isel -o /dev/null 2>&1 | FileCheck %s
+; RUN: llc < %s -O0 -mtriple=x86_64-unknown-unknown -mattr=+avx \
+; RUN:   | FileCheck %s --check-prefix=ASM
+
+; Each instruction fast-isel gives up on is reported with its opcode and the
+; type that made it bail.
+
+; CHECK: remark: {{.*}}FastISel missed trunc of type i128; using SelectionDAG instead
+define i64 @miss_i128(i128* %p) {
+  %a = load i128, i128* %p
+  %t = trunc i128 %a to i64
+  ret i64 %t
+}
+
+; CHECK: remark: {{.*}}FastISel missed shufflevector of type <4 x i32>; using SelectionDAG instead
+define void @miss_shuffle(<4 x i32>* %p) {
+  %a = load <4 x i32>, <4 x i32>* %p
+  %s = shufflevector <4 x i32> %a, <4 x i32> undef, <4 x i32> <i32 3, i32 2, i32 1, i32 0>
+  store <4 x i32> %s, <4 x i32>* %p
+  ret void
+}
+
+; CHECK: remark: {{.*}}FastISel missed call to g of type void; using SelectionDAG instead
+declare ghccc void @g()
+define void @miss_call() {
+  call ghccc void @g()
+  ret void
+}
+
+; 256-bit AVX loads and stores, vector selects on a scalar condition,
+; memmove and preserve_most calls are all handled without a fallback.
+; CHECK-NOT: remark
+declare void @llvm.memmove.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1)
+declare preserve_mostcc void @pm()
+
+; ASM-LABEL: covered:
+; ASM-DAG: vmovaps (%rdi), %ymm
+; ASM-DAG: vmovups (%rsi), %ymm
+; ASM: vmovaps %ymm{{[0-9]+}}, (%r{{[a-z0-9]+}})
+; ASM: callq memmove
+; ASM: callq pm
+define void @covered(<8 x float>* %p, <8 x float>* %q, <4 x i32>* %r, i32 %c,
+                     i8* %d, i8* %s, i64 %n) {
+  %cond = icmp eq i32 %c, 0
+  %a = load <8 x float>, <8 x float>* %p, align 32
+  %b = load <8 x float>, <8 x float>* %q, align 4
+  %sel = select i1 %cond, <8 x float> %a, <8 x float> %b
+  store <8 x float> %sel, <8 x float>* %p, align 32
+  %x = load <4 x i32>, <4 x i32>* %r, align 16
+  %y = add <4 x i32> %x, %x
+  %z = select i1 %cond, <4 x i32> %x, <4 x i32> %y
+  store <4 x i32> %z, <4 x i32>* %r, align 16
+  call void @llvm.memmove.p0i8.p0i8.i64(i8* %d, i8* %s, i64 %n, i32 1, i1 false)
+  call preserve_mostcc void @pm()
+  ret void
+}
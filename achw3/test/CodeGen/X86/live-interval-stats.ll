@@ -0,0 +1,29 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -stats 2>&1 | FileCheck %s
+; REQUIRES: asserts
+
+; LiveIntervals reports how many of the virtual register intervals it builds
+; spill out of their inline segment and value number storage, and how many
+; are local to one block.
+
+; CHECK-DAG: {{[0-9]+}} regalloc - Number of virtual register intervals computed
+; CHECK-DAG: {{[0-9]+}} regalloc - Number of segments in computed virtual intervals
+; CHECK-DAG: {{[0-9]+}} regalloc - Number of computed virtual intervals that do not fit inline
+; CHECK-DAG: {{[0-9]+}} regalloc - Number of computed virtual intervals local to one block
+
+define i32 @f(i32 %n, i32* %p) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %q = getelementptr i32, i32* %p, i32 %i
+  %v = load i32, i32* %q
+  %s.next = add i32 %s, %v
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
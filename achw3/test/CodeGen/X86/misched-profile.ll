@@ -0,0 +1,50 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -misched=profile -stats 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=STATS
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -misched=profile \
+; RUN:   -debug-only=misched -o /dev/null 2>&1 | FileCheck %s --check-prefix=DEBUG
+; REQUIRES: asserts
+
+; The loop body is hot and gets the lookahead policy; the error path almost
+; never runs and keeps its source order.
+
+; STATS: {{[0-9]+}} misched - Number of cold regions left in source order
+; STATS: {{[0-9]+}} misched - Number of hot regions scheduled with lookahead
+
+; DEBUG: ForceLatencyHeuristic=1 EnableLookahead=1
+; DEBUG: Region left in source order
+
+declare void @error(i32, i32)
+
+define i32 @f(i32* %p, i32 %n, i32 %a, i32 %b) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %q = getelementptr i32, i32* %p, i32 %i
+  %v = load i32, i32* %q
+  %m = mul i32 %v, %a
+  %t = add i32 %m, %s
+  %s.next = xor i32 %t, %b
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %done, !prof !0
+
+done:
+  %bad = icmp eq i32 %s.next, 0
+  br i1 %bad, label %fail, label %exit, !prof !1
+
+fail:
+  %x = mul i32 %a, %b
+  %y = add i32 %x, %n
+  %z = sub i32 %y, %a
+  call void @error(i32 %z, i32 %y)
+  br label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+!0 = !{!"branch_weights", i32 1000, i32 1}
+!1 = !{!"branch_weights", i32 1, i32 1000}
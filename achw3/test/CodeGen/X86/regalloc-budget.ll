@@ -0,0 +1,74 @@
+; RUN: llc < %s -mtriple=i686-unknown-unknown -regalloc=greedy \
+; RUN:   -regalloc-eviction-budget=1 -regalloc-split-budget=1 \
+; RUN:   -pass-remarks-analysis=regalloc -o /dev/null 2>&1 | FileCheck %s
+; RUN: llc < %s -mtriple=i686-unknown-unknown -regalloc=greedy \
+; RUN:   -regalloc-intf-cache-budget=1 \
+; RUN:   -pass-remarks-analysis=regalloc -o /dev/null 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=INTF
+; RUN: llc < %s -mtriple=i686-unknown-unknown -regalloc=greedy \
+; RUN:   -pass-remarks-analysis=regalloc -o /dev/null 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=DEFAULT --allow-empty
+
+; With more values live across the loop than i686 has registers, the greedy
+; allocator has to evict and split. Once a budget runs out it falls back to a
+; cheaper strategy, says so once, and still allocates the function.
+
+; CHECK-DAG: remark: {{.*}}eviction budget exhausted; remaining live ranges are split or spilled instead
+; CHECK-DAG: remark: {{.*}}live range splitting budget exhausted; remaining live ranges are spilled without splitting
+; INTF: remark: {{.*}}interference cache budget exhausted; region splitting is disabled for the rest of the function
+; DEFAULT-NOT: budget exhausted
+
+declare void @use(i32)
+
+define i32 @pressure(i32* %p, i32 %n) {
+entry:
+  %p1 = getelementptr i32, i32* %p, i32 1
+  %p2 = getelementptr i32, i32* %p, i32 2
+  %p3 = getelementptr i32, i32* %p, i32 3
+  %p4 = getelementptr i32, i32* %p, i32 4
+  %p5 = getelementptr i32, i32* %p, i32 5
+  %p6 = getelementptr i32, i32* %p, i32 6
+  %p7 = getelementptr i32, i32* %p, i32 7
+  %a0 = load volatile i32, i32* %p
+  %a1 = load volatile i32, i32* %p1
+  %a2 = load volatile i32, i32* %p2
+  %a3 = load volatile i32, i32* %p3
+  %a4 = load volatile i32, i32* %p4
+  %a5 = load volatile i32, i32* %p5
+  %a6 = load volatile i32, i32* %p6
+  %a7 = load volatile i32, i32* %p7
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %t0 = add i32 %s, %a0
+  %t1 = xor i32 %t0, %a1
+  %t2 = mul i32 %t1, %a2
+  %t3 = sub i32 %t2, %a3
+  %c = icmp slt i32 %t3, %a4
+  br i1 %c, label %call, label %latch
+
+call:
+  call void @use(i32 %t3)
+  br label %latch
+
+latch:
+  %t4 = phi i32 [ %t3, %loop ], [ %a5, %call ]
+  %t5 = or i32 %t4, %a6
+  %s.next = add i32 %t5, %a7
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r0 = add i32 %s.next, %a0
+  %r1 = add i32 %r0, %a1
+  %r2 = add i32 %r1, %a2
+  %r3 = add i32 %r2, %a3
+  %r4 = add i32 %r3, %a4
+  %r5 = add i32 %r4, %a5
+  %r6 = add i32 %r5, %a6
+  %r7 = add i32 %r6, %a7
+  ret i32 %r7
+}
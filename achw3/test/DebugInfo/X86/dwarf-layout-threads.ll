@@ -0,0 +1,61 @@
+; RUN: llc -mtriple=x86_64-linux-gnu -O0 -filetype=obj %s -o %t.serial
+; RUN: llc -mtriple=x86_64-linux-gnu -O0 -filetype=obj -dwarf-layout-threads=4 %s -o %t.parallel
+; RUN: cmp %t.serial %t.parallel
+; RUN: llvm-dwarfdump -debug-dump=info %t.parallel | FileCheck %s
+
+; Laying out the DIEs on several threads must give exactly the serial result,
+; across units and with references between DIEs.
+
+; CHECK: DW_TAG_compile_unit
+; CHECK: DW_TAG_subprogram
+; CHECK: DW_AT_name {{.*}} "f"
+; CHECK: DW_TAG_compile_unit
+; CHECK: DW_TAG_subprogram
+; CHECK: DW_AT_name {{.*}} "g"
+
+@a = global i32 0, align 4
+@b = global i64 0, align 8
+
+define i32 @f(i32 %x) !dbg !4 {
+entry:
+  %x.addr = alloca i32, align 4
+  store i32 %x, i32* %x.addr, align 4
+  call void @llvm.dbg.declare(metadata i32* %x.addr, metadata !20, metadata !DIExpression()), !dbg !21
+  %0 = load i32, i32* %x.addr, align 4, !dbg !21
+  ret i32 %0, !dbg !21
+}
+
+define i64 @g() !dbg !12 {
+entry:
+  %0 = load i64, i64* @b, align 8, !dbg !22
+  ret i64 %0, !dbg !22
+}
+
+declare void @llvm.dbg.declare(metadata, metadata, metadata)
+
+!llvm.dbg.cu = !{!0, !10}
+!llvm.module.flags = !{!19}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, emissionKind: 1, enums: !2, retainedTypes: !2, subprograms: !3, globals: !8)
+!1 = !DIFile(filename: "a.c", directory: "/tmp")
+!2 = !{}
+!3 = !{!4}
+!4 = distinct !DISubprogram(name: "f", scope: !1, file: !1, line: 2, type: !5, isLocal: false, isDefinition: true, scopeLine: 2, flags: DIFlagPrototyped, isOptimized: false, variables: !2)
+!5 = !DISubroutineType(types: !6)
+!6 = !{!7, !7}
+!7 = !DIBasicType(name: "int", size: 32, align: 32, encoding: DW_ATE_signed)
+!8 = !{!9}
+!9 = !DIGlobalVariable(name: "a", scope: !0, file: !1, line: 1, type: !7, isLocal: false, isDefinition: true, variable: i32* @a)
+!10 = distinct !DICompileUnit(language: DW_LANG_C99, file: !11, producer: "clang", isOptimized: false, emissionKind: 1, enums: !2, retainedTypes: !2, subprograms: !16, globals: !17)
+!11 = !DIFile(filename: "b.c", directory: "/tmp")
+!12 = distinct !DISubprogram(name: "g", scope: !11, file: !11, line: 2, type: !13, isLocal: false, isDefinition: true, scopeLine: 2, isOptimized: false, variables: !2)
+!13 = !DISubroutineType(types: !14)
+!14 = !{!15}
+!15 = !DIBasicType(name: "long", size: 64, align: 64, encoding: DW_ATE_signed)
+!16 = !{!12}
+!17 = !{!18}
+!18 = !DIGlobalVariable(name: "b", scope: !10, file: !11, line: 1, type: !15, isLocal: false, isDefinition: true, variable: i64* @b)
+!19 = !{i32 2, !"Debug Info Version", i32 3}
+!20 = !DILocalVariable(name: "x", arg: 1, scope: !4, file: !1, line: 2, type: !7)
+!21 = !DILocation(line: 2, scope: !4)
+!22 = !DILocation(line: 2, scope: !12)
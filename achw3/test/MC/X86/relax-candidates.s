@@ -0,0 +1,22 @@
+# RUN: llvm-mc -filetype=obj -triple x86_64-pc-linux-gnu -stats %s -o %t 2>&1 \
+# RUN:   | FileCheck %s --check-prefix=STATS
+# RUN: llvm-objdump -d %t | FileCheck %s
+# REQUIRES: asserts
+
+# Only the two jumps can change size, and the first one is dropped from the
+# candidates once it has been relaxed, so later passes check just the second.
+
+# STATS: 4 assembler - Number of fragment relaxation checks
+# STATS: 2 assembler - Number of fragments that may need relaxation
+# STATS: 1 assembler - Number of relaxed instructions
+
+# CHECK: 0: e9 c8 00 00 00 jmp 200
+# CHECK: cd: eb 00 jmp 0
+
+	.text
+	jmp	foo
+	.space	200, 0x90
+foo:
+	jmp	bar
+bar:
+	retq
@@ -0,0 +1,43 @@
+; RUN: opt < %s -cgscc-dag-schedule -inline -S | FileCheck %s
+; RUN: opt < %s -cgscc-dag-schedule -functionattrs -stats -disable-output 2>&1 | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts
+
+; @a and @b do not depend on each other, and neither do @c and @d, so two
+; SCCs are ready at a time. The longest chain of callers is
+; @a, @c, @main and the external calling node.
+
+; STATS-DAG: 2 cgscc-passmgr - Maximum number of SCCs ready to run at once
+; STATS-DAG: 4 cgscc-passmgr - Number of SCCs on the longest chain of callers
+
+; Everything is still inlined bottom-up.
+; CHECK-LABEL: define i32 @main(
+; CHECK-NOT: call
+; CHECK: ret i32
+define i32 @main(i32 %x) {
+  %c = call i32 @c(i32 %x)
+  %d = call i32 @d(i32 %x)
+  %r = add i32 %c, %d
+  ret i32 %r
+}
+
+define internal i32 @c(i32 %x) {
+  %a = call i32 @a(i32 %x)
+  %r = mul i32 %a, 3
+  ret i32 %r
+}
+
+define internal i32 @d(i32 %x) {
+  %b = call i32 @b(i32 %x)
+  %r = mul i32 %b, 5
+  ret i32 %r
+}
+
+define internal i32 @a(i32 %x) {
+  %r = add i32 %x, 1
+  ret i32 %r
+}
+
+define internal i32 @b(i32 %x) {
+  %r = add i32 %x, 2
+  ret i32 %r
+}
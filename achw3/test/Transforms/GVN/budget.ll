@@ -0,0 +1,114 @@
+; RUN: opt < %s -basicaa -gvn -S | FileCheck %s --check-prefix=FULL
+; RUN: opt < %s -basicaa -gvn -gvn-max-nonlocal-blocks=3 -gvn-max-pre-attempts=1 \
+; RUN:   -pass-remarks-analysis=gvn -S 2>&1 | FileCheck %s --check-prefix=LIMIT
+
+; With the default budgets every non-local load and every partially redundant
+; add is eliminated.  Once a budget runs out GVN still does local work, but
+; skips further non-local loads or PRE, and says so.
+
+; LIMIT-DAG: remark: {{.*}}non-local load budget exhausted; only local loads are eliminated in the rest of the function
+; LIMIT-DAG: remark: {{.*}}PRE budget exhausted; no more PRE in the rest of the function
+
+; The walk for %b visits three blocks, which is all of the non-local budget,
+; so %d is left alone.
+; FULL-LABEL: @nonlocal(
+; FULL: merge:
+; FULL-NOT: load
+; FULL: ret i32
+; LIMIT-LABEL: @nonlocal(
+; LIMIT-NOT: %b = load
+; LIMIT: %d = load i32, i32* %q
+define i32 @nonlocal(i32* %p, i32* %q, i1 %cond) {
+entry:
+  %a = load i32, i32* %p
+  %c = load i32, i32* %q
+  br i1 %cond, label %then, label %merge
+
+then:
+  br label %merge
+
+merge:
+  %b = load i32, i32* %p
+  br i1 %cond, label %then2, label %merge2
+
+then2:
+  br label %merge2
+
+merge2:
+  %d = load i32, i32* %q
+  %r = add i32 %a, %b
+  %s = add i32 %c, %d
+  %t = add i32 %r, %s
+  ret i32 %t
+}
+
+; The walk for %y crosses two empty diamonds.  It finds a single dependency,
+; but visits more blocks than the budget allows, so it gives up.
+; FULL-LABEL: @long_walk(
+; FULL: %x = load i32, i32* %p
+; FULL-NOT: load
+; FULL: ret i32
+; LIMIT-LABEL: @long_walk(
+; LIMIT: %y = load i32, i32* %p
+define i32 @long_walk(i32* %p, i1 %c) {
+entry:
+  %x = load i32, i32* %p
+  br i1 %c, label %t1, label %f1
+
+t1:
+  br label %j1
+
+f1:
+  br label %j1
+
+j1:
+  br i1 %c, label %t2, label %f2
+
+t2:
+  br label %j2
+
+f2:
+  br label %j2
+
+j2:
+  %y = load i32, i32* %p
+  %r = add i32 %x, %y
+  ret i32 %r
+}
+
+; Only real PRE candidates are charged: the adds in %entry have no
+; predecessors to look at, so the single attempt goes to %y and %w is left
+; alone.
+; FULL-LABEL: @pre(
+; FULL: %.pre = add i32 %x, 1
+; FULL: %.pre1 = add i32 %x, 2
+; LIMIT-LABEL: @pre(
+; LIMIT: %.pre = add i32 %x, 1
+; LIMIT-NOT: .pre1
+; LIMIT: merge2:
+; LIMIT-NEXT: %w = add i32 %x, 2
+define i32 @pre(i32 %x, i32 %z, i1 %cond) {
+entry:
+  %e1 = add i32 %z, 3
+  %e2 = add i32 %z, 4
+  %e = add i32 %e1, %e2
+  br i1 %cond, label %then, label %merge
+
+then:
+  %t = add i32 %x, 1
+  br label %merge
+
+merge:
+  %y = add i32 %x, 1
+  br i1 %cond, label %then2, label %merge2
+
+then2:
+  %v = add i32 %x, 2
+  br label %merge2
+
+merge2:
+  %w = add i32 %x, 2
+  %r = add i32 %y, %w
+  %s = add i32 %r, %e
+  ret i32 %s
+}
@@ -0,0 +1,181 @@
+; RUN: opt < %s -hot-cold-split -S | FileCheck %s
+; RUN: opt < %s -hot-cold-split -pass-remarks=hotcoldsplit -disable-output 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=REMARK
+
+target triple = "x86_64-unknown-linux-gnu"
+
+; REMARK: remark: {{.*}}outlined 1 cold blocks into hot_error
+; REMARK: remark: {{.*}}outlined 1 cold blocks into eh_cleanup
+; REMARK: remark: {{.*}}outlined 2 cold blocks into phi_exit_cold1
+; REMARK: remark: {{.*}}outlined 1 cold blocks into dbg_error
+; REMARK-NOT: remark
+
+declare void @report(i32)
+declare void @fail() noreturn
+declare void @may_throw()
+declare i32 @__gxx_personality_v0(...)
+declare void @llvm.dbg.value(metadata, i64, metadata, metadata)
+
+; The error path never ran in the profile, so it moves out of line.
+; CHECK-LABEL: define i32 @hot(
+; CHECK: call void @hot_error(
+; CHECK-NOT: call void @report
+; CHECK: ret i32
+define i32 @hot(i32 %x) #0 !prof !0 {
+entry:
+  %c = icmp slt i32 %x, 0
+  br i1 %c, label %error, label %ok, !prof !1
+
+error:
+  %a = add i32 %x, 1
+  %b = mul i32 %a, 3
+  call void @report(i32 %b)
+  call void @report(i32 %a)
+  call void @fail()
+  unreachable
+
+ok:
+  %r = shl i32 %x, 1
+  ret i32 %r
+}
+
+; The landing pad and the resume stay, the cold cleanup between them moves.
+; CHECK-LABEL: define void @eh(
+; CHECK: landingpad
+; CHECK-NEXT: cleanup
+; CHECK: call void @eh_cleanup(
+; CHECK: resume
+define void @eh(i32 %x) personality i32 (...)* @__gxx_personality_v0 !prof !0 {
+entry:
+  invoke void @may_throw()
+          to label %cont unwind label %lpad, !prof !2
+
+cont:
+  ret void
+
+lpad:
+  %lp = landingpad { i8*, i32 }
+          cleanup
+  br label %cleanup
+
+cleanup:
+  %a = add i32 %x, 1
+  %b = mul i32 %a, 3
+  call void @report(i32 %b)
+  call void @report(i32 %a)
+  br label %resume
+
+resume:
+  resume { i8*, i32 } %lp
+}
+
+; Both cold blocks feed the PHI in %exit. They are merged in a new block in
+; the region, so only one value comes back from the outlined function.
+; CHECK-LABEL: define i32 @phi_exit(
+; CHECK: call void @phi_exit_cold1(i32 %x, i32* %[[OUT:.*]])
+; CHECK: %[[RELOAD:.*]] = load i32, i32* %[[OUT]]
+; CHECK: %r = phi i32 [ 0, %entry ], [ %[[RELOAD]], %codeRepl ]
+define i32 @phi_exit(i32 %x) !prof !0 {
+entry:
+  %c = icmp slt i32 %x, 0
+  br i1 %c, label %cold1, label %exit, !prof !1
+
+cold1:
+  %a = add i32 %x, 1
+  call void @report(i32 %a)
+  %c2 = icmp eq i32 %a, 0
+  br i1 %c2, label %cold2, label %exit
+
+cold2:
+  %b = mul i32 %a, 3
+  call void @report(i32 %b)
+  br label %exit
+
+exit:
+  %r = phi i32 [ 0, %entry ], [ %a, %cold1 ], [ %b, %cold2 ]
+  ret i32 %r
+}
+
+; The outlined function gets a subprogram of its own, and the call to it the
+; location of the code it replaces.
+; CHECK-LABEL: define i32 @dbg(
+; CHECK: call void @dbg_error(i32 %x), !dbg ![[CALL:[0-9]+]]
+define i32 @dbg(i32 %x) !prof !0 !dbg !5 {
+entry:
+  %c = icmp slt i32 %x, 0, !dbg !10
+  br i1 %c, label %error, label %ok, !prof !1, !dbg !10
+
+error:
+  %a = add i32 %x, 1, !dbg !11
+  call void @llvm.dbg.value(metadata i32 %a, i64 0, metadata !13, metadata !14), !dbg !11
+  %b = mul i32 %a, 3, !dbg !12
+  call void @report(i32 %b), !dbg !12
+  call void @report(i32 %a), !dbg !12
+  call void @fail(), !dbg !12
+  unreachable, !dbg !12
+
+ok:
+  ret i32 %x, !dbg !10
+}
+
+; Without an entry count there is no profile to go by.
+; CHECK-LABEL: define i32 @unprofiled(
+; CHECK: call void @report
+define i32 @unprofiled(i32 %x) {
+entry:
+  %c = icmp slt i32 %x, 0
+  br i1 %c, label %error, label %ok, !prof !1
+
+error:
+  %a = add i32 %x, 1
+  %b = mul i32 %a, 3
+  call void @report(i32 %b)
+  call void @report(i32 %a)
+  call void @fail()
+  unreachable
+
+ok:
+  ret i32 %x
+}
+
+; CHECK: define internal void @hot_error(i32 {{.*}}) #[[COLD:[0-9]+]] section ".text.unlikely"
+; CHECK: define internal void @eh_cleanup(i32 {{.*}}) #{{[0-9]+}} section ".text.unlikely"
+; CHECK: define internal void @phi_exit_cold1(i32 %x, i32* %{{.*}}) #{{[0-9]+}} section ".text.unlikely"
+; CHECK: store i32 %[[MERGED:.*]], i32*
+; CHECK: exit.cold:
+; CHECK-NEXT: %[[MERGED]] = phi i32 [ %b, %cold2 ], [ %a, %cold1 ]
+; CHECK: define internal void @dbg_error(i32 %x) #{{[0-9]+}} section ".text.unlikely" !dbg ![[SP:[0-9]+]]
+; CHECK-NOT: llvm.dbg.value
+; CHECK: %a = add i32 %x, 1, !dbg ![[LOC:[0-9]+]]
+; CHECK-NOT: llvm.dbg.value
+; CHECK: unreachable
+; CHECK: attributes #[[COLD]] = { cold minsize noinline {{.*}}uwtable "target-cpu"="x86-64" }
+
+attributes #0 = { uwtable "target-cpu"="x86-64" }
+
+!0 = !{!"function_entry_count", i64 1000}
+!1 = !{!"branch_weights", i32 0, i32 1000}
+!2 = !{!"branch_weights", i32 1000, i32 0}
+
+; CHECK: subprograms: ![[SPS:[0-9]+]]
+; CHECK-DAG: ![[SPS]] = !{![[OLD:[0-9]+]], ![[SP]]}
+; CHECK-DAG: ![[OLD]] = distinct !DISubprogram(name: "dbg",
+; CHECK-DAG: ![[SP]] = distinct !DISubprogram(name: "dbg_error", linkageName: "dbg_error", scope: ![[FILE:[0-9]+]], file: ![[FILE]], line: 3, type: !{{[0-9]+}}, isLocal: true, isDefinition: true, scopeLine: 3, flags: DIFlagArtificial, isOptimized: true)
+; CHECK-DAG: ![[CALL]] = !DILocation(line: 3, column: 7, scope: ![[OLD]])
+; CHECK-DAG: ![[LOC]] = !DILocation(line: 3, column: 7, scope: ![[SP]])
+
+!llvm.dbg.cu = !{!3}
+!llvm.module.flags = !{!15}
+
+!3 = distinct !DICompileUnit(language: DW_LANG_C99, producer: "clang", isOptimized: true, emissionKind: 1, file: !4, subprograms: !{!5})
+!4 = !DIFile(filename: "dbg.c", directory: "/tmp")
+!5 = distinct !DISubprogram(name: "dbg", scope: !4, file: !4, line: 1, type: !6, isLocal: false, isDefinition: true, scopeLine: 1, flags: DIFlagPrototyped, isOptimized: true)
+!6 = !DISubroutineType(types: !7)
+!7 = !{!8, !8}
+!8 = !DIBasicType(name: "int", size: 32, align: 32, encoding: DW_ATE_signed)
+!10 = !DILocation(line: 2, column: 7, scope: !5)
+!11 = !DILocation(line: 3, column: 7, scope: !5)
+!12 = !DILocation(line: 4, column: 5, scope: !5)
+!13 = !DILocalVariable(name: "a", scope: !5, file: !4, line: 3, type: !8)
+!14 = !DIExpression()
+!15 = !{i32 2, !"Debug Info Version", i32 3}
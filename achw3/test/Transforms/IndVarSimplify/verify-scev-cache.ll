@@ -0,0 +1,35 @@
+; RUN: opt < %s -S -indvars -verify-scev-cache | FileCheck %s
+; RUN: opt < %s -disable-output -indvars -stats 2>&1 | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts
+
+; IndVars rewrites the induction variable and forgets the loop several times.
+; The invalidation walks stop at the loads, and the values computed from them
+; stay cached; -verify-scev-cache checks that all cached SCEVs still match a
+; fresh computation afterwards.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+; CHECK-LABEL: @sum(
+; CHECK: %indvars.iv = phi i64
+; STATS: def-use invalidation walks stopped at opaque values
+define i32 @sum(i32* %p, i32 %n) {
+entry:
+  %cmp0 = icmp sgt i32 %n, 0
+  br i1 %cmp0, label %loop, label %exit
+
+loop:
+  %iv = phi i32 [ 0, %entry ], [ %iv.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %idx = sext i32 %iv to i64
+  %gep = getelementptr inbounds i32, i32* %p, i64 %idx
+  %ld = load i32, i32* %gep
+  %scaled = mul i32 %ld, 3
+  %acc.next = add i32 %acc, %scaled
+  %iv.next = add nsw i32 %iv, 1
+  %cmp = icmp slt i32 %iv.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %r = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  ret i32 %r
+}
@@ -0,0 +1,99 @@
+; RUN: opt < %s -priority-inline -priority-inline-budget=30 -priority-inline-min-budget=0 -S | FileCheck %s --check-prefix=SMALL
+; RUN: opt < %s -priority-inline -priority-inline-budget=100 -priority-inline-min-budget=0 -S | FileCheck %s --check-prefix=LARGE
+; RUN: opt < %s -priority-inline -priority-inline-budget=0 -priority-inline-min-budget=0 -S | FileCheck %s --check-prefix=NONE
+; RUN: opt < %s -priority-inline -S | FileCheck %s --check-prefix=LARGE
+
+; The two callees are the same size, so with room for only one of them the
+; call that runs more often is inlined, wherever it is in the module. A call
+; that never ran in the profile is not inlined at all. A call that does not
+; fit what is left of the budget does not stop a smaller one from being inlined
+; after it, and always-inline calls are inlined whatever the budget. The
+; default budget of a module this small is its floor, which fits every call.
+
+define i32 @callee_a(i32 %x) {
+  %a = mul i32 %x, %x
+  %b = add i32 %a, 3
+  %c = xor i32 %b, %x
+  %d = sub i32 %c, 1
+  ret i32 %d
+}
+
+define i32 @callee_b(i32 %x) {
+  %a = mul i32 %x, 7
+  %b = add i32 %a, %x
+  %c = xor i32 %b, 5
+  %d = sub i32 %c, %x
+  ret i32 %d
+}
+
+; SMALL-LABEL: @cold_caller(
+; SMALL: call i32 @callee_b
+; LARGE-LABEL: @cold_caller(
+; LARGE-NOT: call
+; LARGE: ret i32
+define i32 @cold_caller(i32 %x) !prof !0 {
+  %r = call i32 @callee_b(i32 %x)
+  ret i32 %r
+}
+
+; SMALL-LABEL: @hot_caller(
+; SMALL-NOT: call
+; SMALL: ret i32
+; LARGE-LABEL: @hot_caller(
+; LARGE-NOT: call
+; LARGE: ret i32
+define i32 @hot_caller(i32 %x) !prof !1 {
+  %r = call i32 @callee_a(i32 %x)
+  ret i32 %r
+}
+
+; SMALL-LABEL: @never_caller(
+; SMALL: call i32 @callee_b
+; LARGE-LABEL: @never_caller(
+; LARGE: call i32 @callee_b
+define i32 @never_caller(i32 %x) !prof !2 {
+  %r = call i32 @callee_b(i32 %x)
+  ret i32 %r
+}
+
+define i32 @tiny(i32 %x) {
+  %a = add i32 %x, 1
+  ret i32 %a
+}
+
+; SMALL-LABEL: @lukewarm_caller(
+; SMALL-NOT: call
+; SMALL: ret i32
+; LARGE-LABEL: @lukewarm_caller(
+; LARGE-NOT: call
+; LARGE: ret i32
+; NONE-LABEL: @lukewarm_caller(
+; NONE: call i32 @tiny
+define i32 @lukewarm_caller(i32 %x) !prof !3 {
+  %r = call i32 @tiny(i32 %x)
+  ret i32 %r
+}
+
+define i32 @small(i32 %x) alwaysinline {
+  %a = shl i32 %x, 1
+  ret i32 %a
+}
+
+; SMALL-LABEL: @cold2(
+; SMALL-NOT: call
+; SMALL: ret i32
+; LARGE-LABEL: @cold2(
+; LARGE-NOT: call
+; LARGE: ret i32
+; NONE-LABEL: @cold2(
+; NONE-NOT: call
+; NONE: ret i32
+define i32 @cold2(i32 %x) !prof !3 {
+  %r = call i32 @small(i32 %x)
+  ret i32 %r
+}
+
+!0 = !{!"function_entry_count", i64 10}
+!1 = !{!"function_entry_count", i64 1000}
+!2 = !{!"function_entry_count", i64 0}
+!3 = !{!"function_entry_count", i64 1}
@@ -0,0 +1,51 @@
+; RUN: opt < %s -instcombine -S | FileCheck %s
+; RUN: opt < %s -instcombine -instcombine-change-driven -S | FileCheck %s
+; RUN: opt < %s -instcombine -stats -disable-output 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=RESCAN
+; RUN: opt < %s -instcombine -instcombine-change-driven -stats \
+; RUN:   -disable-output 2>&1 | FileCheck %s --check-prefix=CHANGE
+; REQUIRES: asserts
+
+; Each fold below only becomes possible once the one before it has been done.
+; The change-driven mode gets there by revisiting the users of each change
+; and never rescans the function.
+
+; RESCAN: instcombine - Number of whole-function rescans
+; CHANGE-NOT: whole-function rescans
+; CHANGE: instcombine - Number of instructions re-queued after a change
+; CHANGE-NOT: whole-function rescans
+
+; CHECK-LABEL: @chain(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: br label %next
+; CHECK: next:
+; CHECK-NEXT: ret i32 %x
+define i32 @chain(i32 %x) {
+entry:
+  %a = add i32 %x, 0
+  br label %next
+
+next:
+  %b = sub i32 %a, %x
+  %c = or i32 %b, %x
+  %d = mul i32 %c, 1
+  ret i32 %d
+}
+
+; The add folds only after the phi has been visited, so the phi has to be
+; re-queued before it can fold in turn.
+; CHECK-LABEL: @loop(
+; CHECK-NOT: phi
+; CHECK: ret i32 %x
+define i32 @loop(i32 %x, i1 %c) {
+entry:
+  br label %loop
+
+loop:
+  %p = phi i32 [ %x, %entry ], [ %q, %loop ]
+  %q = add i32 %p, 0
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %p
+}
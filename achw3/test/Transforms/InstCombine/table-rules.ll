@@ -0,0 +1,125 @@
+; RUN: opt < %s -instcombine -S | FileCheck %s
+; RUN: opt < %s -instcombine -instcombine-table-rules=false -S | FileCheck %s
+; RUN: opt < %s -instcombine -stats -disable-output 2>&1 | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts
+
+; The folds in InstCombineRules.td give the same results as the hand-written
+; visitors they are tried before.
+
+; STATS: 9 instcombine - Number of table-driven folds
+
+; CHECK-LABEL: @add_self(
+; CHECK-NEXT: %r = shl nsw i32 %x, 1
+define i32 @add_self(i32 %x) {
+  %r = add nsw i32 %x, %x
+  ret i32 %r
+}
+
+; Shifting an i1 by one is undefined, so this is x ^ x instead.
+; CHECK-LABEL: @add_self_i1(
+; CHECK-NEXT: ret i1 false
+define i1 @add_self_i1(i1 %x) {
+  %r = add i1 %x, %x
+  ret i1 %r
+}
+
+; CHECK-LABEL: @add_self_v2i1(
+; CHECK-NEXT: ret <2 x i1> zeroinitializer
+define <2 x i1> @add_self_v2i1(<2 x i1> %x) {
+  %r = add <2 x i1> %x, %x
+  ret <2 x i1> %r
+}
+
+; CHECK-LABEL: @not_plus_one(
+; CHECK-NEXT: %r = sub i32 0, %x
+define i32 @not_plus_one(i32 %x) {
+  %n = xor i32 %x, -1
+  %r = add i32 %n, 1
+  ret i32 %r
+}
+
+; CHECK-LABEL: @add_neg(
+; CHECK-NEXT: %r = sub i32 %x, %y
+define i32 @add_neg(i32 %x, i32 %y) {
+  %n = sub i32 0, %y
+  %r = add i32 %n, %x
+  ret i32 %r
+}
+
+; CHECK-LABEL: @neg_plus_neg(
+; CHECK-NEXT: %sum = add i32 %x, %y
+; CHECK-NEXT: %r = sub i32 0, %sum
+define i32 @neg_plus_neg(i32 %x, i32 %y) {
+  %nx = sub i32 0, %x
+  %ny = sub i32 0, %y
+  %r = add i32 %nx, %ny
+  ret i32 %r
+}
+
+; CHECK-LABEL: @sub_from_allones(
+; CHECK-NEXT: %r = xor <2 x i32> %x, <i32 -1, i32 -1>
+define <2 x i32> @sub_from_allones(<2 x i32> %x) {
+  %r = sub <2 x i32> <i32 -1, i32 -1>, %x
+  ret <2 x i32> %r
+}
+
+; CHECK-LABEL: @mul_allones(
+; CHECK-NEXT: %r = sub i32 0, %x
+define i32 @mul_allones(i32 %x) {
+  %r = mul i32 %x, -1
+  ret i32 %r
+}
+
+; Only nsw carries over to the negation.
+; CHECK-LABEL: @mul_allones_wrap(
+; CHECK-NEXT: %r = sub nsw i32 0, %x
+define i32 @mul_allones_wrap(i32 %x) {
+  %r = mul nuw nsw i32 %x, -1
+  ret i32 %r
+}
+
+; CHECK-LABEL: @demorgan_and(
+; CHECK-NEXT: %r.demorgan = or i32 %x, %y
+; CHECK-NEXT: %r = xor i32 %r.demorgan, -1
+define i32 @demorgan_and(i32 %x, i32 %y) {
+  %nx = xor i32 %x, -1
+  %ny = xor i32 -1, %y
+  %r = and i32 %nx, %ny
+  ret i32 %r
+}
+
+; The nots have other uses, so rewriting would add an instruction.
+; CHECK-LABEL: @demorgan_or_multi_use(
+; CHECK: %r = or i32 %nx, %ny
+define i32 @demorgan_or_multi_use(i32 %x, i32 %y, i32* %p) {
+  %nx = xor i32 %x, -1
+  %ny = xor i32 %y, -1
+  store i32 %nx, i32* %p
+  store i32 %ny, i32* %p
+  %r = or i32 %nx, %ny
+  ret i32 %r
+}
+
+; CHECK-LABEL: @demorgan_or(
+; CHECK-NEXT: %r.demorgan = and i32 %x, %y
+; CHECK-NEXT: %r = xor i32 %r.demorgan, -1
+define i32 @demorgan_or(i32 %x, i32 %y) {
+  %nx = xor i32 %x, -1
+  %ny = xor i32 %y, -1
+  %r = or i32 %nx, %ny
+  ret i32 %r
+}
+
+; Nots of compares are free, so they are folded into the compares instead.
+; CHECK-LABEL: @demorgan_icmp(
+; CHECK-NEXT: %nc = icmp ne i32 %x, 0
+; CHECK-NEXT: %nd = icmp ne i32 %y, 57
+; CHECK-NEXT: %r = and i1 %nc, %nd
+define i1 @demorgan_icmp(i32 %x, i32 %y) {
+  %c = icmp eq i32 %x, 0
+  %d = icmp eq i32 %y, 57
+  %nc = xor i1 %c, true
+  %nd = xor i1 %d, true
+  %r = and i1 %nc, %nd
+  ret i1 %r
+}
@@ -0,0 +1,106 @@
+; RUN: opt < %s -loop-vectorize -mcpu=core-avx2 -vectorizer-tail=masked -force-vector-width=8 -force-vector-interleave=1 -S | FileCheck %s --check-prefix=MASKED
+; RUN: opt < %s -loop-vectorize -mcpu=core-avx2 -vectorizer-tail=epilogue -force-vector-width=8 -force-vector-interleave=1 \
+; RUN:   -pass-remarks=loop-vectorize -S 2>&1 | FileCheck %s --check-prefix=EPILOGUE
+; RUN: opt < %s -loop-vectorize -mcpu=core-avx2 -force-vector-width=8 -force-vector-interleave=1 -S | FileCheck %s --check-prefix=SCALAR
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; The iterations left over by the vector loop either run in the vector loop
+; itself under a mask, in a second narrower vector loop, or (by default) in
+; the scalar loop.
+
+; MASKED-LABEL: @add_const(
+; MASKED: vector.ph:
+; MASKED: %trip.count.minus.1 = sub i64
+; MASKED: vector.body:
+; MASKED: %tail.mask = icmp ule <8 x i64> %{{.*}}, %broadcast.btc
+; MASKED: call <8 x i32> @llvm.masked.load.v8i32(<8 x i32>* %{{.*}}, i32 4, <8 x i1> %tail.mask, <8 x i32> undef)
+; MASKED: call void @llvm.masked.store.v8i32(<8 x i32> %{{.*}}, <8 x i32>* %{{.*}}, i32 4, <8 x i1> %tail.mask)
+; MASKED: middle.block:
+; MASKED-NEXT: br i1 true, label %exit, label %scalar.ph
+
+; EPILOGUE: remark: {{.*}}vectorized loop (vectorization width: 8, interleaved count: 1)
+; EPILOGUE: remark: {{.*}}vectorized epilogue loop (vectorization width: 4)
+; EPILOGUE-LABEL: @add_const(
+; EPILOGUE: load <8 x i32>
+; EPILOGUE: store <8 x i32>
+; EPILOGUE: middle.block:
+; EPILOGUE: load <4 x i32>
+; EPILOGUE: store <4 x i32>
+; EPILOGUE: load i32
+
+; SCALAR-LABEL: @add_const(
+; SCALAR-NOT: masked
+; SCALAR: %cmp.n = icmp eq i64
+; SCALAR-NOT: <4 x i32>
+define void @add_const(i32* noalias %a, i32* noalias %b, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  %v = load i32, i32* %pb, align 4
+  %add = add nsw i32 %v, 7
+  %pa = getelementptr inbounds i32, i32* %a, i64 %i
+  store i32 %add, i32* %pa, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Lanes past the end must not reach the reduction.
+; MASKED-LABEL: @sum(
+; MASKED: vector.body:
+; MASKED: %vec.phi = phi <8 x i32>
+; MASKED: %tail.mask = icmp ule <8 x i64>
+; MASKED: %[[L:.*]] = call <8 x i32> @llvm.masked.load.v8i32({{.*}}, <8 x i1> %tail.mask, <8 x i32> undef)
+; MASKED: %[[ADD:.*]] = add <8 x i32> %vec.phi, %[[L]]
+; MASKED: %rdx.masked = select <8 x i1> %tail.mask, <8 x i32> %[[ADD]], <8 x i32> %vec.phi
+; MASKED: middle.block:
+; MASKED: br i1 true
+define i32 @sum(i32* noalias %b, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  %v = load i32, i32* %pb, align 4
+  %s.next = add i32 %s, %v
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %s.next
+}
+
+; A division cannot run on masked-off lanes, so the tail stays scalar.
+; MASKED-LABEL: @div(
+; MASKED-NOT: tail.mask
+; MASKED: %cmp.n = icmp eq i64
+; MASKED: ret void
+define void @div(i32* noalias %a, i32* noalias %b, i32 %d, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  %v = load i32, i32* %pb, align 4
+  %q = sdiv i32 %v, %d
+  %pa = getelementptr inbounds i32, i32* %a, i64 %i
+  store i32 %q, i32* %pa, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
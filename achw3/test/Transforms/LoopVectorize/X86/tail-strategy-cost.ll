@@ -0,0 +1,81 @@
+; RUN: opt < %s -loop-vectorize -mcpu=core-avx2 -vectorizer-tail=auto -force-vector-width=8 -force-vector-interleave=1 \
+; RUN:   -pass-remarks=loop-vectorize -S 2>&1 | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; The same loop at three trip counts, all with VF 8:
+; - @tc16 has no remainder, so there is nothing to decide.
+; - @tc15 runs one vector iteration and a 7-iteration remainder; a masked
+;   vector loop is cheapest.  Its trip count is below the tiny trip count
+;   threshold, so the loop is forced with llvm.loop.vectorize.enable; without
+;   that it is not vectorized at all.
+; - @tc1007 has the same remainder after many vector iterations; an unmasked
+;   body with a VF 4 epilogue is cheapest.
+
+; CHECK: remark: {{.*}}vectorized loop (vectorization width: 8, interleaved count: 1)
+; CHECK-NOT: epilogue
+; CHECK: remark: {{.*}}vectorized loop (vectorization width: 8, interleaved count: 1, masked tail)
+; CHECK: remark: {{.*}}vectorized loop (vectorization width: 8, interleaved count: 1)
+; CHECK-NEXT: remark: {{.*}}vectorized epilogue loop (vectorization width: 4)
+
+define void @tc16(i32* noalias %a, i32* noalias %b) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  %v = load i32, i32* %pb, align 4
+  %add = add nsw i32 %v, 7
+  %pa = getelementptr inbounds i32, i32* %a, i64 %i
+  store i32 %add, i32* %pa, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 16
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define void @tc15(i32* noalias %a, i32* noalias %b) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %idx = sext i32 %i to i64
+  %pb = getelementptr inbounds i32, i32* %b, i64 %idx
+  %v = load i32, i32* %pb, align 4
+  %add = add nsw i32 %v, 7
+  %pa = getelementptr inbounds i32, i32* %a, i64 %idx
+  store i32 %add, i32* %pa, align 4
+  %i.next = add nuw nsw i32 %i, 1
+  %done = icmp eq i32 %i.next, 15
+  br i1 %done, label %exit, label %loop, !llvm.loop !0
+
+exit:
+  ret void
+}
+
+define void @tc1007(i32* noalias %a, i32* noalias %b) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds i32, i32* %b, i64 %i
+  %v = load i32, i32* %pb, align 4
+  %add = add nsw i32 %v, 7
+  %pa = getelementptr inbounds i32, i32* %a, i64 %i
+  store i32 %add, i32* %pa, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 1007
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+!0 = distinct !{!0, !1}
+!1 = !{!"llvm.loop.vectorize.enable", i1 true}
@@ -0,0 +1,208 @@
+; RUN: opt < %s -basicaa -slp-vectorizer -slp-vectorize-hor-store -S -mtriple=x86_64-unknown-linux-gnu -mcpu=corei7-avx | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; A chain of twelve stores is vectorized with eight lanes, and the four
+; stores that are left over with four.
+
+; CHECK-LABEL: @store_chain(
+; CHECK: store <8 x float>
+; CHECK: store <4 x float>
+; CHECK-NOT: store float
+; CHECK: ret void
+define void @store_chain(float* noalias %a, float* noalias %b, float* noalias %c) {
+entry:
+  %pa0 = getelementptr inbounds float, float* %a, i64 0
+  %a0 = load float, float* %pa0, align 4
+  %pb0 = getelementptr inbounds float, float* %b, i64 0
+  %b0 = load float, float* %pb0, align 4
+  %s0 = fadd float %a0, %b0
+  %pc0 = getelementptr inbounds float, float* %c, i64 0
+  store float %s0, float* %pc0, align 4
+  %pa1 = getelementptr inbounds float, float* %a, i64 1
+  %a1 = load float, float* %pa1, align 4
+  %pb1 = getelementptr inbounds float, float* %b, i64 1
+  %b1 = load float, float* %pb1, align 4
+  %s1 = fadd float %a1, %b1
+  %pc1 = getelementptr inbounds float, float* %c, i64 1
+  store float %s1, float* %pc1, align 4
+  %pa2 = getelementptr inbounds float, float* %a, i64 2
+  %a2 = load float, float* %pa2, align 4
+  %pb2 = getelementptr inbounds float, float* %b, i64 2
+  %b2 = load float, float* %pb2, align 4
+  %s2 = fadd float %a2, %b2
+  %pc2 = getelementptr inbounds float, float* %c, i64 2
+  store float %s2, float* %pc2, align 4
+  %pa3 = getelementptr inbounds float, float* %a, i64 3
+  %a3 = load float, float* %pa3, align 4
+  %pb3 = getelementptr inbounds float, float* %b, i64 3
+  %b3 = load float, float* %pb3, align 4
+  %s3 = fadd float %a3, %b3
+  %pc3 = getelementptr inbounds float, float* %c, i64 3
+  store float %s3, float* %pc3, align 4
+  %pa4 = getelementptr inbounds float, float* %a, i64 4
+  %a4 = load float, float* %pa4, align 4
+  %pb4 = getelementptr inbounds float, float* %b, i64 4
+  %b4 = load float, float* %pb4, align 4
+  %s4 = fadd float %a4, %b4
+  %pc4 = getelementptr inbounds float, float* %c, i64 4
+  store float %s4, float* %pc4, align 4
+  %pa5 = getelementptr inbounds float, float* %a, i64 5
+  %a5 = load float, float* %pa5, align 4
+  %pb5 = getelementptr inbounds float, float* %b, i64 5
+  %b5 = load float, float* %pb5, align 4
+  %s5 = fadd float %a5, %b5
+  %pc5 = getelementptr inbounds float, float* %c, i64 5
+  store float %s5, float* %pc5, align 4
+  %pa6 = getelementptr inbounds float, float* %a, i64 6
+  %a6 = load float, float* %pa6, align 4
+  %pb6 = getelementptr inbounds float, float* %b, i64 6
+  %b6 = load float, float* %pb6, align 4
+  %s6 = fadd float %a6, %b6
+  %pc6 = getelementptr inbounds float, float* %c, i64 6
+  store float %s6, float* %pc6, align 4
+  %pa7 = getelementptr inbounds float, float* %a, i64 7
+  %a7 = load float, float* %pa7, align 4
+  %pb7 = getelementptr inbounds float, float* %b, i64 7
+  %b7 = load float, float* %pb7, align 4
+  %s7 = fadd float %a7, %b7
+  %pc7 = getelementptr inbounds float, float* %c, i64 7
+  store float %s7, float* %pc7, align 4
+  %pa8 = getelementptr inbounds float, float* %a, i64 8
+  %a8 = load float, float* %pa8, align 4
+  %pb8 = getelementptr inbounds float, float* %b, i64 8
+  %b8 = load float, float* %pb8, align 4
+  %s8 = fadd float %a8, %b8
+  %pc8 = getelementptr inbounds float, float* %c, i64 8
+  store float %s8, float* %pc8, align 4
+  %pa9 = getelementptr inbounds float, float* %a, i64 9
+  %a9 = load float, float* %pa9, align 4
+  %pb9 = getelementptr inbounds float, float* %b, i64 9
+  %b9 = load float, float* %pb9, align 4
+  %s9 = fadd float %a9, %b9
+  %pc9 = getelementptr inbounds float, float* %c, i64 9
+  store float %s9, float* %pc9, align 4
+  %pa10 = getelementptr inbounds float, float* %a, i64 10
+  %a10 = load float, float* %pa10, align 4
+  %pb10 = getelementptr inbounds float, float* %b, i64 10
+  %b10 = load float, float* %pb10, align 4
+  %s10 = fadd float %a10, %b10
+  %pc10 = getelementptr inbounds float, float* %c, i64 10
+  store float %s10, float* %pc10, align 4
+  %pa11 = getelementptr inbounds float, float* %a, i64 11
+  %a11 = load float, float* %pa11, align 4
+  %pb11 = getelementptr inbounds float, float* %b, i64 11
+  %b11 = load float, float* %pb11, align 4
+  %s11 = fadd float %a11, %b11
+  %pc11 = getelementptr inbounds float, float* %c, i64 11
+  store float %s11, float* %pc11, align 4
+  ret void
+}
+
+; A reduction over six products is reduced as four lanes and two lanes.
+
+; CHECK-LABEL: @reduce6(
+; CHECK: fmul fast <4 x float>
+; CHECK: fmul fast <2 x float>
+; CHECK: store float %{{.*}}, float* %c
+; CHECK: ret void
+define void @reduce6(float* noalias %a, float* noalias %b, float* noalias %c) {
+entry:
+  %pa0 = getelementptr inbounds float, float* %a, i64 0
+  %a0 = load float, float* %pa0, align 4
+  %pb0 = getelementptr inbounds float, float* %b, i64 0
+  %b0 = load float, float* %pb0, align 4
+  %m0 = fmul fast float %a0, %b0
+  %pa1 = getelementptr inbounds float, float* %a, i64 1
+  %a1 = load float, float* %pa1, align 4
+  %pb1 = getelementptr inbounds float, float* %b, i64 1
+  %b1 = load float, float* %pb1, align 4
+  %m1 = fmul fast float %a1, %b1
+  %pa2 = getelementptr inbounds float, float* %a, i64 2
+  %a2 = load float, float* %pa2, align 4
+  %pb2 = getelementptr inbounds float, float* %b, i64 2
+  %b2 = load float, float* %pb2, align 4
+  %m2 = fmul fast float %a2, %b2
+  %pa3 = getelementptr inbounds float, float* %a, i64 3
+  %a3 = load float, float* %pa3, align 4
+  %pb3 = getelementptr inbounds float, float* %b, i64 3
+  %b3 = load float, float* %pb3, align 4
+  %m3 = fmul fast float %a3, %b3
+  %pa4 = getelementptr inbounds float, float* %a, i64 4
+  %a4 = load float, float* %pa4, align 4
+  %pb4 = getelementptr inbounds float, float* %b, i64 4
+  %b4 = load float, float* %pb4, align 4
+  %m4 = fmul fast float %a4, %b4
+  %pa5 = getelementptr inbounds float, float* %a, i64 5
+  %a5 = load float, float* %pa5, align 4
+  %pb5 = getelementptr inbounds float, float* %b, i64 5
+  %b5 = load float, float* %pb5, align 4
+  %m5 = fmul fast float %a5, %b5
+  %r1 = fadd fast float %m0, %m1
+  %r2 = fadd fast float %r1, %m2
+  %r3 = fadd fast float %r2, %m3
+  %r4 = fadd fast float %r3, %m4
+  %r5 = fadd fast float %r4, %m5
+  store float %r5, float* %c, align 4
+  ret void
+}
+
+; The first two stores are of arguments and not worth vectorizing, so four
+; lanes are vectorized from the third store on.  That leaves a run of two
+; stores on each side, and the one after the bundle is still vectorized.
+
+; CHECK-LABEL: @two_runs(
+; CHECK: store <4 x double>
+; CHECK: store <2 x double>
+; CHECK: ret void
+define void @two_runs(double %x, double %y, double* noalias %a, double* noalias %b, double* noalias %c) {
+entry:
+  %pc0 = getelementptr inbounds double, double* %c, i64 0
+  store double %x, double* %pc0, align 8
+  %pc1 = getelementptr inbounds double, double* %c, i64 1
+  store double %y, double* %pc1, align 8
+  %pa2 = getelementptr inbounds double, double* %a, i64 2
+  %a2 = load double, double* %pa2, align 8
+  %pb2 = getelementptr inbounds double, double* %b, i64 2
+  %b2 = load double, double* %pb2, align 8
+  %s2 = fadd double %a2, %b2
+  %pc2 = getelementptr inbounds double, double* %c, i64 2
+  store double %s2, double* %pc2, align 8
+  %pa3 = getelementptr inbounds double, double* %a, i64 3
+  %a3 = load double, double* %pa3, align 8
+  %pb3 = getelementptr inbounds double, double* %b, i64 3
+  %b3 = load double, double* %pb3, align 8
+  %s3 = fadd double %a3, %b3
+  %pc3 = getelementptr inbounds double, double* %c, i64 3
+  store double %s3, double* %pc3, align 8
+  %pa4 = getelementptr inbounds double, double* %a, i64 4
+  %a4 = load double, double* %pa4, align 8
+  %pb4 = getelementptr inbounds double, double* %b, i64 4
+  %b4 = load double, double* %pb4, align 8
+  %s4 = fadd double %a4, %b4
+  %pc4 = getelementptr inbounds double, double* %c, i64 4
+  store double %s4, double* %pc4, align 8
+  %pa5 = getelementptr inbounds double, double* %a, i64 5
+  %a5 = load double, double* %pa5, align 8
+  %pb5 = getelementptr inbounds double, double* %b, i64 5
+  %b5 = load double, double* %pb5, align 8
+  %s5 = fadd double %a5, %b5
+  %pc5 = getelementptr inbounds double, double* %c, i64 5
+  store double %s5, double* %pc5, align 8
+  %pa6 = getelementptr inbounds double, double* %a, i64 6
+  %a6 = load double, double* %pa6, align 8
+  %pb6 = getelementptr inbounds double, double* %b, i64 6
+  %b6 = load double, double* %pb6, align 8
+  %s6 = fadd double %a6, %b6
+  %pc6 = getelementptr inbounds double, double* %c, i64 6
+  store double %s6, double* %pc6, align 8
+  %pa7 = getelementptr inbounds double, double* %a, i64 7
+  %a7 = load double, double* %pa7, align 8
+  %pb7 = getelementptr inbounds double, double* %b, i64 7
+  %b7 = load double, double* %pb7, align 8
+  %s7 = fadd double %a7, %b7
+  %pc7 = getelementptr inbounds double, double* %c, i64 7
+  store double %s7, double* %pc7, align 8
+  ret void
+}
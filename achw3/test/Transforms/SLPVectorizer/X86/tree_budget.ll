@@ -0,0 +1,200 @@
+; RUN: opt < %s -basicaa -slp-vectorizer -S -mtriple=x86_64-unknown-linux-gnu -mcpu=corei7-avx | FileCheck %s
+; RUN: opt < %s -basicaa -slp-vectorizer -S -slp-tree-budget-per-inst=0 -mtriple=x86_64-unknown-linux-gnu -mcpu=corei7-avx | FileCheck %s --check-prefix=NOBUDGET
+; RUN: opt < %s -basicaa -slp-vectorizer -S -slp-tree-budget-per-inst=1 -mtriple=x86_64-unknown-linux-gnu -mcpu=corei7-avx | FileCheck %s --check-prefix=PARTIAL
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@A = global [4 x float] zeroinitializer
+@B = global [4 x float] zeroinitializer
+@C = global [4 x float] zeroinitializer
+@E = global [4 x float] zeroinitializer
+@G = global [48 x float] zeroinitializer
+
+declare float @g(i64) readnone nounwind
+
+; Test that no trees are built once the budget of a block is used up.
+
+; CHECK-LABEL: @test(
+; CHECK: load <4 x float>
+; CHECK: fmul <4 x float>
+; CHECK: store <4 x float>
+; NOBUDGET-LABEL: @test(
+; NOBUDGET-NOT: <4 x float>
+; NOBUDGET: store float
+define void @test(float* noalias %a, float* noalias %b, float* noalias %c) {
+entry:
+  %pa0 = getelementptr inbounds float, float* %a, i64 0
+  %a0 = load float, float* %pa0, align 4
+  %pb0 = getelementptr inbounds float, float* %b, i64 0
+  %b0 = load float, float* %pb0, align 4
+  %s0 = fmul float %a0, %b0
+  %pc0 = getelementptr inbounds float, float* %c, i64 0
+  store float %s0, float* %pc0, align 4
+  %pa1 = getelementptr inbounds float, float* %a, i64 1
+  %a1 = load float, float* %pa1, align 4
+  %pb1 = getelementptr inbounds float, float* %b, i64 1
+  %b1 = load float, float* %pb1, align 4
+  %s1 = fmul float %a1, %b1
+  %pc1 = getelementptr inbounds float, float* %c, i64 1
+  store float %s1, float* %pc1, align 4
+  %pa2 = getelementptr inbounds float, float* %a, i64 2
+  %a2 = load float, float* %pa2, align 4
+  %pb2 = getelementptr inbounds float, float* %b, i64 2
+  %b2 = load float, float* %pb2, align 4
+  %s2 = fmul float %a2, %b2
+  %pc2 = getelementptr inbounds float, float* %c, i64 2
+  store float %s2, float* %pc2, align 4
+  %pa3 = getelementptr inbounds float, float* %a, i64 3
+  %a3 = load float, float* %pa3, align 4
+  %pb3 = getelementptr inbounds float, float* %b, i64 3
+  %b3 = load float, float* %pb3, align 4
+  %s3 = fmul float %a3, %b3
+  %pc3 = getelementptr inbounds float, float* %c, i64 3
+  store float %s3, float* %pc3, align 4
+  ret void
+}
+
+; The budget can also run out part way through a block: with one tree node per
+; instruction the store chain to @C is vectorized, the 48 unprofitable lanes
+; to @G use up what is left, and the chain to @E is left scalar.
+
+; CHECK-LABEL: @partial(
+; CHECK: store <4 x float> {{.*}} @C
+; CHECK: store <4 x float> {{.*}} @E
+; PARTIAL-LABEL: @partial(
+; PARTIAL: store <4 x float> {{.*}} @C
+; PARTIAL-NOT: store <4 x float>
+; PARTIAL: store float %ys0, {{.*}} @E
+define void @partial() {
+entry:
+  %xa0 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @A, i64 0, i64 0), align 4
+  %xb0 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @B, i64 0, i64 0), align 4
+  %xs0 = fmul float %xa0, %xb0
+  store float %xs0, float* getelementptr inbounds ([4 x float], [4 x float]* @C, i64 0, i64 0), align 4
+  %xa1 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @A, i64 0, i64 1), align 4
+  %xb1 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @B, i64 0, i64 1), align 4
+  %xs1 = fmul float %xa1, %xb1
+  store float %xs1, float* getelementptr inbounds ([4 x float], [4 x float]* @C, i64 0, i64 1), align 4
+  %xa2 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @A, i64 0, i64 2), align 4
+  %xb2 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @B, i64 0, i64 2), align 4
+  %xs2 = fmul float %xa2, %xb2
+  store float %xs2, float* getelementptr inbounds ([4 x float], [4 x float]* @C, i64 0, i64 2), align 4
+  %xa3 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @A, i64 0, i64 3), align 4
+  %xb3 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @B, i64 0, i64 3), align 4
+  %xs3 = fmul float %xa3, %xb3
+  store float %xs3, float* getelementptr inbounds ([4 x float], [4 x float]* @C, i64 0, i64 3), align 4
+  %j0 = call float @g(i64 0)
+  store float %j0, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 0), align 4
+  %j1 = call float @g(i64 1)
+  store float %j1, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 1), align 4
+  %j2 = call float @g(i64 2)
+  store float %j2, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 2), align 4
+  %j3 = call float @g(i64 3)
+  store float %j3, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 3), align 4
+  %j4 = call float @g(i64 4)
+  store float %j4, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 4), align 4
+  %j5 = call float @g(i64 5)
+  store float %j5, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 5), align 4
+  %j6 = call float @g(i64 6)
+  store float %j6, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 6), align 4
+  %j7 = call float @g(i64 7)
+  store float %j7, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 7), align 4
+  %j8 = call float @g(i64 8)
+  store float %j8, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 8), align 4
+  %j9 = call float @g(i64 9)
+  store float %j9, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 9), align 4
+  %j10 = call float @g(i64 10)
+  store float %j10, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 10), align 4
+  %j11 = call float @g(i64 11)
+  store float %j11, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 11), align 4
+  %j12 = call float @g(i64 12)
+  store float %j12, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 12), align 4
+  %j13 = call float @g(i64 13)
+  store float %j13, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 13), align 4
+  %j14 = call float @g(i64 14)
+  store float %j14, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 14), align 4
+  %j15 = call float @g(i64 15)
+  store float %j15, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 15), align 4
+  %j16 = call float @g(i64 16)
+  store float %j16, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 16), align 4
+  %j17 = call float @g(i64 17)
+  store float %j17, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 17), align 4
+  %j18 = call float @g(i64 18)
+  store float %j18, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 18), align 4
+  %j19 = call float @g(i64 19)
+  store float %j19, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 19), align 4
+  %j20 = call float @g(i64 20)
+  store float %j20, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 20), align 4
+  %j21 = call float @g(i64 21)
+  store float %j21, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 21), align 4
+  %j22 = call float @g(i64 22)
+  store float %j22, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 22), align 4
+  %j23 = call float @g(i64 23)
+  store float %j23, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 23), align 4
+  %j24 = call float @g(i64 24)
+  store float %j24, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 24), align 4
+  %j25 = call float @g(i64 25)
+  store float %j25, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 25), align 4
+  %j26 = call float @g(i64 26)
+  store float %j26, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 26), align 4
+  %j27 = call float @g(i64 27)
+  store float %j27, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 27), align 4
+  %j28 = call float @g(i64 28)
+  store float %j28, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 28), align 4
+  %j29 = call float @g(i64 29)
+  store float %j29, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 29), align 4
+  %j30 = call float @g(i64 30)
+  store float %j30, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 30), align 4
+  %j31 = call float @g(i64 31)
+  store float %j31, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 31), align 4
+  %j32 = call float @g(i64 32)
+  store float %j32, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 32), align 4
+  %j33 = call float @g(i64 33)
+  store float %j33, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 33), align 4
+  %j34 = call float @g(i64 34)
+  store float %j34, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 34), align 4
+  %j35 = call float @g(i64 35)
+  store float %j35, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 35), align 4
+  %j36 = call float @g(i64 36)
+  store float %j36, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 36), align 4
+  %j37 = call float @g(i64 37)
+  store float %j37, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 37), align 4
+  %j38 = call float @g(i64 38)
+  store float %j38, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 38), align 4
+  %j39 = call float @g(i64 39)
+  store float %j39, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 39), align 4
+  %j40 = call float @g(i64 40)
+  store float %j40, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 40), align 4
+  %j41 = call float @g(i64 41)
+  store float %j41, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 41), align 4
+  %j42 = call float @g(i64 42)
+  store float %j42, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 42), align 4
+  %j43 = call float @g(i64 43)
+  store float %j43, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 43), align 4
+  %j44 = call float @g(i64 44)
+  store float %j44, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 44), align 4
+  %j45 = call float @g(i64 45)
+  store float %j45, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 45), align 4
+  %j46 = call float @g(i64 46)
+  store float %j46, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 46), align 4
+  %j47 = call float @g(i64 47)
+  store float %j47, float* getelementptr inbounds ([48 x float], [48 x float]* @G, i64 0, i64 47), align 4
+  %ya0 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @A, i64 0, i64 0), align 4
+  %yb0 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @B, i64 0, i64 0), align 4
+  %ys0 = fmul float %ya0, %yb0
+  store float %ys0, float* getelementptr inbounds ([4 x float], [4 x float]* @E, i64 0, i64 0), align 4
+  %ya1 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @A, i64 0, i64 1), align 4
+  %yb1 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @B, i64 0, i64 1), align 4
+  %ys1 = fmul float %ya1, %yb1
+  store float %ys1, float* getelementptr inbounds ([4 x float], [4 x float]* @E, i64 0, i64 1), align 4
+  %ya2 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @A, i64 0, i64 2), align 4
+  %yb2 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @B, i64 0, i64 2), align 4
+  %ys2 = fmul float %ya2, %yb2
+  store float %ys2, float* getelementptr inbounds ([4 x float], [4 x float]* @E, i64 0, i64 2), align 4
+  %ya3 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @A, i64 0, i64 3), align 4
+  %yb3 = load float, float* getelementptr inbounds ([4 x float], [4 x float]* @B, i64 0, i64 3), align 4
+  %ys3 = fmul float %ya3, %yb3
+  store float %ys3, float* getelementptr inbounds ([4 x float], [4 x float]* @E, i64 0, i64 3), align 4
+  ret void
+}
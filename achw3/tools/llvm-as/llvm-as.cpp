@@ -22,11 +22,14 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include <memory>
 using namespace llvm;
@@ -60,6 +63,10 @@ static cl::opt<bool> PreserveBitcodeUseListOrder(
     cl::desc("Preserve use-list order when writing LLVM bitcode."),
     cl::init(true), cl::Hidden);
 
+static cl::opt<bool> ParseThroughput(
+    "parse-throughput", cl::Hidden,
+    cl::desc("Report the parse throughput of the input assembly in MB/s"));
+
 static void WriteOutputFile(const Module *M) {
   // Infer the output filename if needed.
   if (OutputFilename.empty()) {
@@ -98,7 +105,28 @@ int main(int argc, char **argv) {
 
   // Parse the file now...
   SMDiagnostic Err;
-  std::unique_ptr<Module> M = parseAssemblyFile(InputFilename, Err, Context);
+  std::unique_ptr<Module> M;
+  if (ParseThroughput) {
+    // Map the input up front so that only the parse itself is timed.
+    ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+        MemoryBuffer::getFileOrSTDIN(InputFilename);
+    if (std::error_code EC = BufferOrErr.getError()) {
+      errs() << argv[0] << ": Could not open input file: " << EC.message()
+             << '\n';
+      return 1;
+    }
+    MemoryBufferRef Buffer = BufferOrErr.get()->getMemBufferRef();
+
+    TimeRecord Start = TimeRecord::getCurrentTime(true);
+    M = parseAssembly(Buffer, Err, Context);
+    double Seconds =
+        TimeRecord::getCurrentTime(false).getWallTime() - Start.getWallTime();
+    double MB = Buffer.getBufferSize() / (1024.0 * 1024.0);
+    errs() << format("parsed %.3f MB in %.3f s (%.1f MB/s)\n", MB, Seconds,
+                     Seconds > 0 ? MB / Seconds : 0.0);
+  } else {
+    M = parseAssemblyFile(InputFilename, Err, Context);
+  }
   if (!M.get()) {
     Err.print(argv[0], errs());
     return 1;
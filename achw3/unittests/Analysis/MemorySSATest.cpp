@@ -0,0 +1,153 @@
+//===- MemorySSATest.cpp - Unit tests for MemorySSA -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BasicAliasAnalysis.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class MemorySSATest : public testing::Test {
+protected:
+  LLVMContext C;
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M;
+  TargetLibraryInfoImpl TLII;
+  TargetLibraryInfo TLI;
+  std::unique_ptr<AssumptionCache> AC;
+  std::unique_ptr<BasicAAResult> BAR;
+  std::unique_ptr<AAResults> AAR;
+  std::unique_ptr<DominatorTree> DT;
+  std::unique_ptr<MemorySSA> MSSA;
+
+  MemorySSATest() : TLI(TLII) {}
+
+  MemorySSA &buildMemorySSA(const char *Assembly) {
+    M = parseAssemblyString(Assembly, Err, C);
+    EXPECT_TRUE(M != nullptr);
+    Function &F = *M->begin();
+    AAR.reset(new AAResults());
+    AC.reset(new AssumptionCache(F));
+    BAR.reset(new BasicAAResult(M->getDataLayout(), TLI, *AC));
+    AAR->addAAResult(*BAR);
+    DT.reset(new DominatorTree(F));
+    MSSA.reset(new MemorySSA(F, *AAR, *DT));
+    MSSA->verifyMemorySSA();
+    return *MSSA;
+  }
+
+  Instruction *getInst(const char *Name) {
+    for (Instruction &I : instructions(*M->begin()))
+      if (I.getName() == Name)
+        return &I;
+    return nullptr;
+  }
+
+  /// Return the N'th store in the function.
+  StoreInst *getStore(unsigned N) {
+    for (Instruction &I : instructions(*M->begin()))
+      if (auto *SI = dyn_cast<StoreInst>(&I))
+        if (N-- == 0)
+          return SI;
+    return nullptr;
+  }
+};
+
+// %b is stored to in the loop, but %a is not, so the walker should see
+// through the loop's MemoryPhi to the store to %a in the entry block.
+const char *LoopAssembly = "define i32 @f() {\n"
+                           "entry:\n"
+                           "  %a = alloca i32\n"
+                           "  %b = alloca i32\n"
+                           "  store i32 1, i32* %a\n"
+                           "  br label %loop\n"
+                           "loop:\n"
+                           "  store i32 2, i32* %b\n"
+                           "  %c = load i32, i32* %b\n"
+                           "  %cmp = icmp eq i32 %c, 0\n"
+                           "  br i1 %cmp, label %loop, label %exit\n"
+                           "exit:\n"
+                           "  %r = load i32, i32* %a\n"
+                           "  ret i32 %r\n"
+                           "}\n";
+
+TEST_F(MemorySSATest, CachingWalker) {
+  MemorySSA &MSSA = buildMemorySSA(LoopAssembly);
+  StoreInst *StoreA = getStore(0);
+  StoreInst *StoreB = getStore(1);
+  Instruction *LoadC = getInst("c");
+  Instruction *LoadR = getInst("r");
+
+  MemoryAccess *DefA = MSSA.getMemoryAccess(StoreA);
+  MemoryAccess *DefB = MSSA.getMemoryAccess(StoreB);
+  MemoryPhi *Phi = MSSA.getMemoryAccess(StoreB->getParent());
+  ASSERT_TRUE(Phi != nullptr);
+  EXPECT_EQ(MSSA.getMemoryAccess(LoadR)->getDefiningAccess(), DefB);
+  EXPECT_TRUE(MSSA.dominates(DefA, DefB));
+  EXPECT_FALSE(MSSA.dominates(DefB, DefA));
+
+  auto *Walker = static_cast<CachingMemorySSAWalker *>(MSSA.getWalker());
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(LoadC), DefB);
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(LoadR), DefA);
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(LoadR), DefA);
+  EXPECT_EQ(Walker->getNumQueries(), 3u);
+  EXPECT_EQ(Walker->getNumCacheHits(), 1u);
+
+  // A location query from the phi: %b is clobbered on the back edge but not
+  // on entry, so the phi itself is the answer.
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(Phi, MemoryLocation::get(LoadC)),
+            Phi);
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(Phi, MemoryLocation::get(LoadR)),
+            DefA);
+}
+
+TEST_F(MemorySSATest, RemoveAndCreateAccess) {
+  MemorySSA &MSSA = buildMemorySSA(LoopAssembly);
+  StoreInst *StoreB = getStore(1);
+  Instruction *LoadC = getInst("c");
+  Instruction *LoadR = getInst("r");
+  MemoryPhi *Phi = MSSA.getMemoryAccess(StoreB->getParent());
+  MemorySSAWalker *Walker = MSSA.getWalker();
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(LoadC),
+            MSSA.getMemoryAccess(StoreB));
+
+  // Dropping the store rewires its users to the loop phi, which now has the
+  // same value on the back edge as itself.
+  MSSA.removeMemoryAccess(MSSA.getMemoryAccess(StoreB));
+  StoreB->eraseFromParent();
+  MSSA.verifyMemorySSA();
+  EXPECT_EQ(MSSA.getMemoryAccess(LoadC)->getDefiningAccess(), Phi);
+  EXPECT_EQ(MSSA.getMemoryAccess(LoadR)->getDefiningAccess(), Phi);
+  EXPECT_EQ(Phi->getIncomingValue(1), Phi);
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(LoadC),
+            MSSA.getLiveOnEntryDef());
+
+  // Add another load of %a in front of %r; it is clobbered by the store to
+  // %a before the loop.
+  MemoryUseOrDef *UseR = MSSA.getMemoryAccess(LoadR);
+  auto *NewLoad = new LoadInst(LoadR->getOperand(0), "n", LoadR);
+  MemoryUseOrDef *NewUse = MSSA.createMemoryAccessBefore(NewLoad, Phi, UseR);
+  EXPECT_TRUE(isa<MemoryUse>(NewUse));
+  EXPECT_TRUE(MSSA.dominates(NewUse, UseR));
+  MSSA.verifyMemorySSA();
+  EXPECT_EQ(Walker->getClobberingMemoryAccess(NewLoad),
+            MSSA.getMemoryAccess(getStore(0)));
+}
+
+} // end anonymous namespace
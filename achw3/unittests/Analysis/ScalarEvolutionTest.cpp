@@ -13,12 +13,15 @@
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/AsmParser/Parser.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/SourceMgr.h"
 #include "gtest/gtest.h"
 
 namespace llvm {
@@ -237,5 +240,109 @@ TEST_F(ScalarEvolutionsTest, SCEVMultiplyAddRecs) {
   EXPECT_EQ(Product->getOperand(8), SE.getAddExpr(Sum));
 }
 
+TEST_F(ScalarEvolutionsTest, ForgetStopsAtOpaqueValues) {
+  SMDiagnostic Err;
+  std::unique_ptr<Module> LoopM = parseAssemblyString(
+      "define void @f(i32* %p, i32* %q) {\n"
+      "entry:\n"
+      "  %n = load i32, i32* %q\n"
+      "  br label %loop\n"
+      "loop:\n"
+      "  %iv = phi i32 [ 0, %entry ], [ %iv.next, %loop ]\n"
+      "  %gep = getelementptr i32, i32* %p, i32 %iv\n"
+      "  %ld = load i32, i32* %gep\n"
+      "  %x = add i32 %ld, 7\n"
+      "  %iv.next = add nsw i32 %iv, 1\n"
+      "  %c = icmp slt i32 %iv.next, %n\n"
+      "  br i1 %c, label %loop, label %exit\n"
+      "exit:\n"
+      "  ret void\n"
+      "}\n",
+      Err, Context);
+  ASSERT_TRUE(LoopM != nullptr);
+  Function &F = *LoopM->getFunction("f");
+  ScalarEvolution SE = buildSE(F);
+  Loop *L = *LI->begin();
+
+  std::map<StringRef, Instruction *> Insts;
+  for (Instruction &I : instructions(F))
+    Insts[I.getName()] = &I;
+
+  auto ComputeAll = [&]() {
+    for (Instruction &I : instructions(F))
+      if (SE.isSCEVable(I.getType()))
+        SE.getSCEV(&I);
+  };
+
+  const SCEV *BECount = SE.getBackedgeTakenCount(L);
+  EXPECT_FALSE(isa<SCEVCouldNotCompute>(BECount));
+  ComputeAll();
+
+  // Everything computed from the induction variable goes, but the load from
+  // the loop is SCEVUnknown whatever its address is, and so is the part of
+  // %x that depends on it.
+  SE.forgetLoop(L);
+  EXPECT_EQ(nullptr, SE.getExistingSCEV(Insts["iv"]));
+  EXPECT_EQ(nullptr, SE.getExistingSCEV(Insts["gep"]));
+  EXPECT_EQ(nullptr, SE.getExistingSCEV(Insts["iv.next"]));
+  EXPECT_NE(nullptr, SE.getExistingSCEV(Insts["ld"]));
+  EXPECT_NE(nullptr, SE.getExistingSCEV(Insts["x"]));
+  EXPECT_NE(nullptr, SE.getExistingSCEV(Insts["n"]));
+
+  ComputeAll();
+  SE.forgetValue(Insts["gep"]);
+  EXPECT_EQ(nullptr, SE.getExistingSCEV(Insts["gep"]));
+  EXPECT_NE(nullptr, SE.getExistingSCEV(Insts["iv"]));
+  EXPECT_NE(nullptr, SE.getExistingSCEV(Insts["ld"]));
+
+  // The root itself is always forgotten, along with its users and the trip
+  // count that uses it.
+  EXPECT_EQ(BECount, SE.getBackedgeTakenCount(L));
+  SE.forgetValue(Insts["n"]);
+  EXPECT_EQ(nullptr, SE.getExistingSCEV(Insts["n"]));
+  EXPECT_EQ(nullptr, SE.getExistingSCEV(Insts["c"]));
+  EXPECT_EQ(BECount, SE.getBackedgeTakenCount(L));
+}
+
+TEST_F(ScalarEvolutionsTest, ForgetDropsDispositionsOfUsers) {
+  SMDiagnostic Err;
+  std::unique_ptr<Module> LoopM = parseAssemblyString(
+      "define void @f(i32* %p, i32 %n) {\n"
+      "entry:\n"
+      "  br label %loop\n"
+      "loop:\n"
+      "  %iv = phi i32 [ 0, %entry ], [ %iv.next, %loop ]\n"
+      "  %gep = getelementptr i32, i32* %p, i32 %n\n"
+      "  %ld = load i32, i32* %gep\n"
+      "  %x = add i32 %ld, 7\n"
+      "  %iv.next = add nsw i32 %iv, 1\n"
+      "  %c = icmp slt i32 %iv.next, %x\n"
+      "  br i1 %c, label %loop, label %exit\n"
+      "exit:\n"
+      "  ret void\n"
+      "}\n",
+      Err, Context);
+  ASSERT_TRUE(LoopM != nullptr);
+  Function &F = *LoopM->getFunction("f");
+  ScalarEvolution SE = buildSE(F);
+  Loop *L = *LI->begin();
+
+  std::map<StringRef, Instruction *> Insts;
+  for (Instruction &I : instructions(F))
+    Insts[I.getName()] = &I;
+
+  const SCEV *X = SE.getSCEV(Insts["x"]);
+  EXPECT_EQ(ScalarEvolution::LoopVariant, SE.getLoopDisposition(X, L));
+
+  // Hoist the invariant load, as LICM would.  The walk from %gep stops at the
+  // load, but (7 + %ld) must not keep its old disposition.
+  Instruction *EntryTerm = F.getEntryBlock().getTerminator();
+  Insts["gep"]->moveBefore(EntryTerm);
+  Insts["ld"]->moveBefore(EntryTerm);
+  SE.forgetValue(Insts["gep"]);
+  EXPECT_EQ(X, SE.getExistingSCEV(Insts["x"]));
+  EXPECT_EQ(ScalarEvolution::LoopInvariant, SE.getLoopDisposition(X, L));
+}
+
 }  // end anonymous namespace
 }  // end namespace llvm
@@ -250,6 +250,135 @@ namespace llvm {
       Passes.add(P);
       Passes.run(*M);
     }
+
+    // Pick a pseudo-random block for the false edge of Blocks[i]: mostly one
+    // in the same region of 64 blocks, sometimes one anywhere.
+    BasicBlock *pickTarget(std::vector<BasicBlock *> &Blocks, unsigned i,
+                           unsigned &Seed) {
+      Seed = Seed * 1103515245 + 12345;
+      if ((Seed >> 4) % 8 == 0)
+        return Blocks[(Seed >> 8) % Blocks.size()];
+      return Blocks[std::min<size_t>(i / 64 * 64 + (Seed >> 8) % 64,
+                                     Blocks.size() - 1)];
+    }
+
+    // Build a function whose entry switches to regions of 64 blocks, each a
+    // chain of conditional branches that ends in a return.  The false edges
+    // make the regions loop-heavy, and sometimes lead into another region.
+    Function *makeRandomCFG(Module &M, unsigned NumBlocks, unsigned &Seed,
+                            std::vector<BasicBlock *> &Blocks) {
+      LLVMContext &C = M.getContext();
+      IntegerType *I32 = Type::getInt32Ty(C);
+      Type *Params[] = {Type::getInt1Ty(C), I32};
+      FunctionType *FTy =
+          FunctionType::get(Type::getVoidTy(C), Params, false);
+      Function *F =
+          Function::Create(FTy, Function::ExternalLinkage, "f", &M);
+      Argument *Cond = &*F->arg_begin();
+      Argument *Sel = &*std::next(F->arg_begin());
+      BasicBlock *Entry = BasicBlock::Create(C, "", F);
+      for (unsigned i = 0; i != NumBlocks; ++i)
+        Blocks.push_back(BasicBlock::Create(C, "", F));
+      SwitchInst *SI =
+          SwitchInst::Create(Sel, Blocks[0], NumBlocks / 64, Entry);
+      for (unsigned i = 0; i != NumBlocks; ++i) {
+        if (i % 64 == 0 && i != 0)
+          SI->addCase(ConstantInt::get(I32, i / 64), Blocks[i]);
+        if (i % 64 == 63 || i == NumBlocks - 1) {
+          ReturnInst::Create(C, Blocks[i]);
+          continue;
+        }
+        BranchInst::Create(Blocks[i + 1], pickTarget(Blocks, i, Seed), Cond,
+                           Blocks[i]);
+      }
+      return F;
+    }
+
+    TEST(DominatorTree, IncrementalUpdates) {
+      LLVMContext &C = getGlobalContext();
+      Module M("updates", C);
+      unsigned Seed = 42;
+      std::vector<BasicBlock *> Blocks;
+      Function *F = makeRandomCFG(M, 4000, Seed, Blocks);
+
+      DominatorTree DT(*F);
+      for (unsigned Edit = 0; Edit != 200; ++Edit) {
+        // Retarget the false edge of one to three random branches at once.
+        SmallVector<DominatorTree::UpdateType, 6> Updates;
+        Seed = Seed * 1103515245 + 12345;
+        for (unsigned i = 0, e = 1 + (Seed >> 16) % 3; i != e; ++i) {
+          Seed = Seed * 1103515245 + 12345;
+          unsigned FromIdx = (Seed >> 8) % Blocks.size();
+          BasicBlock *From = Blocks[FromIdx];
+          auto *BI = dyn_cast<BranchInst>(From->getTerminator());
+          if (!BI)
+            continue;
+          BasicBlock *OldTo = BI->getSuccessor(1);
+          BasicBlock *NewTo = pickTarget(Blocks, FromIdx, Seed);
+          BI->setSuccessor(1, NewTo);
+          Updates.push_back({DominatorTree::Delete, From, OldTo});
+          Updates.push_back({DominatorTree::Insert, From, NewTo});
+        }
+        DT.applyUpdates(Updates);
+
+        DominatorTree Fresh(*F);
+        ASSERT_FALSE(DT.compare(Fresh)) << "after edit " << Edit;
+      }
+    }
+
+    TEST(DominatorTree, IncrementalReachability) {
+      // The chain of %p blocks keeps the edited subtree small enough to be
+      // updated rather than recalculated.
+      std::string ModuleString =
+          "define void @f(i1 %c) {\n"
+          "entry:\n"
+          "  br i1 %c, label %top, label %p0\n"
+          "top:\n"
+          "  br i1 %c, label %a, label %b\n"
+          "a:\n"
+          "  br label %d\n"
+          "b:\n"
+          "  br label %d\n"
+          "d:\n"
+          "  ret void\n"
+          "u:\n"
+          "  br label %d\n";
+      for (unsigned i = 0; i != 16; ++i)
+        ModuleString += "p" + std::to_string(i) + ":\n  br label %p" +
+                        std::to_string(i + 1) + "\n";
+      ModuleString += "p16:\n  ret void\n}\n";
+      SMDiagnostic Err;
+      std::unique_ptr<Module> M =
+          parseAssemblyString(ModuleString, Err, getGlobalContext());
+      Function *F = M->getFunction("f");
+      Function::iterator FI = std::next(F->begin());
+      BasicBlock *Top = &*FI++;
+      BasicBlock *A = &*FI++;
+      BasicBlock *B = &*FI++;
+      BasicBlock *D = &*FI++;
+      BasicBlock *U = &*FI++;
+
+      DominatorTree DT(*F);
+      EXPECT_EQ(DT.getNode(D)->getIDom()->getBlock(), Top);
+      EXPECT_EQ(DT.getNode(U), nullptr);
+
+      // top -> b goes away, so b becomes unreachable and a dominates d.
+      cast<BranchInst>(Top->getTerminator())->setSuccessor(1, A);
+      DT.deleteEdge(Top, B);
+      EXPECT_EQ(DT.getNode(B), nullptr);
+      EXPECT_EQ(DT.getNode(D)->getIDom()->getBlock(), A);
+
+      // a -> u makes u reachable; d now has preds a and u.
+      BranchInst::Create(U, D, &*F->arg_begin(), A->getTerminator());
+      A->getTerminator()->eraseFromParent();
+      DT.insertEdge(A, U);
+      ASSERT_NE(DT.getNode(U), nullptr);
+      EXPECT_EQ(DT.getNode(U)->getIDom()->getBlock(), A);
+      EXPECT_EQ(DT.getNode(D)->getIDom()->getBlock(), A);
+
+      DominatorTree Fresh(*F);
+      EXPECT_FALSE(DT.compare(Fresh));
+    }
   }
 }
 
@@ -59,6 +59,37 @@ TEST(CompressionTest, Zlib) {
   TestZlibCompression(BinaryDataStr, zlib::DefaultCompression);
 }
 
+void TestZlibStreamCompression(StringRef Input, size_t PieceSize) {
+  SmallString<32> Compressed;
+  zlib::Compressor C(Compressed);
+  for (size_t I = 0; I < Input.size(); I += PieceSize)
+    C.write(Input.substr(I, PieceSize));
+  EXPECT_EQ(zlib::StatusOK, C.finish());
+
+  // Streaming compression produces the same output as compress().
+  SmallString<32> Expected;
+  EXPECT_EQ(zlib::StatusOK, zlib::compress(Input, Expected));
+  EXPECT_EQ(Expected, Compressed);
+
+  SmallString<32> Uncompressed;
+  EXPECT_EQ(zlib::StatusOK,
+            zlib::uncompress(Compressed, Uncompressed, Input.size()));
+  EXPECT_EQ(Input, Uncompressed);
+}
+
+TEST(CompressionTest, ZlibStream) {
+  TestZlibStreamCompression("", 1);
+  TestZlibStreamCompression("hello, world!", 1);
+  TestZlibStreamCompression("hello, world!", 5);
+
+  // Large enough to need several output chunks.
+  std::string Data;
+  for (unsigned i = 0; i < 200000; ++i)
+    Data.push_back((i * 7919) >> (i & 7));
+  TestZlibStreamCompression(Data, 1000);
+  TestZlibStreamCompression(Data, Data.size());
+}
+
 TEST(CompressionTest, ZlibCRC32) {
   EXPECT_EQ(
       0x414FA339U,
@@ -0,0 +1,529 @@
+//===- InstCombineRulesEmitter.cpp - Generate InstCombine rule matcher ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tablegen backend compiles the InstCombine rewrite rules described with
+// the classes in InstCombinePatterns.td into a decision tree.  The tree first
+// switches on the opcode of the instruction being combined, then on the
+// opcodes of its operands, so each instruction is only checked against the
+// rules whose shape it can match.  Leaf predicates, repeated names and use
+// counts are checked last, rule by rule, in definition order.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/TableGen/Error.h"
+#include "llvm/TableGen/Record.h"
+#include "llvm/TableGen/TableGenBackend.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+using namespace llvm;
+
+#define DEBUG_TYPE "instcombine-rules-emitter"
+
+namespace {
+
+/// A node of a rule's pattern: an opcode with two operands, or a leaf.
+struct PatternNode {
+  Record *Op;
+  std::string Name;
+  std::vector<PatternNode> Children;
+
+  bool isLeaf() const { return Op->isSubClassOf("Leaf"); }
+
+  std::string str() const {
+    std::string S = "(" + Op->getName();
+    for (const PatternNode &C : Children)
+      S += " " + C.str();
+    S += ")";
+    if (!Name.empty())
+      S += ":$" + Name;
+    return S;
+  }
+
+  /// Print the pattern with names numbered in order of appearance, so that
+  /// patterns that only differ in their names print the same.
+  std::string shapeStr(std::map<std::string, unsigned> &Names) const {
+    std::string S = "(" + Op->getName();
+    for (const PatternNode &C : Children)
+      S += " " + C.shapeStr(Names);
+    S += ")";
+    if (!Name.empty())
+      S += ":$" + utostr(Names.insert(std::make_pair(Name, Names.size()))
+                             .first->second);
+    return S;
+  }
+};
+
+/// One way of matching a rule; commutable opcodes give a rule several.
+struct RuleVariant {
+  Record *Rule;
+  PatternNode Root;
+  /// Names that are checked for equality or used by the result.
+  std::set<std::string> UsedNames;
+};
+
+/// The path from the root to an operand, e.g. {1, 0} for operand 0 of
+/// operand 1.  The root itself is the empty path.
+typedef std::vector<unsigned> Path;
+
+class InstCombineRulesEmitter {
+  RecordKeeper &Records;
+  std::vector<RuleVariant> Variants;
+
+public:
+  InstCombineRulesEmitter(RecordKeeper &R) : Records(R) {}
+
+  void run(raw_ostream &OS);
+
+private:
+  PatternNode parsePattern(Record *Rule, Init *Arg, StringRef Name);
+  void expandCommuted(const PatternNode &N, std::vector<PatternNode> &Out);
+
+  void emitDecision(raw_ostream &OS, ArrayRef<const RuleVariant *> Items,
+                    const std::vector<Path> &Open, unsigned Indent);
+  void emitRule(raw_ostream &OS, const RuleVariant &V, unsigned Indent);
+  std::string emitResultValue(raw_ostream &OS, Record *Rule, Init *Arg,
+                              StringRef Name,
+                              const std::map<std::string, Path> &Bindings,
+                              unsigned Indent, unsigned &NumTemps);
+};
+
+} // End anonymous namespace.
+
+/// Return the variable holding the value at path P.
+static std::string getVarName(const Path &P) {
+  if (P.empty())
+    return "I";
+  std::string S = "Op";
+  for (unsigned i = 0, e = P.size(); i != e; ++i) {
+    if (i)
+      S += "_";
+    S += utostr(P[i]);
+  }
+  return S;
+}
+
+/// Return the node at path P, or null if P passes through a leaf.
+static const PatternNode *getNodeAt(const PatternNode &Root, const Path &P) {
+  const PatternNode *N = &Root;
+  for (unsigned Idx : P) {
+    if (N->isLeaf())
+      return nullptr;
+    N = &N->Children[Idx];
+  }
+  return N;
+}
+
+/// Return true if the rule needs the value at path P to be available, that
+/// is if it matches an opcode there, checks a leaf or binds a used name.
+static bool isPathUsed(const RuleVariant &V, const Path &P) {
+  const PatternNode *N = getNodeAt(V.Root, P);
+  if (!N)
+    return false;
+  return !N->isLeaf() || V.UsedNames.count(N->Name) ||
+         !N->Op->getValueAsString("Matcher").empty() ||
+         !N->Op->getValueAsString("Predicate").empty();
+}
+
+/// Count the occurrences of each name in a pattern or result.
+static void countNames(Init *Arg, StringRef Name,
+                       std::map<std::string, unsigned> &Counts) {
+  if (!Name.empty())
+    ++Counts[Name];
+  if (DagInit *Dag = dyn_cast<DagInit>(Arg))
+    for (unsigned i = 0, e = Dag->getNumArgs(); i != e; ++i)
+      countNames(Dag->getArg(i), Dag->getArgName(i), Counts);
+}
+
+/// Replace each occurrence of Var in Expr with Repl.
+static std::string substitute(std::string Expr, StringRef Var,
+                              StringRef Repl) {
+  size_t Pos;
+  while ((Pos = Expr.find(Var)) != std::string::npos)
+    Expr.replace(Pos, Var.size(), Repl);
+  return Expr;
+}
+
+static std::string substituteType(std::string Expr) {
+  return substitute(Expr, "$Ty", "I.getType()");
+}
+
+/// Return a C++ expression for the name Name, where $Name stands for the name
+/// of the instruction being combined.
+static std::string getNameExpr(StringRef Name) {
+  std::string Expr;
+  while (!Name.empty()) {
+    if (!Expr.empty())
+      Expr += " + ";
+    size_t Pos = Name.find("$Name");
+    if (Pos == 0) {
+      Expr += "I.getName()";
+      Name = Name.substr(5);
+      continue;
+    }
+    Expr += "\"" + Name.substr(0, Pos).str() + "\"";
+    Name = Name.substr(Pos == StringRef::npos ? Name.size() : Pos);
+  }
+  return Expr;
+}
+
+PatternNode InstCombineRulesEmitter::parsePattern(Record *Rule, Init *Arg,
+                                                  StringRef Name) {
+  PatternNode N;
+  N.Name = Name;
+  if (DefInit *DI = dyn_cast<DefInit>(Arg)) {
+    N.Op = DI->getDef();
+    if (!N.Op->isSubClassOf("Leaf"))
+      PrintFatalError(Rule->getLoc(), "pattern operand '" + N.Op->getName() +
+                                          "' is not a Leaf");
+    return N;
+  }
+
+  DagInit *Dag = dyn_cast<DagInit>(Arg);
+  if (!Dag)
+    PrintFatalError(Rule->getLoc(), "unnamed or untyped pattern operand");
+  DefInit *OpDef = dyn_cast<DefInit>(Dag->getOperator());
+  if (!OpDef || !OpDef->getDef()->isSubClassOf("InstOpcode"))
+    PrintFatalError(Rule->getLoc(), "pattern operator is not an InstOpcode");
+  if (Dag->getNumArgs() != 2)
+    PrintFatalError(Rule->getLoc(), "pattern operators take two operands");
+  N.Op = OpDef->getDef();
+  for (unsigned i = 0; i != 2; ++i)
+    N.Children.push_back(
+        parsePattern(Rule, Dag->getArg(i), Dag->getArgName(i)));
+  return N;
+}
+
+/// Append to Out every way of writing N with the operands of commutable
+/// opcodes swapped or not.
+void InstCombineRulesEmitter::expandCommuted(const PatternNode &N,
+                                             std::vector<PatternNode> &Out) {
+  if (N.isLeaf()) {
+    Out.push_back(N);
+    return;
+  }
+
+  std::vector<PatternNode> LHS, RHS;
+  expandCommuted(N.Children[0], LHS);
+  expandCommuted(N.Children[1], RHS);
+
+  bool Commutable = N.Op->getValueAsBit("Commutable");
+  for (unsigned Swap = 0; Swap != (Commutable ? 2u : 1u); ++Swap)
+    for (const PatternNode &L : LHS)
+      for (const PatternNode &R : RHS) {
+        PatternNode New;
+        New.Op = N.Op;
+        New.Name = N.Name;
+        New.Children.push_back(Swap ? R : L);
+        New.Children.push_back(Swap ? L : R);
+        std::string S = New.str();
+        if (std::none_of(Out.begin(), Out.end(),
+                         [&](const PatternNode &O) { return O.str() == S; }))
+          Out.push_back(New);
+      }
+}
+
+/// Emit code that tries the rules in Items, given that the values at the
+/// paths in Open have been loaded into variables but not yet looked at.
+void InstCombineRulesEmitter::emitDecision(raw_ostream &OS,
+                                           ArrayRef<const RuleVariant *> Items,
+                                           const std::vector<Path> &Open,
+                                           unsigned Indent) {
+  // Split on the first open path at which some rule wants an opcode.
+  auto Split = std::find_if(Open.begin(), Open.end(), [&](const Path &P) {
+    return std::any_of(Items.begin(), Items.end(), [&](const RuleVariant *V) {
+      const PatternNode *N = getNodeAt(V->Root, P);
+      return N && !N->isLeaf();
+    });
+  });
+
+  if (Split == Open.end()) {
+    for (const RuleVariant *V : Items)
+      emitRule(OS, *V, Indent);
+    return;
+  }
+
+  Path P = *Split;
+  std::vector<Path> Rest(Open.begin(), Split);
+  Rest.insert(Rest.end(), std::next(Split), Open.end());
+
+  // Opcodes in the order the rules first mention them, and the rules that
+  // accept any value at P.
+  std::vector<Record *> Opcodes;
+  std::vector<const RuleVariant *> AnyOp;
+  for (const RuleVariant *V : Items) {
+    const PatternNode *N = getNodeAt(V->Root, P);
+    if (!N || N->isLeaf())
+      AnyOp.push_back(V);
+    else if (std::find(Opcodes.begin(), Opcodes.end(), N->Op) == Opcodes.end())
+      Opcodes.push_back(N->Op);
+  }
+
+  std::string Var = getVarName(P);
+  bool IsRoot = P.empty();
+  if (IsRoot) {
+    OS.indent(Indent) << "switch (I.getOpcode()) {\n";
+  } else {
+    OS.indent(Indent) << "if (auto *B" << Var << " = dyn_cast<BinaryOperator>("
+                      << Var << ")) {\n";
+    Indent += 2;
+    OS.indent(Indent) << "switch (B" << Var << "->getOpcode()) {\n";
+  }
+  OS.indent(Indent) << "default:\n";
+  OS.indent(Indent + 2) << "break;\n";
+
+  for (Record *Opc : Opcodes) {
+    std::vector<const RuleVariant *> Sub;
+    for (const RuleVariant *V : Items) {
+      const PatternNode *N = getNodeAt(V->Root, P);
+      if (!N || N->isLeaf() || N->Op == Opc)
+        Sub.push_back(V);
+    }
+
+    OS.indent(Indent) << "case Instruction::" << Opc->getValueAsString("Name")
+                      << ": {\n";
+    std::vector<Path> SubOpen = Rest;
+    for (unsigned i = 0; i != 2; ++i) {
+      Path Child = P;
+      Child.push_back(i);
+      if (std::none_of(Sub.begin(), Sub.end(), [&](const RuleVariant *V) {
+            return isPathUsed(*V, Child);
+          }))
+        continue;
+      OS.indent(Indent + 2) << "Value *" << getVarName(Child) << " = "
+                            << (IsRoot ? "I." : "B" + Var + "->")
+                            << "getOperand(" << i << ");\n";
+      SubOpen.push_back(Child);
+    }
+    emitDecision(OS, Sub, SubOpen, Indent + 2);
+    // Every rule that could match has been tried.
+    OS.indent(Indent + 2) << "return nullptr;\n";
+    OS.indent(Indent) << "}\n";
+  }
+
+  OS.indent(Indent) << "}\n";
+  if (!IsRoot) {
+    Indent -= 2;
+    OS.indent(Indent) << "}\n";
+  }
+
+  if (!AnyOp.empty())
+    emitDecision(OS, AnyOp, Rest, Indent);
+}
+
+/// Emit the checks the decision tree leaves to each rule, and its rewrite.
+void InstCombineRulesEmitter::emitRule(raw_ostream &OS, const RuleVariant &V,
+                                       unsigned Indent) {
+  Record *Rule = V.Rule;
+  bool OneUse = Rule->getValueAsBit("OneUse");
+  std::vector<std::string> Conds;
+  std::map<std::string, Path> Bindings;
+
+  // Walk the pattern in preorder to collect the checks.
+  std::vector<std::pair<const PatternNode *, Path>> Worklist;
+  Worklist.push_back(std::make_pair(&V.Root, Path()));
+  while (!Worklist.empty()) {
+    const PatternNode *N = Worklist.back().first;
+    Path P = Worklist.back().second;
+    Worklist.pop_back();
+    std::string Var = getVarName(P);
+
+    if (!N->Name.empty()) {
+      auto Ins = Bindings.insert(std::make_pair(N->Name, P));
+      if (!Ins.second)
+        Conds.push_back(Var + " == " + getVarName(Ins.first->second));
+    }
+
+    if (N->isLeaf()) {
+      std::string Matcher = N->Op->getValueAsString("Matcher");
+      if (!Matcher.empty())
+        Conds.push_back("match(" + Var + ", " + Matcher + ")");
+      std::string Pred = N->Op->getValueAsString("Predicate");
+      if (!Pred.empty())
+        Conds.push_back(substitute(Pred, "$V", Var));
+      continue;
+    }
+
+    if (OneUse && !P.empty())
+      Conds.push_back(Var + "->hasOneUse()");
+    for (unsigned i = 2; i != 0; --i) {
+      Path Child = P;
+      Child.push_back(i - 1);
+      Worklist.push_back(std::make_pair(&N->Children[i - 1], Child));
+    }
+  }
+
+  OS.indent(Indent) << "// " << Rule->getName() << ": " << V.Root.str()
+                    << "\n";
+  if (!Conds.empty()) {
+    OS.indent(Indent) << "if (";
+    for (unsigned i = 0, e = Conds.size(); i != e; ++i) {
+      if (i)
+        OS << " &&\n" << std::string(Indent + 4, ' ');
+      OS << Conds[i];
+    }
+    OS << ") {\n";
+    Indent += 2;
+  } else {
+    OS.indent(Indent) << "{\n";
+    Indent += 2;
+  }
+
+  DagInit *Result = Rule->getValueAsDag("Result");
+  DefInit *ResOp = dyn_cast<DefInit>(Result->getOperator());
+  if (!ResOp)
+    PrintFatalError(Rule->getLoc(), "result operator must be a def");
+  Record *ResRec = ResOp->getDef();
+  unsigned NumTemps = 0;
+
+  if (ResRec->getName() == "replace") {
+    if (Result->getNumArgs() != 1)
+      PrintFatalError(Rule->getLoc(), "replace takes one operand");
+    std::string Val =
+        emitResultValue(OS, Rule, Result->getArg(0), Result->getArgName(0),
+                        Bindings, Indent, NumTemps);
+    OS.indent(Indent) << "++NumTableRuleFolds;\n";
+    OS.indent(Indent) << "return ReplaceInstUsesWith(I, " << Val << ");\n";
+  } else {
+    if (!ResRec->isSubClassOf("InstOpcode") || Result->getNumArgs() != 2)
+      PrintFatalError(Rule->getLoc(),
+                      "result must be replace or a binary InstOpcode");
+    std::string Ops[2];
+    for (unsigned i = 0; i != 2; ++i)
+      Ops[i] = emitResultValue(OS, Rule, Result->getArg(i),
+                               Result->getArgName(i), Bindings, Indent,
+                               NumTemps);
+    OS.indent(Indent) << "BinaryOperator *New = BinaryOperator::Create("
+                      << "Instruction::" << ResRec->getValueAsString("Name")
+                      << ", " << Ops[0] << ", " << Ops[1] << ");\n";
+    bool KeepWrapFlags = Rule->getValueAsBit("KeepWrapFlags");
+    if (KeepWrapFlags || Rule->getValueAsBit("KeepNoSignedWrap")) {
+      if (!ResRec->getValueAsBit("HasWrapFlags") ||
+          !V.Root.Op->getValueAsBit("HasWrapFlags"))
+        PrintFatalError(Rule->getLoc(),
+                        "KeepWrapFlags needs opcodes with wrap flags");
+      OS.indent(Indent) << "New->setHasNoSignedWrap(I.hasNoSignedWrap());\n";
+      if (KeepWrapFlags)
+        OS.indent(Indent)
+            << "New->setHasNoUnsignedWrap(I.hasNoUnsignedWrap());\n";
+    }
+    OS.indent(Indent) << "++NumTableRuleFolds;\n";
+    OS.indent(Indent) << "return New;\n";
+  }
+
+  Indent -= 2;
+  OS.indent(Indent) << "}\n";
+}
+
+/// Emit the code that builds a result operand and return the expression for
+/// it.  Nested operators are built into temporaries first, so the order the
+/// new instructions are inserted in does not depend on the C++ compiler.
+std::string InstCombineRulesEmitter::emitResultValue(
+    raw_ostream &OS, Record *Rule, Init *Arg, StringRef Name,
+    const std::map<std::string, Path> &Bindings, unsigned Indent,
+    unsigned &NumTemps) {
+  if (isa<UnsetInit>(Arg)) {
+    auto It = Bindings.find(Name);
+    if (Name.empty() || It == Bindings.end())
+      PrintFatalError(Rule->getLoc(),
+                      "result uses unbound name '$" + Name + "'");
+    return getVarName(It->second);
+  }
+
+  if (DefInit *DI = dyn_cast<DefInit>(Arg)) {
+    Record *Leaf = DI->getDef();
+    if (!Leaf->isSubClassOf("Leaf") ||
+        Leaf->getValueAsString("Create").empty())
+      PrintFatalError(Rule->getLoc(), "result operand '" + Leaf->getName() +
+                                          "' cannot be created");
+    return substituteType(Leaf->getValueAsString("Create"));
+  }
+
+  DagInit *Dag = dyn_cast<DagInit>(Arg);
+  DefInit *OpDef = Dag ? dyn_cast<DefInit>(Dag->getOperator()) : nullptr;
+  if (!OpDef || !OpDef->getDef()->isSubClassOf("InstOpcode") ||
+      Dag->getNumArgs() != 2)
+    PrintFatalError(Rule->getLoc(), "invalid result operand");
+
+  std::string Ops[2];
+  for (unsigned i = 0; i != 2; ++i)
+    Ops[i] = emitResultValue(OS, Rule, Dag->getArg(i), Dag->getArgName(i),
+                             Bindings, Indent, NumTemps);
+  std::string Temp = "R" + utostr(NumTemps++);
+  OS.indent(Indent) << "Value *" << Temp << " = Builder->CreateBinOp("
+                    << "Instruction::" << OpDef->getDef()->getValueAsString("Name")
+                    << ", " << Ops[0] << ", " << Ops[1];
+  std::string ResultName = Rule->getValueAsString("ResultName");
+  if (!ResultName.empty())
+    OS << ", " << getNameExpr(ResultName);
+  OS << ");\n";
+  return Temp;
+}
+
+void InstCombineRulesEmitter::run(raw_ostream &OS) {
+  std::vector<Record *> Rules = Records.getAllDerivedDefinitions("Rule");
+  // Rules are tried in definition order.
+  std::sort(Rules.begin(), Rules.end(), [](const Record *A, const Record *B) {
+    return A->getID() < B->getID();
+  });
+
+  for (Record *Rule : Rules) {
+    DagInit *Pattern = Rule->getValueAsDag("Pattern");
+    PatternNode Root = parsePattern(Rule, Pattern, "");
+
+    std::map<std::string, unsigned> PatternNames, ResultNames;
+    countNames(Pattern, "", PatternNames);
+    countNames(Rule->getValueAsDag("Result"), "", ResultNames);
+    std::set<std::string> UsedNames;
+    for (const auto &Name : PatternNames)
+      if (Name.second > 1 || ResultNames.count(Name.first))
+        UsedNames.insert(Name.first);
+
+    std::vector<PatternNode> Expanded;
+    expandCommuted(Root, Expanded);
+    std::vector<std::string> Shapes;
+    for (PatternNode &N : Expanded) {
+      // A variant that only renames an earlier one would never be reached.
+      std::map<std::string, unsigned> Names;
+      std::string Shape = N.shapeStr(Names);
+      if (std::find(Shapes.begin(), Shapes.end(), Shape) != Shapes.end())
+        continue;
+      Shapes.push_back(Shape);
+      Variants.push_back(RuleVariant{Rule, std::move(N), UsedNames});
+    }
+  }
+
+  emitSourceFileHeader("InstCombine rewrite rules", OS);
+  OS << "#ifdef GET_INSTCOMBINE_RULES\n";
+  OS << "#undef GET_INSTCOMBINE_RULES\n\n";
+  OS << "// " << Rules.size() << " rules, " << Variants.size()
+     << " patterns after commuting.\n";
+  OS << "Instruction *InstCombiner::matchTableRules(BinaryOperator &I) {\n";
+
+  std::vector<const RuleVariant *> Items;
+  for (const RuleVariant &V : Variants)
+    Items.push_back(&V);
+  emitDecision(OS, Items, std::vector<Path>(1, Path()), 2);
+
+  OS << "  return nullptr;\n";
+  OS << "}\n\n";
+  OS << "#endif // GET_INSTCOMBINE_RULES\n";
+}
+
+namespace llvm {
+
+void EmitInstCombineRules(RecordKeeper &RK, raw_ostream &OS) {
+  InstCombineRulesEmitter(RK).run(OS);
+}
+
+} // End llvm namespace